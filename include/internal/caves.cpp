@@ -0,0 +1,567 @@
+#include <internal/caves.h>
+#include <internal/simplex_noise.h>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+cave_settings default_cave_settings(uint64_t seed)
+{
+	cave_settings settings;
+	settings.seed = (uint32_t)(seed ^ (seed >> 32));
+	settings.period = 48;
+	settings.radius = 0.12;
+	settings.min_cover = 0;
+	settings.max_depth = 40;
+	return settings;
+}
+
+cave_density::cave_density(const heightfield<float>& heights, const cave_settings& settings) : ground(heights), settings(settings)
+{
+	inv_period = (float)(1.0 / settings.period);
+
+	// about voxels to the wall of a tunnel per noise unit, so the tunnels and the ground have similar slopes
+	tunnel_scale = (float)(settings.period / 4);
+
+	// the noise stays within about [-1, 1], so the tunnels can't reach past this
+	tunnel_max = (float)((1.5 - settings.radius) * settings.period / 4);
+}
+
+float cave_density::ground_height(int x, int z) const
+{
+	x = std::min(std::max(x, 0), ground.size_x() - 1);
+	z = std::min(std::max(z, 0), ground.size_y() - 1);
+	return ground[x][z];
+}
+
+float cave_density::cover(float depth) const
+{
+	return std::max((float)settings.min_cover - depth, depth - (float)settings.max_depth);
+}
+
+float cave_density::combine(float depth, float cover, float a, float b) const
+{
+	float tunnel = (sqrtf(a * a + b * b) - (float)settings.radius) * tunnel_scale;
+	return std::min(depth, std::max(tunnel, cover));
+}
+
+// the two noise fields at lattice point lx, ly, lz, CAVE_NOISE_STEP voxels apart
+void cave_density::tunnel_noise(int lx, int ly, int lz, float& a, float& b) const
+{
+	float x = (float)(lx * CAVE_NOISE_STEP) * inv_period;
+	float y = (float)(ly * CAVE_NOISE_STEP) * inv_period;
+	float z = (float)(lz * CAVE_NOISE_STEP) * inv_period;
+	a = simplex_noise3(x, y, z, settings.seed);
+	b = simplex_noise3(x, y, z, settings.seed + 1);
+}
+
+// round down to the lattice, for negative voxels too
+static inline int lattice_floor(int v)
+{
+	return v >= 0 ? v / CAVE_NOISE_STEP : -((-v + CAVE_NOISE_STEP - 1) / CAVE_NOISE_STEP);
+}
+
+// trilinear interpolation of the lattice values around a voxel, fx, fy, fz its position in the lattice cell.
+// lattice(i, j, k) returns corner i, j, k of the cell
+template <typename Lattice>
+static inline void interpolate_noise(float fx, float fy, float fz, Lattice lattice, float& a, float& b)
+{
+	float ca[8], cb[8];
+	for (int c = 0; c < 8; c++)
+		lattice(c >> 2 & 1, c >> 1 & 1, c & 1, ca[c], cb[c]);
+
+	float wa[4], wb[4];
+	for (int c = 0; c < 4; c++)
+	{
+		wa[c] = ca[c] + (ca[c + 4] - ca[c]) * fx;
+		wb[c] = cb[c] + (cb[c + 4] - cb[c]) * fx;
+	}
+	float ya0 = wa[0] + (wa[2] - wa[0]) * fy, ya1 = wa[1] + (wa[3] - wa[1]) * fy;
+	float yb0 = wb[0] + (wb[2] - wb[0]) * fy, yb1 = wb[1] + (wb[3] - wb[1]) * fy;
+	a = ya0 + (ya1 - ya0) * fz;
+	b = yb0 + (yb1 - yb0) * fz;
+}
+
+float cave_density::operator()(int x, int y, int z) const
+{
+	// positive below the ground
+	float depth = ground_height(x, z) - (float)y;
+	float c = cover(depth);
+	if (!needs_tunnel(depth, c))
+		return std::min(depth, c);
+
+	int lx = lattice_floor(x), ly = lattice_floor(y), lz = lattice_floor(z);
+	float a, b;
+	interpolate_noise((float)(x - lx * CAVE_NOISE_STEP) / CAVE_NOISE_STEP, (float)(y - ly * CAVE_NOISE_STEP) / CAVE_NOISE_STEP, (float)(z - lz * CAVE_NOISE_STEP) / CAVE_NOISE_STEP,
+		[&](int i, int j, int k, float& na, float& nb) { tunnel_noise(lx + i, ly + j, lz + k, na, nb); }, a, b);
+	return combine(depth, c, a, b);
+}
+
+void cave_density::sample(int x0, int y0, int z0, int size, float* out) const
+{
+	// lattice points covering the block, evaluated the first time a voxel needs them
+	int lx0 = lattice_floor(x0), ly0 = lattice_floor(y0), lz0 = lattice_floor(z0);
+	int lattice = lattice_floor(size - 1 + CAVE_NOISE_STEP - 1) + 3;
+	std::vector<float> noise_a((size_t)lattice * lattice * lattice, NAN);
+	std::vector<float> noise_b((size_t)lattice * lattice * lattice);
+
+	auto corner = [&](int i, int j, int k, float& a, float& b)
+	{
+		size_t index = ((size_t)(i - lx0) * lattice + (j - ly0)) * lattice + (k - lz0);
+		if (noise_a[index] != noise_a[index])
+			tunnel_noise(i, j, k, noise_a[index], noise_b[index]);
+		a = noise_a[index];
+		b = noise_b[index];
+	};
+
+	for (int i = 0; i < size; i++)
+	{
+		int x = x0 + i;
+		int lx = lattice_floor(x);
+		float fx = (float)(x - lx * CAVE_NOISE_STEP) / CAVE_NOISE_STEP;
+		for (int k = 0; k < size; k++)
+		{
+			int z = z0 + k;
+			int lz = lattice_floor(z);
+			float fz = (float)(z - lz * CAVE_NOISE_STEP) / CAVE_NOISE_STEP;
+			float ground_y = ground_height(x, z);
+			for (int j = 0; j < size; j++)
+			{
+				int y = y0 + j;
+				float depth = ground_y - (float)y;
+				float c = cover(depth);
+				float& result = out[((size_t)i * size + j) * size + k];
+				if (!needs_tunnel(depth, c))
+				{
+					result = std::min(depth, c);
+					continue;
+				}
+
+				int ly = lattice_floor(y);
+				float a, b;
+				interpolate_noise(fx, (float)(y - ly * CAVE_NOISE_STEP) / CAVE_NOISE_STEP, fz,
+					[&](int ci, int cj, int ck, float& na, float& nb) { corner(lx + ci, ly + cj, lz + ck, na, nb); }, a, b);
+				result = combine(depth, c, a, b);
+			}
+		}
+	}
+}
+
+// the 12 edges of a cell as pairs of corners, corner c being at (c >> 2 & 1, c >> 1 & 1, c & 1)
+static const int cell_edges[12][2] = {
+	{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 },
+	{ 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+	{ 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 }
+};
+
+template <typename Density>
+void mesh_cave_chunk(const Density& density, int x, int y, int z, cave_chunk& chunk)
+{
+	const int n = CAVE_CHUNK_SIZE;
+
+	// samples from one voxel before the chunk to its far side, so the cells on its edges can be built
+	const int s = n + 2;
+	const int cells = s - 1;
+	int x0 = x * n - 1;
+	int y0 = y * n - 1;
+	int z0 = z * n - 1;
+
+	chunk.x = x;
+	chunk.y = y;
+	chunk.z = z;
+	chunk.vertices.clear();
+	chunk.normals.clear();
+	chunk.indices.clear();
+
+	std::vector<float> d((size_t)s * s * s);
+	density.sample(x0, y0, z0, s, &d[0]);
+
+	// one vertex per cell the surface goes through, at the average of where it crosses the edges of the cell
+	float half_x = (float)(density.size_x() / 2);
+	float half_z = (float)(density.size_z() / 2);
+	std::vector<int32_t> cell_vertex((size_t)cells * cells * cells, -1);
+	for (int i = 0; i < cells; i++)
+	{
+		for (int j = 0; j < cells; j++)
+		{
+			for (int k = 0; k < cells; k++)
+			{
+				float corner[8];
+				int rock = 0;
+				for (int c = 0; c < 8; c++)
+				{
+					corner[c] = d[((size_t)(i + (c >> 2 & 1)) * s + j + (c >> 1 & 1)) * s + k + (c & 1)];
+					rock += corner[c] > 0;
+				}
+				if (rock == 0 || rock == 8)
+					continue;
+
+				glm::vec3 sum(0);
+				int crossings = 0;
+				for (int e = 0; e < 12; e++)
+				{
+					int a = cell_edges[e][0];
+					int b = cell_edges[e][1];
+					if ((corner[a] > 0) == (corner[b] > 0))
+						continue;
+
+					float t = corner[a] / (corner[a] - corner[b]);
+					glm::vec3 pa((float)(a >> 2 & 1), (float)(a >> 1 & 1), (float)(a & 1));
+					glm::vec3 pb((float)(b >> 2 & 1), (float)(b >> 1 & 1), (float)(b & 1));
+					sum += pa + (pb - pa) * t;
+					crossings++;
+				}
+				glm::vec3 p = sum / (float)crossings;
+
+				// the density grows into the rock, so the surface faces the other way
+				glm::vec3 gradient(
+					((corner[4] - corner[0]) + (corner[5] - corner[1])) + ((corner[6] - corner[2]) + (corner[7] - corner[3])),
+					((corner[2] - corner[0]) + (corner[3] - corner[1])) + ((corner[6] - corner[4]) + (corner[7] - corner[5])),
+					((corner[1] - corner[0]) + (corner[3] - corner[2])) + ((corner[5] - corner[4]) + (corner[7] - corner[6])));
+				float length = glm::length(gradient);
+
+				cell_vertex[((size_t)i * cells + j) * cells + k] = (int32_t)chunk.vertices.size();
+				chunk.vertices.push_back(glm::vec3(x0 + i + p.x - half_x, y0 + j + p.y, z0 + k + p.z - half_z));
+				chunk.normals.push_back(length > 0 ? -gradient / length : glm::vec3(0, 1, 0));
+			}
+		}
+	}
+
+	/*
+		a quad around every edge between two samples the surface crosses, joining the vertices of the 4 cells
+		around it. the chunk owns the edges starting at its own samples, so every quad is made by one chunk.
+		the heightmap only has quads between its first and last point, like the terrain mesh
+	*/
+	int last_x = density.size_x() - 1;
+	int last_z = density.size_z() - 1;
+	for (int i = 1; i <= n; i++)
+	{
+		if (x0 + i < 1 || x0 + i >= last_x) continue;
+		for (int k = 1; k <= n; k++)
+		{
+			if (z0 + k < 1 || z0 + k >= last_z) continue;
+			for (int j = 1; j <= n; j++)
+			{
+				float here = d[((size_t)i * s + j) * s + k];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					int di = axis == 0, dj = axis == 1, dk = axis == 2;
+					float there = d[((size_t)(i + di) * s + j + dj) * s + k + dk];
+					if ((here > 0) == (there > 0))
+						continue;
+
+					// the 4 cells around the edge, in order around it seen from the end of the edge: the two
+					// other axes taken in cyclic order
+					int32_t quad[4];
+					for (int q = 0; q < 4; q++)
+					{
+						int u = q == 1 || q == 2;
+						int v = q >= 2;
+						int ci = i - (axis == 1 ? 1 - v : (axis == 2 ? 1 - u : 0));
+						int cj = j - (axis == 2 ? 1 - v : (axis == 0 ? 1 - u : 0));
+						int ck = k - (axis == 0 ? 1 - v : (axis == 1 ? 1 - u : 0));
+						quad[q] = cell_vertex[((size_t)ci * cells + cj) * cells + ck];
+					}
+
+					// faces point from the rock to the air
+					if (here > 0)
+					{
+						chunk.indices.push_back(quad[0]); chunk.indices.push_back(quad[1]); chunk.indices.push_back(quad[2]);
+						chunk.indices.push_back(quad[0]); chunk.indices.push_back(quad[2]); chunk.indices.push_back(quad[3]);
+					}
+					else
+					{
+						chunk.indices.push_back(quad[0]); chunk.indices.push_back(quad[2]); chunk.indices.push_back(quad[1]);
+						chunk.indices.push_back(quad[0]); chunk.indices.push_back(quad[3]); chunk.indices.push_back(quad[2]);
+					}
+				}
+			}
+		}
+	}
+
+	// vertices only used by quads of the neighbouring chunks
+	if (chunk.indices.empty())
+	{
+		chunk.vertices.clear();
+		chunk.normals.clear();
+	}
+}
+
+template void mesh_cave_chunk<cave_density>(const cave_density& density, int x, int y, int z, cave_chunk& chunk);
+template void mesh_cave_chunk<voxel_bricks>(const voxel_bricks& density, int x, int y, int z, cave_chunk& chunk);
+
+// round down to chunks, for negative voxels too
+static inline int chunk_floor(int v, int size)
+{
+	return v >= 0 ? v / size : -((-v + size - 1) / size);
+}
+
+// lowest and highest ground under every column of chunks, with the samples past its edges, and over all of them
+static void chunk_column_bounds(const cave_density& density, std::vector<float>& column_min, std::vector<float>& column_max, float& lowest, float& highest)
+{
+	const int n = CAVE_CHUNK_SIZE;
+	int count_x = (density.size_x() + n - 1) / n;
+	int count_z = (density.size_z() + n - 1) / n;
+	column_min.assign((size_t)count_x * count_z, INFINITY);
+	column_max.assign((size_t)count_x * count_z, -INFINITY);
+	lowest = INFINITY;
+	highest = -INFINITY;
+	for (int cx = 0; cx < count_x; cx++)
+	{
+		for (int cz = 0; cz < count_z; cz++)
+		{
+			float& mn = column_min[(size_t)cx * count_z + cz];
+			float& mx = column_max[(size_t)cx * count_z + cz];
+			for (int x = cx * n - 1; x <= cx * n + n; x++)
+			{
+				for (int z = cz * n - 1; z <= cz * n + n; z++)
+				{
+					float g = density.ground_height(x, z);
+					mn = std::min(mn, g);
+					mx = std::max(mx, g);
+				}
+			}
+			lowest = std::min(lowest, mn);
+			highest = std::max(highest, mx);
+		}
+	}
+}
+
+// mesh the chunks in parallel and keep the ones with triangles, in the order of jobs
+template <typename Density>
+static void mesh_chunk_list(const Density& density, const std::vector<glm::ivec3>& jobs, std::vector<cave_chunk>& chunks, cave_mesh_stats& stats, thread_pool& pool)
+{
+	std::vector<cave_chunk> meshed(jobs.size());
+	pool.parallel_for((int)jobs.size(), [&](int i)
+	{
+		mesh_cave_chunk(density, jobs[i].x, jobs[i].y, jobs[i].z, meshed[i]);
+	});
+
+	chunks.clear();
+	stats.vertices = 0;
+	stats.triangles = 0;
+	for (size_t i = 0; i < meshed.size(); i++)
+	{
+		if (meshed[i].indices.empty())
+			continue;
+		stats.vertices += meshed[i].vertices.size();
+		stats.triangles += meshed[i].indices.size() / 3;
+		chunks.push_back(std::move(meshed[i]));
+	}
+	stats.meshed = (int)jobs.size();
+}
+
+void mesh_caves(const cave_density& density, std::vector<cave_chunk>& chunks, cave_mesh_stats& stats, thread_pool& pool)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const int n = CAVE_CHUNK_SIZE;
+	int count_x = (density.size_x() + n - 1) / n;
+	int count_z = (density.size_z() + n - 1) / n;
+
+	std::vector<float> column_min, column_max;
+	float lowest, highest;
+	chunk_column_bounds(density, column_min, column_max, lowest, highest);
+
+	// chunks entirely above the ground are air, chunks entirely below the deepest caves are rock
+	int first_y = (int)floor((lowest - density.max_depth() - 1) / n);
+	int last_y = (int)floor((highest + 1) / n);
+	std::vector<glm::ivec3> jobs;
+	for (int cx = 0; cx < count_x; cx++)
+	{
+		for (int cz = 0; cz < count_z; cz++)
+		{
+			for (int cy = first_y; cy <= last_y; cy++)
+			{
+				float bottom = (float)(cy * n - 1);
+				float top = (float)(cy * n + n);
+				if (bottom > column_max[(size_t)cx * count_z + cz] || top < column_min[(size_t)cx * count_z + cz] - density.max_depth() - 1)
+					continue;
+				jobs.push_back(glm::ivec3(cx, cy, cz));
+			}
+		}
+	}
+
+	mesh_chunk_list(density, jobs, chunks, stats, pool);
+	stats.chunks = count_x * count_z * (last_y - first_y + 1);
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// x, then z, then y, the order mesh_caves goes through the chunks in
+static bool chunk_order(const glm::ivec3& a, const glm::ivec3& b)
+{
+	if (a.x != b.x) return a.x < b.x;
+	if (a.z != b.z) return a.z < b.z;
+	return a.y < b.y;
+}
+
+void mesh_caves(const voxel_bricks& bricks, std::vector<cave_chunk>& chunks, cave_mesh_stats& stats, thread_pool& pool)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const int n = CAVE_CHUNK_SIZE;
+	const int per_chunk = CAVE_CHUNK_SIZE / VOXEL_BRICK_SIZE;
+	int count_x = (bricks.size_x() + n - 1) / n;
+	int count_z = (bricks.size_z() + n - 1) / n;
+
+	/*
+		a chunk makes the quads of the edges starting at its samples, and the surface can only cross an edge
+		from a brick with its own voxels. a brick on the near side of a chunk can also have been edited into
+		crossing from the chunk before it, which is meshed too
+	*/
+	std::vector<glm::ivec3> surface;
+	bricks.surface_bricks(surface);
+	std::vector<glm::ivec3> jobs;
+	for (size_t i = 0; i < surface.size(); i++)
+	{
+		glm::ivec3 c(chunk_floor(surface[i].x, per_chunk), chunk_floor(surface[i].y, per_chunk), chunk_floor(surface[i].z, per_chunk));
+		glm::ivec3 near_side = surface[i] - c * per_chunk;
+		for (int d = 0; d < 8; d++)
+		{
+			glm::ivec3 step(d >> 2 & 1, d >> 1 & 1, d & 1);
+			if ((step.x && near_side.x != 0) || (step.y && near_side.y != 0) || (step.z && near_side.z != 0))
+				continue;
+			glm::ivec3 chunk = c - step;
+			if (chunk.x >= 0 && chunk.x < count_x && chunk.z >= 0 && chunk.z < count_z)
+				jobs.push_back(chunk);
+		}
+	}
+	std::sort(jobs.begin(), jobs.end(), chunk_order);
+	jobs.erase(std::unique(jobs.begin(), jobs.end()), jobs.end());
+
+	mesh_chunk_list(bricks, jobs, chunks, stats, pool);
+	int first_y = 0, last_y = -1;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		first_y = i == 0 ? jobs[i].y : std::min(first_y, jobs[i].y);
+		last_y = i == 0 ? jobs[i].y : std::max(last_y, jobs[i].y);
+	}
+	stats.chunks = count_x * count_z * (last_y - first_y + 1);
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the bricks a job found in its column of chunks, before they are added to the store
+struct stored_column
+{
+	// floor of every column of bricks in it
+	std::vector<int> floors;
+
+	// the value of the bricks that are one value, NAN for the ones with their own voxels, which follow each
+	// other in voxels
+	std::vector<glm::ivec3> positions;
+	std::vector<float> uniform;
+	std::vector<float> voxels;
+};
+
+void store_caves(const cave_density& density, voxel_bricks& bricks, thread_pool& pool)
+{
+	const int n = CAVE_CHUNK_SIZE;
+	const int b = VOXEL_BRICK_SIZE;
+	const int per_chunk = n / b;
+	int count_x = (density.size_x() + n - 1) / n;
+	int count_z = (density.size_z() + n - 1) / n;
+
+	std::vector<float> column_min, column_max;
+	float lowest, highest;
+	chunk_column_bounds(density, column_min, column_max, lowest, highest);
+
+	// the chunks where the density isn't clamped to rock below or air above, with the voxel past them
+	const float margin = VOXEL_TRUNCATION + 1;
+	bricks.reset(density.size_x(), density.size_z(), (int)floor((lowest - density.max_depth() - margin) / n) * per_chunk);
+
+	std::vector<stored_column> row(count_z);
+	for (int cx = 0; cx < count_x; cx++)
+	{
+		pool.parallel_for(count_z, [&](int cz)
+		{
+			stored_column& column = row[cz];
+			column.floors.assign(per_chunk * per_chunk, INT_MIN);
+			column.positions.clear();
+			column.uniform.clear();
+			column.voxels.clear();
+
+			int first_y = (int)floor((column_min[(size_t)cx * count_z + cz] - density.max_depth() - margin) / n);
+			int last_y = (int)floor((column_max[(size_t)cx * count_z + cz] + margin) / n);
+			const int s = n + 2;
+			const int bs = b + 2;
+			std::vector<float> d((size_t)s * s * s);
+			std::vector<float> brick((size_t)bs * bs * bs);
+			for (int cy = first_y; cy <= last_y; cy++)
+			{
+				density.sample(cx * n - 1, cy * n - 1, cz * n - 1, s, &d[0]);
+				for (int bi = 0; bi < per_chunk; bi++)
+				{
+					for (int bk = 0; bk < per_chunk; bk++)
+					{
+						int bx = cx * per_chunk + bi;
+						int bz = cz * per_chunk + bk;
+						if (bx >= bricks.columns_x() || bz >= bricks.columns_z())
+							continue;
+
+						int& floor_y = column.floors[bi * per_chunk + bk];
+						for (int bj = 0; bj < per_chunk; bj++)
+						{
+							for (int i = 0; i < bs; i++)
+								for (int j = 0; j < bs; j++)
+									memcpy(&brick[((size_t)i * bs + j) * bs], &d[((size_t)(bi * b + i) * s + bj * b + j) * s + bk * b], bs * sizeof(float));
+
+							// rock up to the first brick that isn't, air past it unless stored
+							bool uniform = voxel_bricks::is_uniform(&brick[0]);
+							float value = brick[(bs + 1) * bs + 1];
+							if (floor_y == INT_MIN)
+							{
+								if (uniform && value > 0)
+									continue;
+								floor_y = cy * per_chunk + bj;
+							}
+							if (uniform && value <= -VOXEL_TRUNCATION)
+								continue;
+
+							column.positions.push_back(glm::ivec3(bx, cy * per_chunk + bj, bz));
+							column.uniform.push_back(uniform ? value : NAN);
+							if (!uniform)
+							{
+								for (int i = 0; i < b; i++)
+									for (int j = 0; j < b; j++)
+										column.voxels.insert(column.voxels.end(), &brick[((size_t)(i + 1) * bs + j + 1) * bs + 1], &brick[((size_t)(i + 1) * bs + j + 1) * bs + 1 + b]);
+							}
+						}
+					}
+				}
+			}
+
+			// every brick of the column was rock
+			for (size_t f = 0; f < column.floors.size(); f++)
+				if (column.floors[f] == INT_MIN)
+					column.floors[f] = (last_y + 1) * per_chunk;
+		});
+
+		for (int cz = 0; cz < count_z; cz++)
+		{
+			stored_column& column = row[cz];
+			for (int bi = 0; bi < per_chunk; bi++)
+			{
+				for (int bk = 0; bk < per_chunk; bk++)
+				{
+					int bx = cx * per_chunk + bi;
+					int bz = cz * per_chunk + bk;
+					if (bx < bricks.columns_x() && bz < bricks.columns_z())
+						bricks.set_floor(bx, bz, column.floors[bi * per_chunk + bk]);
+				}
+			}
+
+			size_t voxels = 0;
+			for (size_t i = 0; i < column.positions.size(); i++)
+			{
+				const glm::ivec3& p = column.positions[i];
+				if (column.uniform[i] == column.uniform[i])
+					bricks.set_uniform(p.x, p.y, p.z, column.uniform[i]);
+				else
+				{
+					bricks.set_brick(p.x, p.y, p.z, &column.voxels[voxels]);
+					voxels += VOXEL_BRICK_VOXELS;
+				}
+			}
+		}
+	}
+	bricks.shrink_to_fit();
+}
@@ -0,0 +1,114 @@
+#ifndef CAVES_DEF
+#define CAVES_DEF
+
+#include <stdint.h>
+#include <vector>
+#include <internal/heightfield.h>
+#include <internal/thread_pool.h>
+#include <internal/voxel_bricks.h>
+#include <glm/glm.hpp>
+
+/*
+	caves, and the island around them, as a 3D density field: positive in rock and negative in air. the ground
+	is the heightmap, and tunnels are cut out of it where two 3D noise fields are both close to zero, which
+	makes long winding tubes instead of blobs. the field is meshed in cubic chunks of voxels one point of the
+	heightmap wide with surface nets.
+*/
+
+// voxels per side of a chunk
+#define CAVE_CHUNK_SIZE 32
+
+// the tunnel noise is evaluated every this many voxels and interpolated in between, it's much smoother than that
+#define CAVE_NOISE_STEP 2
+
+struct cave_settings
+{
+	uint32_t seed;
+
+	// size of the tunnel noise features in voxels, and how far from the middle of a tunnel its wall is, in noise units
+	double period;
+	double radius;
+
+	// rock left between the ground and the caves (0 lets them open to the surface), and how deep they go
+	double min_cover;
+	double max_depth;
+};
+
+cave_settings default_cave_settings(uint64_t seed);
+
+// density at voxel x, y, z, with x and z points of heights and y the height
+class cave_density
+{
+public:
+	cave_density(const heightfield<float>& heights, const cave_settings& settings);
+
+	float operator()(int x, int y, int z) const;
+
+	// the same for a block of size^3 voxels from x0, y0, z0 into out[(i * size + j) * size + k], sharing the
+	// noise evaluations between the voxels
+	void sample(int x0, int y0, int z0, int size, float* out) const;
+
+	// height of the ground at point x, z of the heightmap, the edge points continue past the edges
+	float ground_height(int x, int z) const;
+
+	int size_x() const { return ground.size_x(); }
+	int size_z() const { return ground.size_y(); }
+	double max_depth() const { return settings.max_depth; }
+
+private:
+	// rock the tunnels can't cut into at depth below the ground, and whether the tunnels matter at all there
+	float cover(float depth) const;
+	bool needs_tunnel(float depth, float cover) const { return cover < depth && cover < tunnel_max; }
+	float combine(float depth, float cover, float a, float b) const;
+	void tunnel_noise(int lx, int ly, int lz, float& a, float& b) const;
+
+	const heightfield<float>& ground;
+	cave_settings settings;
+	float inv_period;
+	float tunnel_scale;
+	float tunnel_max;
+};
+
+/*
+	one chunk of the mesh, vertices shared by the triangles around them. the vertices on the edge of a chunk
+	are computed the same way as in the chunk next to it, so chunks meet without cracks
+*/
+struct cave_chunk
+{
+	int x;
+	int y;
+	int z;
+
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec3> normals;
+	std::vector<uint32_t> indices;
+};
+
+// mesh chunk x, y, z (in chunks) of a cave_density or a voxel_bricks with surface nets. vertices are in world
+// coordinates, like the terrain mesh of a heightmap with points one unit apart
+template <typename Density>
+void mesh_cave_chunk(const Density& density, int x, int y, int z, cave_chunk& chunk);
+
+struct cave_mesh_stats
+{
+	int chunks;    // chunks in the volume of the island
+	int meshed;    // chunks that cross the surface and had to be meshed
+	size_t vertices;
+	size_t triangles;
+	double seconds;
+};
+
+// mesh every chunk of the island that crosses the surface, one job per chunk. chunks without triangles are left out
+void mesh_caves(const cave_density& density, std::vector<cave_chunk>& chunks, cave_mesh_stats& stats, thread_pool& pool);
+
+// the same from the bricks, meshing only the chunks with bricks the surface goes through
+void mesh_caves(const voxel_bricks& bricks, std::vector<cave_chunk>& chunks, cave_mesh_stats& stats, thread_pool& pool);
+
+/*
+	sample the density into bricks, one column of chunks per job, keeping only what the surface goes through.
+	the columns are added to the bricks in order, a row of them at a time, so the store is the same whatever
+	the number of threads
+*/
+void store_caves(const cave_density& density, voxel_bricks& bricks, thread_pool& pool);
+
+#endif // !CAVES_DEF
@@ -0,0 +1,240 @@
+#include <internal/compact_heightfield.h>
+#include <internal/heightfield_ops.h>
+#include <algorithm>
+#include <cmath>
+
+glm::vec3 material_color(terrain_material material)
+{
+	switch (material)
+	{
+	case MATERIAL_SAND:
+		return glm::vec3(0.76, 0.7, 0.5);
+	default:
+		return glm::vec3(0.2, 1, 0.2);
+	}
+}
+
+/*
+	row kernels. a height is quantized as (int)((h - offset) * inverse + 0.5) clamped to 0 .. 65535 and comes
+	back as q * scale + offset. the SIMD paths clamp by packing q - 32768 with signed saturation and flipping
+	the sign bit back, which is the same clamp for everything the truncation can give
+*/
+
+static inline void quantize_scalar(const float* row, float offset, float inverse, int j, int n, uint16_t* out)
+{
+	for (; j < n; j++)
+	{
+		int q = (int)((row[j] - offset) * inverse + 0.5f);
+		out[j] = (uint16_t)std::min(std::max(q, 0), 65535);
+	}
+}
+
+static inline void dequantize_scalar(const uint16_t* row, float offset, float scale, int j, int n, float* out)
+{
+	for (; j < n; j++)
+		out[j] = (float)row[j] * scale + offset;
+}
+
+typedef void (*quantize_row_func)(const float* row, float offset, float inverse, int n, uint16_t* out);
+typedef void (*dequantize_row_func)(const uint16_t* row, float offset, float scale, int n, float* out);
+
+static void quantize_row_scalar(const float* row, float offset, float inverse, int n, uint16_t* out)
+{
+	quantize_scalar(row, offset, inverse, 0, n, out);
+}
+
+static void dequantize_row_scalar(const uint16_t* row, float offset, float scale, int n, float* out)
+{
+	dequantize_scalar(row, offset, scale, 0, n, out);
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET_SSE2 static void quantize_row_sse2(const float* row, float offset, float inverse, int n, uint16_t* out)
+{
+	const __m128 o = _mm_set1_ps(offset);
+	const __m128 inv = _mm_set1_ps(inverse);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128i bias = _mm_set1_epi32(32768);
+	const __m128i sign = _mm_set1_epi16((short)0x8000);
+
+	int j = 0;
+	for (; j + 8 <= n; j += 8)
+	{
+		__m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + j), o), inv), half));
+		__m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + j + 4), o), inv), half));
+		__m128i q = _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias));
+		_mm_storeu_si128((__m128i*)(out + j), _mm_xor_si128(q, sign));
+	}
+	quantize_scalar(row, offset, inverse, j, n, out);
+}
+
+SIMD_TARGET_SSE2 static void dequantize_row_sse2(const uint16_t* row, float offset, float scale, int n, float* out)
+{
+	const __m128 o = _mm_set1_ps(offset);
+	const __m128 s = _mm_set1_ps(scale);
+	const __m128i zero = _mm_setzero_si128();
+
+	int j = 0;
+	for (; j + 8 <= n; j += 8)
+	{
+		__m128i q = _mm_loadu_si128((const __m128i*)(row + j));
+		__m128 a = _mm_cvtepi32_ps(_mm_unpacklo_epi16(q, zero));
+		__m128 b = _mm_cvtepi32_ps(_mm_unpackhi_epi16(q, zero));
+		_mm_storeu_ps(out + j, _mm_add_ps(_mm_mul_ps(a, s), o));
+		_mm_storeu_ps(out + j + 4, _mm_add_ps(_mm_mul_ps(b, s), o));
+	}
+	dequantize_scalar(row, offset, scale, j, n, out);
+}
+
+SIMD_TARGET_AVX2 static void quantize_row_avx2(const float* row, float offset, float inverse, int n, uint16_t* out)
+{
+	const __m256 o = _mm256_set1_ps(offset);
+	const __m256 inv = _mm256_set1_ps(inverse);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256i bias = _mm256_set1_epi32(32768);
+	const __m256i sign = _mm256_set1_epi16((short)0x8000);
+
+	int j = 0;
+	for (; j + 16 <= n; j += 16)
+	{
+		__m256i a = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row + j), o), inv), half));
+		__m256i b = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row + j + 8), o), inv), half));
+
+		// packing works in 128 bit lanes, put the 4 x 4 values back in order
+		__m256i q = _mm256_packs_epi32(_mm256_sub_epi32(a, bias), _mm256_sub_epi32(b, bias));
+		q = _mm256_permute4x64_epi64(q, 0xD8);
+		_mm256_storeu_si256((__m256i*)(out + j), _mm256_xor_si256(q, sign));
+	}
+	quantize_scalar(row, offset, inverse, j, n, out);
+}
+
+SIMD_TARGET_AVX2 static void dequantize_row_avx2(const uint16_t* row, float offset, float scale, int n, float* out)
+{
+	const __m256 o = _mm256_set1_ps(offset);
+	const __m256 s = _mm256_set1_ps(scale);
+
+	int j = 0;
+	for (; j + 8 <= n; j += 8)
+	{
+		__m256 q = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(row + j))));
+		_mm256_storeu_ps(out + j, _mm256_add_ps(_mm256_mul_ps(q, s), o));
+	}
+	dequantize_scalar(row, offset, scale, j, n, out);
+}
+
+#endif
+
+static void select_row_kernels(quantize_row_func& quantize, dequantize_row_func& dequantize)
+{
+	quantize = quantize_row_scalar;
+	dequantize = dequantize_row_scalar;
+#ifdef SIMD_X86
+	switch (simd_detect())
+	{
+	case SIMD_AVX2:
+		quantize = quantize_row_avx2;
+		dequantize = dequantize_row_avx2;
+		break;
+	case SIMD_SSE2:
+		quantize = quantize_row_sse2;
+		dequantize = dequantize_row_sse2;
+		break;
+	default:
+		break;
+	}
+#endif
+}
+
+// lowest and highest height of a part of the map
+struct quantize_range
+{
+	float min;
+	float max;
+};
+
+static quantize_range merge_ranges(quantize_range a, const quantize_range& b)
+{
+	a.min = std::min(a.min, b.min);
+	a.max = std::max(a.max, b.max);
+	return a;
+}
+
+void quantized_heights::encode(const heightfield<float>& heights, thread_pool& pool)
+{
+	quantize_row_func quantize;
+	dequantize_row_func dequantize;
+	select_row_kernels(quantize, dequantize);
+
+	quantize_range start = { INFINITY, -INFINITY };
+	quantize_range range = pool.parallel_reduce(heights.size_x(), HEIGHTFIELD_BLOCK_ROWS, start, [&](int x0, int x1)
+	{
+		quantize_range r = start;
+		for (int x = x0; x < x1; x++)
+		{
+			const float* row = heights[x];
+			for (int j = 0; j < heights.size_y(); j++)
+			{
+				r.min = std::min(r.min, row[j]);
+				r.max = std::max(r.max, row[j]);
+			}
+		}
+		return r;
+	}, merge_ranges);
+
+	// a flat (or empty) map is all offset
+	offset = heights.empty() ? 0 : range.min;
+	scale = heights.empty() ? 0 : (range.max - range.min) / 65535.0f;
+	float inverse = scale > 0 ? 1 / scale : 0;
+
+	values.resize(heights.size_x(), heights.size_y());
+	pool.parallel_for(heights.size_x(), [&](int x)
+	{
+		quantize(heights[x], offset, inverse, heights.size_y(), values[x]);
+	});
+}
+
+void quantized_heights::decode(heightfield<float>& heights, thread_pool& pool) const
+{
+	quantize_row_func quantize;
+	dequantize_row_func dequantize;
+	select_row_kernels(quantize, dequantize);
+
+	heights.resize(values.size_x(), values.size_y());
+	pool.parallel_for(values.size_x(), [&](int x)
+	{
+		dequantize(values[x], offset, scale, values.size_y(), heights[x]);
+	});
+}
+
+void quantized_heights::decode_row(int x, float* out) const
+{
+	quantize_row_func quantize;
+	dequantize_row_func dequantize;
+	select_row_kernels(quantize, dequantize);
+
+	dequantize(values[x], offset, scale, values.size_y(), out);
+}
+
+void material_layer::resize(int size_x, int size_y)
+{
+	width = size_x;
+	height = size_y;
+	row_words = ((size_t)size_y + 63) / 64;
+	bits.assign((size_t)size_x * row_words, 0);
+}
+
+void material_layer::set_material(int x, int y, terrain_material material)
+{
+	uint64_t& word = bits[(size_t)x * row_words + (y >> 6)];
+	uint64_t bit = (uint64_t)1 << (y & 63);
+	word = material == MATERIAL_SAND ? word | bit : word & ~bit;
+}
+
+void material_layer::color_row(int x, glm::vec3* out) const
+{
+	glm::vec3 palette[2] = { material_color(MATERIAL_GRASS), material_color(MATERIAL_SAND) };
+	const uint64_t* words = &bits[(size_t)x * row_words];
+	for (int y = 0; y < height; y++)
+		out[y] = palette[(words[y >> 6] >> (y & 63)) & 1];
+}
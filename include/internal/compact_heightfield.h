@@ -0,0 +1,95 @@
+#ifndef COMPACT_HEIGHTFIELD_DEF
+#define COMPACT_HEIGHTFIELD_DEF
+
+#include <vector>
+#include <internal/heightfield.h>
+#include <internal/thread_pool.h>
+#include <internal/simd.h>
+#include <glm/glm.hpp>
+
+/*
+	compact storage of an island, for keeping it around once it's generated. the heights are quantized to
+	16 bits between the lowest and highest point of the island, and the material of every point is a bit
+	in a layer of its own, so a 1536 x 1536 island is 4.5 MB of heights and 288 KB of materials instead of
+	9 MB of floats and 27 MB of colors.
+*/
+
+// what the ground of a point is made of
+enum terrain_material
+{
+	MATERIAL_GRASS = 0,
+	MATERIAL_SAND = 1
+};
+
+// color the terrain is drawn with for a material
+glm::vec3 material_color(terrain_material material);
+
+/*
+	heights as offset + q * scale with q from 0 to 65535, which is within about max_error() of the floats they were
+	made from. 16 bit quantization over the range of one island keeps the same precision everywhere, where
+	half floats lose most of it on the high ground. every path gives the same values
+*/
+class quantized_heights
+{
+public:
+	quantized_heights() : offset(0), scale(0) {}
+
+	// quantize heights, a row per job of the pool
+	void encode(const heightfield<float>& heights, thread_pool& pool);
+
+	// back to floats, a row per job of the pool
+	void decode(heightfield<float>& heights, thread_pool& pool) const;
+
+	// the heights of row x
+	void decode_row(int x, float* out) const;
+
+	float height(int x, int y) const { return offset + values[x][y] * scale; }
+
+	int size_x() const { return values.size_x(); }
+	int size_y() const { return values.size_y(); }
+	const heightfield<uint16_t>& raw() const { return values; }
+
+	float height_offset() const { return offset; }
+	float height_scale() const { return scale; }
+	float max_error() const { return scale / 2; }
+
+	size_t memory() const { return sizeof(quantized_heights) + values.size() * sizeof(uint16_t); }
+
+private:
+	heightfield<uint16_t> values;
+	float offset;
+	float scale;
+};
+
+// materials of the points of a map, a bit per point, every row starting on a word of its own
+class material_layer
+{
+public:
+	material_layer() : width(0), height(0), row_words(0) {}
+
+	// all grass
+	void resize(int size_x, int size_y);
+
+	terrain_material material(int x, int y) const
+	{
+		return (terrain_material)((bits[(size_t)x * row_words + (y >> 6)] >> (y & 63)) & 1);
+	}
+
+	void set_material(int x, int y, terrain_material material);
+
+	// the colors of the points of row x
+	void color_row(int x, glm::vec3* out) const;
+
+	int size_x() const { return width; }
+	int size_y() const { return height; }
+
+	size_t memory() const { return sizeof(material_layer) + bits.capacity() * sizeof(uint64_t); }
+
+private:
+	int width;
+	int height;
+	size_t row_words;
+	std::vector<uint64_t> bits;
+};
+
+#endif // !COMPACT_HEIGHTFIELD_DEF
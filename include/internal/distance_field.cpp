@@ -0,0 +1,127 @@
+#include <internal/distance_field.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/*
+	squared distance from every point of a column of n points to the nearest target, with g2 the squared distance
+	along the rows to the nearest target (0 on the targets themselves). s and t are the lower envelope: the point
+	of the column whose parabola is lowest, and where it starts to be
+*/
+static void column_distance(const int32_t* g2, int n, int32_t* s, int32_t* t, int32_t* out)
+{
+	auto f = [g2](int x, int i) { return (x - i) * (x - i) + g2[i]; };
+
+	int q = 0;
+	s[0] = 0;
+	t[0] = 0;
+	for (int u = 1; u < n; u++)
+	{
+		while (q >= 0 && f(t[q], s[q]) > f(t[q], u))
+			q--;
+		if (q < 0)
+		{
+			q = 0;
+			s[0] = u;
+		}
+		else
+		{
+			// first point u is closer than s[q]. that is past t[q], so the division of a positive number rounds down
+			int w = 1 + (u * u - s[q] * s[q] + g2[u] - g2[s[q]]) / (2 * (u - s[q]));
+			if (w < n)
+			{
+				q++;
+				s[q] = u;
+				t[q] = w;
+			}
+		}
+	}
+
+	for (int u = n - 1; u >= 0; u--)
+	{
+		out[u] = f(u, s[q]);
+		if (u == t[q])
+			q--;
+	}
+}
+
+void signed_distance_field(const heightfield<uint8_t>& inside, float spacing, heightfield<float>& distance, thread_pool& pool)
+{
+	int size_x = inside.size_x();
+	int size_y = inside.size_y();
+	distance.resize(size_x, size_y);
+	if (inside.empty())
+		return;
+
+	// longer than any distance on the map, and small enough to square
+	int far = size_x + size_y;
+
+	// along the rows, the distance to the nearest point on the other side: the last one before and the next after
+	heightfield<int32_t> rows(size_x, size_y);
+	pool.parallel_for(size_x, [&](int x)
+	{
+		const uint8_t* in = inside[x];
+		int32_t* g = rows[x];
+
+		int last[2] = { -far, -far };
+		for (int y = 0; y < size_y; y++)
+		{
+			int side = in[y] != 0;
+			last[side] = y;
+			g[y] = std::min(y - last[!side], far);
+		}
+
+		int next[2] = { size_y + far, size_y + far };
+		for (int y = size_y - 1; y >= 0; y--)
+		{
+			int side = in[y] != 0;
+			next[side] = y;
+			g[y] = std::min(g[y], next[!side] - y);
+		}
+	});
+
+	// along the columns, a block of them at a time copied out so the strided reads are whole cache lines
+	int blocks = (size_y + DISTANCE_BLOCK_COLUMNS - 1) / DISTANCE_BLOCK_COLUMNS;
+	pool.parallel_for(blocks, [&](int b)
+	{
+		int y0 = b * DISTANCE_BLOCK_COLUMNS;
+		int columns = std::min(DISTANCE_BLOCK_COLUMNS, size_y - y0);
+
+		// squared row distances to the points outside and inside, 0 on the points that are
+		std::vector<int32_t> to_outside((size_t)columns * size_x), to_inside((size_t)columns * size_x);
+		std::vector<float> result((size_t)columns * size_x);
+		std::vector<int32_t> s(size_x), t(size_x), outside_distance(size_x), inside_distance(size_x);
+
+		for (int x = 0; x < size_x; x++)
+		{
+			const uint8_t* in = inside[x] + y0;
+			const int32_t* g = rows[x] + y0;
+			for (int c = 0; c < columns; c++)
+			{
+				int32_t g2 = g[c] * g[c];
+				to_outside[(size_t)c * size_x + x] = in[c] ? g2 : 0;
+				to_inside[(size_t)c * size_x + x] = in[c] ? 0 : g2;
+			}
+		}
+
+		for (int c = 0; c < columns; c++)
+		{
+			const int32_t* outside_rows = &to_outside[(size_t)c * size_x];
+			const int32_t* inside_rows = &to_inside[(size_t)c * size_x];
+			column_distance(outside_rows, size_x, &s[0], &t[0], &outside_distance[0]);
+			column_distance(inside_rows, size_x, &s[0], &t[0], &inside_distance[0]);
+
+			// the points inside are the ones with a distance along the row to the outside
+			float* out = &result[(size_t)c * size_x];
+			for (int x = 0; x < size_x; x++)
+				out[x] = outside_rows[x] > 0 ? sqrtf((float)outside_distance[x]) * spacing : -sqrtf((float)inside_distance[x]) * spacing;
+		}
+
+		for (int x = 0; x < size_x; x++)
+		{
+			float* out = distance[x] + y0;
+			for (int c = 0; c < columns; c++)
+				out[c] = result[(size_t)c * size_x + x];
+		}
+	});
+}
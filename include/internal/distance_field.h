@@ -0,0 +1,25 @@
+#ifndef DISTANCE_FIELD_DEF
+#define DISTANCE_FIELD_DEF
+
+#include <internal/heightfield.h>
+#include <internal/thread_pool.h>
+
+// columns of the map handled by one job of the second pass
+#define DISTANCE_BLOCK_COLUMNS 16
+
+/*
+	exact euclidean distance transform in linear time (Meijster, Roerdink and Hesselink), separable into a pass
+	along every row and then one along every column, each of them a job per row or block of columns. the rows
+	find the distance to the nearest point of the other side along the row, the columns then take the lower
+	envelope of the parabolas (x - i)^2 + g(i)^2 over the column, which is the exact squared distance.
+	everything before the square root is integers, so the field doesn't depend on the thread count.
+*/
+
+/*
+	signed distance from every point to the nearest point on the other side of the edge of inside (anything not
+	0), with the points spacing apart: positive inside, negative outside. a map that is all inside or outside
+	gets distances longer than the map
+*/
+void signed_distance_field(const heightfield<uint8_t>& inside, float spacing, heightfield<float>& distance, thread_pool& pool);
+
+#endif // !DISTANCE_FIELD_DEF
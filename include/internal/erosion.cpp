@@ -0,0 +1,385 @@
+#include <internal/erosion.h>
+#include <internal/terrain_random.h>
+#include <internal/heightfield_ops.h>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <chrono>
+
+erosion_settings default_erosion_settings(int droplets)
+{
+	erosion_settings settings;
+	settings.droplets = droplets;
+	settings.lifetime = 30;
+	settings.inertia = 0.05;
+	settings.capacity = 4;
+	settings.min_capacity = 0.01;
+	settings.erode_speed = 0.3;
+	settings.deposit_speed = 0.3;
+	settings.evaporate_speed = 0.01;
+	settings.gravity = 4;
+	settings.radius = 3;
+	settings.thermal_iterations = 40;
+	settings.talus = 1.0;
+	settings.thermal_rate = 0.1;
+	settings.thermal_budget = 0;
+	return settings;
+}
+
+// cells a droplet erodes from, relative to the cell it is in, with weights that add up to 1
+struct erosion_brush
+{
+	std::vector<int> dx;
+	std::vector<int> dy;
+	std::vector<double> weight;
+};
+
+static void build_brush(int radius, erosion_brush& brush)
+{
+	double sum = 0;
+	for (int x = -radius; x <= radius; x++)
+	{
+		for (int y = -radius; y <= radius; y++)
+		{
+			double distance = sqrt((double)(x * x + y * y));
+			if (distance < radius)
+			{
+				brush.dx.push_back(x);
+				brush.dy.push_back(y);
+				brush.weight.push_back(1 - distance / radius);
+				sum += 1 - distance / radius;
+			}
+		}
+	}
+	for (size_t i = 0; i < brush.weight.size(); i++)
+		brush.weight[i] /= sum;
+}
+
+// height at x, y interpolated from the 4 points around it, and the slope there
+static inline double height_gradient(const heightfield<double>& map, double x, double y, double& gx, double& gy)
+{
+	int i = (int)x;
+	int j = (int)y;
+	double u = x - i;
+	double v = y - j;
+
+	double h00 = map[i][j];
+	double h01 = map[i][j + 1];
+	double h10 = map[i + 1][j];
+	double h11 = map[i + 1][j + 1];
+
+	gx = (h10 - h00) * (1 - v) + (h11 - h01) * v;
+	gy = (h01 - h00) * (1 - u) + (h11 - h10) * u;
+	return h00 * (1 - u) * (1 - v) + h10 * u * (1 - v) + h01 * (1 - u) * v + h11 * u * v;
+}
+
+/*
+	run count droplets spawned in [x0, x1) x [y0, y1). they stop when they reach the edge of
+	[lo_x, hi_x) x [lo_y, hi_y) (the cells they may touch) minus the radius of the brush
+*/
+static void run_droplets(heightfield<double>& map, const erosion_settings& settings, const erosion_brush& brush, uint64_t seed, int key, int count,
+	int x0, int x1, int y0, int y1, int lo_x, int hi_x, int lo_y, int hi_y)
+{
+	// the brush and the 4 cells of bilinear interpolation have to stay inside
+	double min_x = lo_x + settings.radius;
+	double max_x = hi_x - settings.radius - 2;
+	double min_y = lo_y + settings.radius;
+	double max_y = hi_y - settings.radius - 2;
+	if (max_x <= min_x || max_y <= min_y) return;
+
+	for (int d = 0; d < count; d++)
+	{
+		double x = x0 + random_double(seed, RANDOM_STREAM_DROPLET_X, key, d) * (x1 - x0);
+		double y = y0 + random_double(seed, RANDOM_STREAM_DROPLET_Y, key, d) * (y1 - y0);
+		x = std::min(std::max(x, min_x), max_x);
+		y = std::min(std::max(y, min_y), max_y);
+
+		double dir_x = 0;
+		double dir_y = 0;
+		double speed = 1;
+		double water = 1;
+		double sediment = 0;
+
+		for (int step = 0; step < settings.lifetime; step++)
+		{
+			int i = (int)x;
+			int j = (int)y;
+			double u = x - i;
+			double v = y - j;
+
+			double gx, gy;
+			double height = height_gradient(map, x, y, gx, gy);
+
+			// follow the slope, keeping some of the old direction
+			dir_x = dir_x * settings.inertia - gx * (1 - settings.inertia);
+			dir_y = dir_y * settings.inertia - gy * (1 - settings.inertia);
+			double length = sqrt(dir_x * dir_x + dir_y * dir_y);
+			if (length == 0)
+				break;
+			dir_x /= length;
+			dir_y /= length;
+
+			x += dir_x;
+			y += dir_y;
+			if (x < min_x || x > max_x || y < min_y || y > max_y)
+				break;
+
+			double new_gx, new_gy;
+			double delta = height_gradient(map, x, y, new_gx, new_gy) - height;
+			double capacity = std::max(-delta * speed * water * settings.capacity, settings.min_capacity);
+
+			if (sediment > capacity || delta > 0)
+			{
+				// drop sediment into the cell the droplet left: enough to fill the pit if it went uphill,
+				// otherwise part of what it can't carry
+				double amount = delta > 0 ? std::min(delta, sediment) : (sediment - capacity) * settings.deposit_speed;
+				sediment -= amount;
+
+				map[i][j] += amount * (1 - u) * (1 - v);
+				map[i + 1][j] += amount * u * (1 - v);
+				map[i][j + 1] += amount * (1 - u) * v;
+				map[i + 1][j + 1] += amount * u * v;
+			}
+			else
+			{
+				// never dig deeper than the drop to the new position
+				double amount = std::min((capacity - sediment) * settings.erode_speed, -delta);
+				for (size_t b = 0; b < brush.weight.size(); b++)
+					map[i + brush.dx[b]][j + brush.dy[b]] -= amount * brush.weight[b];
+				sediment += amount;
+			}
+
+			speed = sqrt(std::max(speed * speed - delta * settings.gravity, 0.0));
+			water *= 1 - settings.evaporate_speed;
+		}
+	}
+}
+
+int hydraulic_erosion(heightfield<double>& map, const erosion_settings& settings, uint64_t seed, const cancel_token& cancel, thread_pool& pool, const std::function<void(int)>& advance)
+{
+	int size_x = map.size_x();
+	int size_y = map.size_y();
+	if (settings.droplets <= 0 || size_x < 2 * settings.radius + 4 || size_y < 2 * settings.radius + 4)
+		return 0;
+
+	erosion_brush brush;
+	build_brush(settings.radius, brush);
+
+	// blocks per side, plus one for the shifted rounds, rounded up to even so the colors tile
+	const int block = EROSION_BLOCK_SIZE;
+	const int reach = block / 2;
+	int blocks_x = (size_x + block - 1) / block + 1;
+	int blocks_y = (size_y + block - 1) / block + 1;
+	blocks_x += blocks_x % 2;
+	blocks_y += blocks_y % 2;
+
+	/*
+		the droplets are spread over the blocks of all rounds by the area of the block that is on the map,
+		so the blocks cut by the edge don't get more than their share. counts are differences of rounded
+		running totals, so they add up to exactly settings.droplets
+	*/
+	int jobs = EROSION_ROUNDS * blocks_x * blocks_y;
+	std::vector<int> counts(jobs);
+	{
+		std::vector<int64_t> area(jobs + 1, 0);
+		for (int key = 0; key < jobs; key++)
+		{
+			int shift = (key / (blocks_x * blocks_y)) * block / EROSION_ROUNDS;
+			int bx = key / blocks_y % blocks_x;
+			int by = key % blocks_y;
+			int64_t w = std::min((bx + 1) * block - shift, size_x - 1) - std::max(bx * block - shift, 0);
+			int64_t h = std::min((by + 1) * block - shift, size_y - 1) - std::max(by * block - shift, 0);
+			area[key + 1] = area[key] + std::max(w, (int64_t)0) * std::max(h, (int64_t)0);
+		}
+		for (int key = 0; key < jobs; key++)
+			counts[key] = (int)(settings.droplets * area[key + 1] / area[jobs] - settings.droplets * area[key] / area[jobs]);
+	}
+
+	std::atomic<int> done(0);
+	for (int round = 0; round < EROSION_ROUNDS && !cancel.cancelled(); round++)
+	{
+		int shift = round * block / EROSION_ROUNDS;
+
+		for (int color = 0; color < 4 && !cancel.cancelled(); color++)
+		{
+			int count_x = blocks_x / 2;
+			int count_y = blocks_y / 2;
+
+			pool.parallel_for(count_x * count_y, [&](int b)
+			{
+				int bx = (b / count_y) * 2 + color / 2;
+				int by = (b % count_y) * 2 + color % 2;
+				int key = (round * blocks_x + bx) * blocks_y + by;
+				if (counts[key] == 0 || cancel.cancelled()) return;
+
+				// the block clipped to the map, and the cells its droplets may touch
+				int x0 = std::max(bx * block - shift, 0);
+				int x1 = std::min((bx + 1) * block - shift, size_x - 1);
+				int y0 = std::max(by * block - shift, 0);
+				int y1 = std::min((by + 1) * block - shift, size_y - 1);
+
+				int lo_x = std::max(bx * block - shift - reach, 0);
+				int hi_x = std::min((bx + 1) * block - shift + reach, size_x);
+				int lo_y = std::max(by * block - shift - reach, 0);
+				int hi_y = std::min((by + 1) * block - shift + reach, size_y);
+
+				run_droplets(map, settings, brush, seed, key, counts[key], x0, x1, y0, y1, lo_x, hi_x, lo_y, hi_y);
+				done += counts[key];
+				advance(counts[key]);
+			});
+		}
+	}
+	return done.load();
+}
+
+/*
+	thermal erosion row kernels. out[j] = row[j] + rate * (((up + down) + left) + right), each term being what
+	flows in from that neighbour (negative if it flows out). a missing neighbour on the edge of the map is the
+	point itself, which exchanges nothing
+*/
+
+struct talus_row
+{
+	const double* row;
+	const double* up;
+	const double* down;
+	double* out;
+	int size;
+	double talus;
+	double rate;
+};
+
+static inline double talus_flux(double neighbour, double point, double talus)
+{
+	double in = (neighbour - point) - talus;
+	double out = (point - neighbour) - talus;
+	return (in > 0 ? in : 0) - (out > 0 ? out : 0);
+}
+
+static inline void talus_scalar(const talus_row& r, int j, int n)
+{
+	for (; j < n; j++)
+	{
+		double c = r.row[j];
+		double left = j > 0 ? r.row[j - 1] : c;
+		double right = j + 1 < r.size ? r.row[j + 1] : c;
+		double flux = ((talus_flux(r.up[j], c, r.talus) + talus_flux(r.down[j], c, r.talus)) + talus_flux(left, c, r.talus)) + talus_flux(right, c, r.talus);
+		r.out[j] = c + r.rate * flux;
+	}
+}
+
+typedef void(*talus_row_func)(const talus_row& r);
+
+static void talus_row_scalar(const talus_row& r)
+{
+	talus_scalar(r, 0, r.size);
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET_SSE2 static inline __m128d talus_flux_sse2(__m128d neighbour, __m128d point, __m128d talus, __m128d zero)
+{
+	__m128d in = _mm_sub_pd(_mm_sub_pd(neighbour, point), talus);
+	__m128d out = _mm_sub_pd(_mm_sub_pd(point, neighbour), talus);
+	return _mm_sub_pd(_mm_max_pd(in, zero), _mm_max_pd(out, zero));
+}
+
+SIMD_TARGET_SSE2 static void talus_row_sse2(const talus_row& r)
+{
+	__m128d talus = _mm_set1_pd(r.talus), rate = _mm_set1_pd(r.rate), zero = _mm_setzero_pd();
+	talus_scalar(r, 0, 1);
+	int j = 1;
+	for (; j + 2 < r.size; j += 2)
+	{
+		__m128d c = _mm_loadu_pd(r.row + j);
+		__m128d flux = _mm_add_pd(talus_flux_sse2(_mm_loadu_pd(r.up + j), c, talus, zero), talus_flux_sse2(_mm_loadu_pd(r.down + j), c, talus, zero));
+		flux = _mm_add_pd(flux, talus_flux_sse2(_mm_loadu_pd(r.row + j - 1), c, talus, zero));
+		flux = _mm_add_pd(flux, talus_flux_sse2(_mm_loadu_pd(r.row + j + 1), c, talus, zero));
+		_mm_storeu_pd(r.out + j, _mm_add_pd(c, _mm_mul_pd(rate, flux)));
+	}
+	talus_scalar(r, j, r.size);
+}
+
+SIMD_TARGET_AVX2 static inline __m256d talus_flux_avx2(__m256d neighbour, __m256d point, __m256d talus, __m256d zero)
+{
+	__m256d in = _mm256_sub_pd(_mm256_sub_pd(neighbour, point), talus);
+	__m256d out = _mm256_sub_pd(_mm256_sub_pd(point, neighbour), talus);
+	return _mm256_sub_pd(_mm256_max_pd(in, zero), _mm256_max_pd(out, zero));
+}
+
+SIMD_TARGET_AVX2 static void talus_row_avx2(const talus_row& r)
+{
+	__m256d talus = _mm256_set1_pd(r.talus), rate = _mm256_set1_pd(r.rate), zero = _mm256_setzero_pd();
+	talus_scalar(r, 0, 1);
+	int j = 1;
+	for (; j + 4 < r.size; j += 4)
+	{
+		__m256d c = _mm256_loadu_pd(r.row + j);
+		__m256d flux = _mm256_add_pd(talus_flux_avx2(_mm256_loadu_pd(r.up + j), c, talus, zero), talus_flux_avx2(_mm256_loadu_pd(r.down + j), c, talus, zero));
+		flux = _mm256_add_pd(flux, talus_flux_avx2(_mm256_loadu_pd(r.row + j - 1), c, talus, zero));
+		flux = _mm256_add_pd(flux, talus_flux_avx2(_mm256_loadu_pd(r.row + j + 1), c, talus, zero));
+		_mm256_storeu_pd(r.out + j, _mm256_add_pd(c, _mm256_mul_pd(rate, flux)));
+	}
+	talus_scalar(r, j, r.size);
+}
+
+#endif
+
+static talus_row_func select_talus_kernel()
+{
+#ifdef SIMD_X86
+	switch (simd_detect())
+	{
+	case SIMD_AVX2:
+		return talus_row_avx2;
+	case SIMD_SSE2:
+		return talus_row_sse2;
+	default:
+		break;
+	}
+#endif
+	return talus_row_scalar;
+}
+
+int thermal_erosion(heightfield<double>& map, const erosion_settings& settings, double spacing, const cancel_token& cancel, thread_pool& pool, const std::function<void(int)>& advance)
+{
+	int size_x = map.size_x();
+	int size_y = map.size_y();
+	if (settings.thermal_iterations <= 0 || size_x < 2 || size_y < 2)
+		return 0;
+
+	talus_row_func kernel = select_talus_kernel();
+	heightfield<double> next(size_x, size_y);
+	int bands = (size_x + HEIGHTFIELD_BLOCK_ROWS - 1) / HEIGHTFIELD_BLOCK_ROWS;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int done = 0;
+	while (done < settings.thermal_iterations && !cancel.cancelled())
+	{
+		if (settings.thermal_budget > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= settings.thermal_budget)
+			break;
+
+		pool.parallel_for(bands, [&](int b)
+		{
+			int x1 = std::min((b + 1) * HEIGHTFIELD_BLOCK_ROWS, size_x);
+			for (int x = b * HEIGHTFIELD_BLOCK_ROWS; x < x1; x++)
+			{
+				talus_row r;
+				r.row = map[x];
+				r.up = x > 0 ? map[x - 1] : map[x];
+				r.down = x + 1 < size_x ? map[x + 1] : map[x];
+				r.out = next[x];
+				r.size = size_y;
+				r.talus = settings.talus * spacing;
+				r.rate = settings.thermal_rate;
+				kernel(r);
+			}
+		});
+
+		std::swap(map, next);
+		done++;
+		advance(1);
+	}
+	return done;
+}
@@ -0,0 +1,82 @@
+#ifndef EROSION_DEF
+#define EROSION_DEF
+
+#include <stdint.h>
+#include <functional>
+#include <internal/heightfield.h>
+#include <internal/thread_pool.h>
+#include <internal/task_graph.h>
+#include <internal/simd.h>
+
+// side length of the square blocks droplets are spawned in. a droplet can wander half a block past its own
+// block, so it has to be well above the distance a droplet travels in its lifetime
+#define EROSION_BLOCK_SIZE 64
+
+// droplets per point of the map the generators run by default
+#define EROSION_DROPLETS_PER_POINT 0.5
+
+// passes over the map, each with the blocks shifted, so the edges of the blocks don't show
+#define EROSION_ROUNDS 4
+
+/*
+	particle based hydraulic erosion (Hans Theobald Beyer's droplet model): droplets of water run downhill,
+	picking up sediment where they speed up and dropping it where they slow down or evaporate.
+*/
+struct erosion_settings
+{
+	// total droplets over the map, 0 turns erosion off
+	int droplets;
+	int lifetime;
+
+	// how much a droplet keeps its direction instead of following the slope, 0 to 1
+	double inertia;
+
+	// sediment a droplet can carry per unit of slope, speed and water, and the least it can carry on flat ground
+	double capacity;
+	double min_capacity;
+
+	// share of the missing or excess sediment that is picked up or dropped every step
+	double erode_speed;
+	double deposit_speed;
+
+	double evaporate_speed;
+	double gravity;
+
+	// cells around a droplet it erodes from, weighed by how close they are
+	int radius;
+
+	// thermal erosion: passes of material sliding down wherever the slope is steeper than talus (height per unit
+	// of distance), moving thermal_rate of the excess height to each lower neighbour per pass. 0 passes turns it off
+	int thermal_iterations;
+	double talus;
+	double thermal_rate;
+
+	// seconds thermal erosion may take before it stops, whatever pass it is at, 0 for no limit.
+	// with a limit the island depends on how fast the machine is
+	double thermal_budget;
+};
+
+// the usual parameters of the models, with the given number of droplets
+erosion_settings default_erosion_settings(int droplets);
+
+/*
+	erode the map with settings.droplets droplets. the map is cut into EROSION_BLOCK_SIZE blocks colored like a
+	2 x 2 checkerboard, and the blocks of one color are run in parallel, one job per block. a droplet stays within
+	half a block of its own block, so blocks of the same color never touch the same cells, and the droplets of a
+	block always run in the same order: the result doesn't depend on the number of threads.
+	advance(n) is called from the jobs every time n more droplets are done. stops early if cancel is set,
+	returns the number of droplets simulated
+*/
+int hydraulic_erosion(heightfield<double>& map, const erosion_settings& settings, uint64_t seed, const cancel_token& cancel, thread_pool& pool, const std::function<void(int)>& advance);
+
+/*
+	thermal erosion (talus relaxation). every pass computes the whole map from the previous one into a second
+	buffer: a point gains rate * (difference - talus distance) from every higher neighbour past the talus angle,
+	and loses as much to every lower one. the exchange between two neighbours is the same number with opposite
+	signs, so material is only moved, never created. rows are vectorized and bands of rows run in parallel;
+	every point is a pure function of the previous pass, so the result doesn't depend on the threads or the CPU.
+	the points of the map are spacing apart. advance(1) is called after every pass, returns the passes done
+*/
+int thermal_erosion(heightfield<double>& map, const erosion_settings& settings, double spacing, const cancel_token& cancel, thread_pool& pool, const std::function<void(int)>& advance);
+
+#endif // !EROSION_DEF
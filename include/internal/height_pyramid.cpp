@@ -0,0 +1,250 @@
+#include <internal/height_pyramid.h>
+#include <algorithm>
+#include <cmath>
+
+void height_pyramid::build(const heightfield<float>& heights, float map_step, glm::vec2 map_origin, thread_pool& pool)
+{
+	map = &heights;
+	step = map_step;
+	origin = map_origin;
+	mips.clear();
+
+	// level 0, the corners of every cell
+	heightfield<height_range> base(heights.size_x() - 1, heights.size_y() - 1);
+	pool.parallel_for(base.size_x(), [&](int i)
+	{
+		const float* row = heights[i];
+		const float* next = heights[i + 1];
+		height_range* out = base[i];
+		for (int j = 0; j < base.size_y(); j++)
+		{
+			out[j].min = std::min(std::min(row[j], row[j + 1]), std::min(next[j], next[j + 1]));
+			out[j].max = std::max(std::max(row[j], row[j + 1]), std::max(next[j], next[j + 1]));
+		}
+	});
+	mips.push_back(std::move(base));
+
+	// halve until one node is left, nodes on odd edges only have the children that are there
+	while (mips.back().size_x() > 1 || mips.back().size_y() > 1)
+	{
+		const heightfield<height_range>& below = mips.back();
+		heightfield<height_range> level((below.size_x() + 1) / 2, (below.size_y() + 1) / 2);
+		pool.parallel_for(level.size_x(), [&](int i)
+		{
+			int i1 = std::min(i * 2 + 1, below.size_x() - 1);
+			for (int j = 0; j < level.size_y(); j++)
+			{
+				int j1 = std::min(j * 2 + 1, below.size_y() - 1);
+				height_range r = below[i * 2][j * 2];
+				height_range c[3] = { below[i * 2][j1], below[i1][j * 2], below[i1][j1] };
+				for (int k = 0; k < 3; k++)
+				{
+					r.min = std::min(r.min, c[k].min);
+					r.max = std::max(r.max, c[k].max);
+				}
+				level[i][j] = r;
+			}
+		});
+		mips.push_back(std::move(level));
+	}
+}
+
+// narrow t0, t1 to where o + d * t is between lo and hi on one axis
+static inline bool clip_slab(double o, double d, double lo, double hi, double& t0, double& t1)
+{
+	if (d == 0)
+		return o >= lo && o <= hi;
+	double a = (lo - o) / d;
+	double b = (hi - o) / d;
+	if (a > b)
+		std::swap(a, b);
+	t0 = std::max(t0, a);
+	t1 = std::min(t1, b);
+	return t0 <= t1;
+}
+
+// where o + d * t leaves [lo, hi] on one axis, with inverse = 1 / d
+static inline double slab_exit(double o, double d, double inverse, double lo, double hi)
+{
+	if (d > 0) return (hi - o) * inverse;
+	if (d < 0) return (lo - o) * inverse;
+	return INFINITY;
+}
+
+bool height_pyramid::intersect_cell(int i, int j, glm::dvec3 o, glm::dvec3 d, double t0, double t1, double& t) const
+{
+	/*
+		the bilinear surface is h00 + ex * u + ez * v + exz * u * v in the cell, and u, v are linear along the ray,
+		so the height of the ray over the ground is a quadratic in s = t - t0: f0 + c1 * s + c2 * s^2
+	*/
+	const heightfield<float>& m = *map;
+	double h00 = m[i][j], h10 = m[i + 1][j], h01 = m[i][j + 1], h11 = m[i + 1][j + 1];
+	double ex = h10 - h00;
+	double ez = h01 - h00;
+	double exz = h00 - h10 - h01 + h11;
+
+	double u = o.x + d.x * t0 - i;
+	double v = o.z + d.z * t0 - j;
+	double f0 = o.y + d.y * t0 - (h00 + ex * u + ez * v + exz * u * v);
+	if (f0 <= 0)
+	{
+		t = t0;
+		return true;
+	}
+
+	double c1 = d.y - ex * d.x - ez * d.z - exz * (u * d.z + v * d.x);
+	double c2 = -exz * d.x * d.z;
+	double s;
+	if (c2 == 0)
+	{
+		if (c1 >= 0)
+			return false;
+		s = -f0 / c1;
+	}
+	else
+	{
+		double discriminant = c1 * c1 - 4 * c2 * f0;
+		if (discriminant < 0)
+			return false;
+
+		// both roots without cancellation, the ray comes down from above so the first positive one is the hit
+		double q = -0.5 * (c1 + (c1 < 0 ? -1 : 1) * sqrt(discriminant));
+		double r0 = q / c2;
+		double r1 = f0 / q;
+		if (r0 > r1)
+			std::swap(r0, r1);
+		s = r0 >= 0 ? r0 : r1;
+		if (s < 0)
+			return false;
+	}
+	if (s > t1 - t0)
+		return false;
+	t = t0 + s;
+	return true;
+}
+
+bool height_pyramid::intersect(glm::vec3 ray_origin, glm::vec3 direction, float max_t, ray_hit& hit) const
+{
+	hit.t = INFINITY;
+	hit.position = glm::vec3(0);
+	if (mips.empty() || !(max_t >= 0))
+		return false;
+	for (int a = 0; a < 3; a++)
+	{
+		if (!std::isfinite(ray_origin[a]) || !std::isfinite(direction[a]))
+			return false;
+	}
+
+	// the ray on the grid, in cells across and world units up, t stays the same
+	glm::dvec3 o((ray_origin.x - origin.x) / (double)step, ray_origin.y, (ray_origin.z - origin.y) / (double)step);
+	glm::dvec3 d(direction.x / (double)step, direction.y, direction.z / (double)step);
+	int cells_x = map->size_x() - 1;
+	int cells_z = map->size_y() - 1;
+	int top = levels() - 1;
+
+	// only the part over the map and under its highest point can hit
+	double t0 = 0, t1 = max_t;
+	if (!clip_slab(o.x, d.x, 0, cells_x, t0, t1) || !clip_slab(o.z, d.z, 0, cells_z, t0, t1) ||
+		!clip_slab(o.y, d.y, -INFINITY, mips[top][0][0].max, t0, t1))
+		return false;
+
+	double inverse_x = 1 / d.x;
+	double inverse_z = 1 / d.z;
+	int level = top;
+	double t = t0;
+	for (;;)
+	{
+		const heightfield<height_range>& mip = mips[level];
+		int size = 1 << level;
+		double to_node = 1.0 / size;
+		glm::dvec3 p = o + d * t;
+
+		/*
+			the node the ray is in at t. right on the far side of a node, rounding can leave it in the node it is
+			leaving, so that one is passed to the next along the ray. p is clipped to the map, so truncating it is
+			rounding down once it is clamped
+		*/
+		int ni = std::min(std::max((int)(p.x * to_node), 0), mip.size_x() - 1);
+		int nj = std::min(std::max((int)(p.z * to_node), 0), mip.size_y() - 1);
+		double exit_x = slab_exit(o.x, d.x, inverse_x, ni * size, std::min((ni + 1) * size, cells_x));
+		double exit_z = slab_exit(o.z, d.z, inverse_z, nj * size, std::min((nj + 1) * size, cells_z));
+		if (exit_x <= t)
+		{
+			ni += d.x > 0 ? 1 : -1;
+			if (ni < 0 || ni >= mip.size_x())
+				return false;
+			exit_x = slab_exit(o.x, d.x, inverse_x, ni * size, std::min((ni + 1) * size, cells_x));
+		}
+		if (exit_z <= t)
+		{
+			nj += d.z > 0 ? 1 : -1;
+			if (nj < 0 || nj >= mip.size_y())
+				return false;
+			exit_z = slab_exit(o.z, d.z, inverse_z, nj * size, std::min((nj + 1) * size, cells_z));
+		}
+		double exit = std::min(std::min(exit_x, exit_z), t1);
+
+		// the ray is lowest at one end of the node
+		double low = std::min(o.y + d.y * t, o.y + d.y * exit);
+		if (low <= mip[ni][nj].max)
+		{
+			if (level > 0)
+			{
+				level--;
+				continue;
+			}
+
+			double found;
+			if (intersect_cell(ni, nj, o, d, t, exit, found))
+			{
+				hit.t = (float)found;
+				hit.position = ray_origin + direction * hit.t;
+				return true;
+			}
+		}
+
+		if (exit >= t1)
+			return false;
+		t = exit;
+
+		/*
+			on to the next node, as high up as the ray goes into a node it hasn't been in yet. nodes it has been
+			in were only gone down into, the next one in them is tested where it is
+		*/
+		int next_i = exit == exit_x ? ni + (d.x > 0 ? 1 : -1) : ni;
+		int next_j = exit == exit_z ? nj + (d.z > 0 ? 1 : -1) : nj;
+		while (level < top && (next_i >> 1 != ni >> 1 || next_j >> 1 != nj >> 1))
+		{
+			level++;
+			ni >>= 1;
+			nj >>= 1;
+			next_i >>= 1;
+			next_j >>= 1;
+		}
+	}
+}
+
+void height_pyramid::intersect_rays(const glm::vec3* origins, const glm::vec3* directions, int count, float max_t, ray_hit* hits, thread_pool& pool) const
+{
+	int batches = (count + PYRAMID_RAY_BATCH - 1) / PYRAMID_RAY_BATCH;
+	pool.parallel_for(batches, [&](int b)
+	{
+		int end = std::min((b + 1) * PYRAMID_RAY_BATCH, count);
+		for (int i = b * PYRAMID_RAY_BATCH; i < end; i++)
+			intersect(origins[i], directions[i], max_t, hits[i]);
+	});
+}
+
+bool height_pyramid::line_of_sight(glm::vec3 a, glm::vec3 b) const
+{
+	ray_hit hit;
+	return !intersect(a, b - a, 1, hit);
+}
+
+size_t height_pyramid::memory() const
+{
+	size_t bytes = sizeof(height_pyramid) + mips.capacity() * sizeof(heightfield<height_range>);
+	for (size_t l = 0; l < mips.size(); l++)
+		bytes += mips[l].size() * sizeof(height_range);
+	return bytes;
+}
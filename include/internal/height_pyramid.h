@@ -0,0 +1,68 @@
+#ifndef HEIGHT_PYRAMID_DEF
+#define HEIGHT_PYRAMID_DEF
+
+#include <vector>
+#include <internal/heightfield.h>
+#include <internal/thread_pool.h>
+#include <glm/glm.hpp>
+
+/*
+	min/max mip pyramid over a heightmap, for casting rays at the ground: picking, line of sight, shadows.
+	level 0 has the lowest and highest point of every cell of the map, every level above covers 2 x 2 of
+	the nodes below it, up to one node for the whole map. a ray walks the nodes from the top, skipping every
+	node it passes over without going below its highest point and only going down where it could hit, so
+	open sky and flat ground cost a few steps however large the map is (maximum mipmap traversal).
+	in the cells it reaches, rays hit the same bilinear surface heightfield_query reads.
+*/
+
+// lowest and highest point under a node
+struct height_range
+{
+	float min;
+	float max;
+};
+
+struct ray_hit
+{
+	// the ray is origin + direction * t, t is INFINITY for rays that don't hit
+	float t;
+	glm::vec3 position;
+};
+
+// rays of a batch per job of intersect_rays
+#define PYRAMID_RAY_BATCH 1024
+
+class height_pyramid
+{
+public:
+	height_pyramid() : map(nullptr), step(1), origin(0) {}
+
+	// build over a heightmap of at least 2 x 2 points step world units apart, the first one at origin, a row
+	// of nodes per job of the pool. the heightmap has to outlive the pyramid and not change under it
+	void build(const heightfield<float>& heights, float step, glm::vec2 origin, thread_pool& pool);
+
+	int levels() const { return (int)mips.size(); }
+	const heightfield<height_range>& level(int l) const { return mips[l]; }
+
+	// first point of origin + direction * t, 0 <= t <= max_t, on or under the ground. rays starting under it hit at 0
+	bool intersect(glm::vec3 origin, glm::vec3 direction, float max_t, ray_hit& hit) const;
+
+	// count rays at once, a batch of PYRAMID_RAY_BATCH per job of the pool
+	void intersect_rays(const glm::vec3* origins, const glm::vec3* directions, int count, float max_t, ray_hit* hits, thread_pool& pool) const;
+
+	// whether nothing of the ground is between a and b
+	bool line_of_sight(glm::vec3 a, glm::vec3 b) const;
+
+	size_t memory() const;
+
+private:
+	// ray hit in cell i, j of the map between ray parameters t0 and t1, in grid units
+	bool intersect_cell(int i, int j, glm::dvec3 o, glm::dvec3 d, double t0, double t1, double& t) const;
+
+	const heightfield<float>* map;
+	float step;
+	glm::vec2 origin;
+	std::vector<heightfield<height_range>> mips;
+};
+
+#endif // !HEIGHT_PYRAMID_DEF
@@ -0,0 +1,181 @@
+#ifndef HEIGHTFIELD_DEF
+#define HEIGHTFIELD_DEF
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// allocate and free memory aligned to a cache line, so rows can be loaded with SIMD instructions
+inline void* heightfield_alloc(size_t bytes, size_t alignment)
+{
+	if (bytes == 0) return nullptr;
+#ifdef _MSC_VER
+	void* ptr = _aligned_malloc(bytes, alignment);
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, alignment, bytes) != 0) ptr = nullptr;
+#endif
+	if (ptr == nullptr) throw std::bad_alloc();
+	return ptr;
+}
+
+inline void heightfield_free(void* ptr)
+{
+#ifdef _MSC_VER
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+/*
+	2D grid of values stored in one contiguous, aligned block of memory.
+	indexed the same way as the old std::vector<std::vector<T>> maps: field[x][y] or field(x, y),
+	with y being the contiguous direction. copying is expensive, so it is move only; use clone() if
+	a real copy is needed.
+*/
+template <typename T>
+class heightfield
+{
+	static_assert(std::is_trivially_copyable<T>::value, "heightfield only stores plain values");
+
+public:
+	static const size_t alignment = 64;
+
+	// view over a single column (one y, every x), which is strided in memory
+	template <typename U>
+	class strided_view
+	{
+	public:
+		strided_view(U* data, size_t stride, int count) : data(data), stride(stride), count(count) {}
+
+		U& operator[](int x) const { return data[x * stride]; }
+		int size() const { return count; }
+
+	private:
+		U* data;
+		size_t stride;
+		int count;
+	};
+	typedef strided_view<T> column_view;
+	typedef strided_view<const T> const_column_view;
+
+	heightfield() : values(nullptr), width(0), height(0) {}
+
+	heightfield(int size_x, int size_y, T value = T()) : values(nullptr), width(0), height(0)
+	{
+		resize(size_x, size_y, value);
+	}
+
+	heightfield(heightfield&& h) noexcept : values(h.values), width(h.width), height(h.height)
+	{
+		h.values = nullptr;
+		h.width = 0;
+		h.height = 0;
+	}
+
+	heightfield& operator=(heightfield&& h) noexcept
+	{
+		if (this != &h)
+		{
+			heightfield_free(values);
+			values = h.values;
+			width = h.width;
+			height = h.height;
+			h.values = nullptr;
+			h.width = 0;
+			h.height = 0;
+		}
+		return *this;
+	}
+
+	heightfield(const heightfield&) = delete;
+	heightfield& operator=(const heightfield&) = delete;
+
+	~heightfield()
+	{
+		heightfield_free(values);
+	}
+
+	// explicit deep copy
+	heightfield clone() const
+	{
+		heightfield h;
+		h.values = static_cast<T*>(heightfield_alloc(size() * sizeof(T), alignment));
+		h.width = width;
+		h.height = height;
+		if (size() != 0) memcpy(h.values, values, size() * sizeof(T));
+		return h;
+	}
+
+	// reallocate the grid, old contents are lost
+	void resize(int size_x, int size_y, T value = T())
+	{
+		heightfield_free(values);
+		values = nullptr;
+		width = size_x;
+		height = size_y;
+		values = static_cast<T*>(heightfield_alloc(size() * sizeof(T), alignment));
+		fill(value);
+	}
+
+	void fill(T value)
+	{
+		for (size_t i = 0; i < size(); i++)
+			values[i] = value;
+	}
+
+	int size_x() const { return width; }
+	int size_y() const { return height; }
+	size_t size() const { return (size_t)width * height; }
+	bool empty() const { return size() == 0; }
+
+	T* data() { return values; }
+	const T* data() const { return values; }
+	T* begin() { return values; }
+	T* end() { return values + size(); }
+	const T* begin() const { return values; }
+	const T* end() const { return values + size(); }
+
+	// row views (one x, every y), contiguous in memory
+	T* operator[](int x) { return values + (size_t)x * height; }
+	const T* operator[](int x) const { return values + (size_t)x * height; }
+	T* row(int x) { return values + (size_t)x * height; }
+	const T* row(int x) const { return values + (size_t)x * height; }
+
+	column_view column(int y) { return column_view(values + y, height, width); }
+	const_column_view column(int y) const { return const_column_view(values + y, height, width); }
+
+	T& operator()(int x, int y) { return values[(size_t)x * height + y]; }
+	const T& operator()(int x, int y) const { return values[(size_t)x * height + y]; }
+
+private:
+	T* values;
+	int width;
+	int height;
+};
+
+#define HEIGHTFIELD_HASH_START 14695981039346656037ull
+
+// continue an FNV-1a hash over more bytes, starting from HEIGHTFIELD_HASH_START
+inline uint64_t heightfield_hash_bytes(uint64_t hash, const void* data, size_t count)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < count; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+// FNV-1a hash of the contents, to check that two runs produced exactly the same map. hashing the rows
+// one after the other with heightfield_hash_bytes gives the same hash
+template <typename T>
+uint64_t heightfield_hash(const heightfield<T>& h)
+{
+	return heightfield_hash_bytes(HEIGHTFIELD_HASH_START, h.data(), h.size() * sizeof(T));
+}
+
+#endif // !HEIGHTFIELD_DEF
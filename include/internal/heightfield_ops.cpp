@@ -0,0 +1,365 @@
+#include <internal/heightfield_ops.h>
+#include <cmath>
+
+heightfield_stats::heightfield_stats() : min(INFINITY), max(-INFINITY), count(0)
+{
+	sum[0] = sum[1] = sum[2] = sum[3] = 0;
+}
+
+void heightfield_stats::merge(const heightfield_stats& s)
+{
+	min = s.min < min ? s.min : min;
+	max = s.max > max ? s.max : max;
+	for (int i = 0; i < 4; i++)
+		sum[i] += s.sum[i];
+	count += s.count;
+}
+
+double heightfield_stats::total() const
+{
+	return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+double heightfield_stats::average() const
+{
+	return count == 0 ? 0 : total() / count;
+}
+
+/*
+	row kernels. element j of a row is always added to sum lane j % 4
+*/
+
+// the parameters of the island mask that stay the same for a whole row
+struct mask_row
+{
+	double offset;
+	double x_dist_squared;
+	double center;
+	double spacing;
+	double min_width;
+	double width_range;
+	double mask_height;
+};
+
+static inline void stats_scalar(const double* row, int j, int n, heightfield_stats& s)
+{
+	for (; j < n; j++)
+	{
+		double v = row[j];
+		s.min = v < s.min ? v : s.min;
+		s.max = v > s.max ? v : s.max;
+		s.sum[j & 3] += v;
+	}
+}
+
+static inline void mask_scalar(double* row, float* out, const mask_row& m, int j, int n)
+{
+	for (; j < n; j++)
+	{
+		double y_dist = (m.center - j) * m.spacing;
+		double dist = sqrt(m.x_dist_squared + y_dist * y_dist) - m.min_width;
+		dist = dist > 0.0 ? dist : 0.0;
+		double factor = dist * m.mask_height / m.width_range;
+
+		double v = (row[j] + m.offset) - factor / 2;
+		row[j] = v;
+		out[j] = (float)v;
+	}
+}
+
+// the rows before, at and after the row of a Sobel pass, and 1 / (8 * spacing)
+struct sobel_row
+{
+	const float* prev;
+	const float* row;
+	const float* next;
+	float scale;
+};
+
+static inline void sobel_scalar(const sobel_row& r, int j, int end, int n, glm::vec3* out)
+{
+	for (; j < end; j++)
+	{
+		int j0 = j > 0 ? j - 1 : 0;
+		int j1 = j + 1 < n ? j + 1 : n - 1;
+		float after = (r.next[j0] + r.next[j] * 2.0f) + r.next[j1];
+		float before = (r.prev[j0] + r.prev[j] * 2.0f) + r.prev[j1];
+		float right = (r.prev[j1] + r.row[j1] * 2.0f) + r.next[j1];
+		float left = (r.prev[j0] + r.row[j0] * 2.0f) + r.next[j0];
+		float dx = (after - before) * r.scale;
+		float dz = (right - left) * r.scale;
+		float inverse = 1.0f / sqrtf((dx * dx + dz * dz) + 1.0f);
+		out[j] = glm::vec3(-dx * inverse, inverse, -dz * inverse);
+	}
+}
+
+typedef void(*stats_row_func)(const double* row, int n, heightfield_stats& s);
+typedef void(*mask_row_func)(double* row, float* out, const mask_row& m, int n, heightfield_stats& s);
+
+static void stats_row_scalar(const double* row, int n, heightfield_stats& s)
+{
+	stats_scalar(row, 0, n, s);
+}
+
+static void mask_row_scalar(double* row, float* out, const mask_row& m, int n, heightfield_stats& s)
+{
+	mask_scalar(row, out, m, 0, n);
+	stats_scalar(row, 0, n, s);
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET_SSE2 static void stats_row_sse2(const double* row, int n, heightfield_stats& s)
+{
+	__m128d mn = _mm_set1_pd(s.min), mx = _mm_set1_pd(s.max);
+	__m128d sum_lo = _mm_loadu_pd(s.sum), sum_hi = _mm_loadu_pd(s.sum + 2);
+	int j = 0;
+	for (; j + 4 <= n; j += 4)
+	{
+		__m128d a = _mm_loadu_pd(row + j), b = _mm_loadu_pd(row + j + 2);
+		mn = _mm_min_pd(mn, _mm_min_pd(a, b));
+		mx = _mm_max_pd(mx, _mm_max_pd(a, b));
+		sum_lo = _mm_add_pd(sum_lo, a);
+		sum_hi = _mm_add_pd(sum_hi, b);
+	}
+	_mm_storeu_pd(s.sum, sum_lo);
+	_mm_storeu_pd(s.sum + 2, sum_hi);
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, mn);
+	s.min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+	_mm_storeu_pd(lanes, mx);
+	s.max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+
+	stats_scalar(row, j, n, s);
+}
+
+SIMD_TARGET_SSE2 static void mask_row_sse2(double* row, float* out, const mask_row& m, int n, heightfield_stats& s)
+{
+	__m128d offset = _mm_set1_pd(m.offset), xd2 = _mm_set1_pd(m.x_dist_squared), center = _mm_set1_pd(m.center), spacing = _mm_set1_pd(m.spacing);
+	__m128d min_width = _mm_set1_pd(m.min_width), range = _mm_set1_pd(m.width_range), height = _mm_set1_pd(m.mask_height);
+	__m128d two = _mm_set1_pd(2.0), zero = _mm_setzero_pd();
+	int j = 0;
+	for (; j + 2 <= n; j += 2)
+	{
+		__m128d y_dist = _mm_mul_pd(_mm_sub_pd(center, _mm_setr_pd(j, j + 1)), spacing);
+		__m128d dist = _mm_sub_pd(_mm_sqrt_pd(_mm_add_pd(xd2, _mm_mul_pd(y_dist, y_dist))), min_width);
+		dist = _mm_max_pd(dist, zero);
+		__m128d factor = _mm_div_pd(_mm_mul_pd(dist, height), range);
+
+		__m128d v = _mm_sub_pd(_mm_add_pd(_mm_loadu_pd(row + j), offset), _mm_div_pd(factor, two));
+		_mm_storeu_pd(row + j, v);
+		_mm_storel_pi((__m64*)(out + j), _mm_cvtpd_ps(v));
+	}
+	mask_scalar(row, out, m, j, n);
+	stats_row_sse2(row, n, s);
+}
+
+SIMD_TARGET_AVX2 static void stats_row_avx2(const double* row, int n, heightfield_stats& s)
+{
+	__m256d mn = _mm256_set1_pd(s.min), mx = _mm256_set1_pd(s.max);
+	__m256d sum = _mm256_loadu_pd(s.sum);
+	int j = 0;
+	for (; j + 4 <= n; j += 4)
+	{
+		__m256d v = _mm256_loadu_pd(row + j);
+		mn = _mm256_min_pd(mn, v);
+		mx = _mm256_max_pd(mx, v);
+		sum = _mm256_add_pd(sum, v);
+	}
+	_mm256_storeu_pd(s.sum, sum);
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, mn);
+	for (int i = 0; i < 4; i++)
+		s.min = lanes[i] < s.min ? lanes[i] : s.min;
+	_mm256_storeu_pd(lanes, mx);
+	for (int i = 0; i < 4; i++)
+		s.max = lanes[i] > s.max ? lanes[i] : s.max;
+
+	stats_scalar(row, j, n, s);
+}
+
+SIMD_TARGET_AVX2 static void mask_row_avx2(double* row, float* out, const mask_row& m, int n, heightfield_stats& s)
+{
+	__m256d offset = _mm256_set1_pd(m.offset), xd2 = _mm256_set1_pd(m.x_dist_squared), center = _mm256_set1_pd(m.center), spacing = _mm256_set1_pd(m.spacing);
+	__m256d min_width = _mm256_set1_pd(m.min_width), range = _mm256_set1_pd(m.width_range), height = _mm256_set1_pd(m.mask_height);
+	__m256d two = _mm256_set1_pd(2.0), zero = _mm256_setzero_pd();
+	int j = 0;
+	for (; j + 4 <= n; j += 4)
+	{
+		__m256d y_dist = _mm256_mul_pd(_mm256_sub_pd(center, _mm256_setr_pd(j, j + 1, j + 2, j + 3)), spacing);
+		__m256d dist = _mm256_sub_pd(_mm256_sqrt_pd(_mm256_add_pd(xd2, _mm256_mul_pd(y_dist, y_dist))), min_width);
+		dist = _mm256_max_pd(dist, zero);
+		__m256d factor = _mm256_div_pd(_mm256_mul_pd(dist, height), range);
+
+		__m256d v = _mm256_sub_pd(_mm256_add_pd(_mm256_loadu_pd(row + j), offset), _mm256_div_pd(factor, two));
+		_mm256_storeu_pd(row + j, v);
+		_mm_storeu_ps(out + j, _mm256_cvtpd_ps(v));
+	}
+	mask_scalar(row, out, m, j, n);
+	stats_row_avx2(row, n, s);
+}
+
+/*
+	Sobel rows, the points with both neighbours in the row a batch at a time and the two ends as scalars.
+	the normals are put together in lanes and written out one point at a time
+*/
+
+SIMD_TARGET_SSE2 static void sobel_row_sse2(const sobel_row& r, int n, glm::vec3* out)
+{
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 scale = _mm_set1_ps(r.scale);
+
+	sobel_scalar(r, 0, n < 1 ? n : 1, n, out);
+	int j = 1;
+	for (; j + 4 < n; j += 4)
+	{
+		__m128 after = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(r.next + j - 1), _mm_mul_ps(_mm_loadu_ps(r.next + j), two)), _mm_loadu_ps(r.next + j + 1));
+		__m128 before = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(r.prev + j - 1), _mm_mul_ps(_mm_loadu_ps(r.prev + j), two)), _mm_loadu_ps(r.prev + j + 1));
+		__m128 right = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(r.prev + j + 1), _mm_mul_ps(_mm_loadu_ps(r.row + j + 1), two)), _mm_loadu_ps(r.next + j + 1));
+		__m128 left = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(r.prev + j - 1), _mm_mul_ps(_mm_loadu_ps(r.row + j - 1), two)), _mm_loadu_ps(r.next + j - 1));
+		__m128 dx = _mm_mul_ps(_mm_sub_ps(after, before), scale);
+		__m128 dz = _mm_mul_ps(_mm_sub_ps(right, left), scale);
+		__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), one)));
+
+		alignas(16) float nx[4], ny[4], nz[4];
+		_mm_store_ps(nx, _mm_mul_ps(_mm_xor_ps(dx, sign), inverse));
+		_mm_store_ps(ny, inverse);
+		_mm_store_ps(nz, _mm_mul_ps(_mm_xor_ps(dz, sign), inverse));
+		for (int l = 0; l < 4; l++)
+			out[j + l] = glm::vec3(nx[l], ny[l], nz[l]);
+	}
+	sobel_scalar(r, j, n, n, out);
+}
+
+SIMD_TARGET_AVX2 static void sobel_row_avx2(const sobel_row& r, int n, glm::vec3* out)
+{
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 scale = _mm256_set1_ps(r.scale);
+
+	sobel_scalar(r, 0, n < 1 ? n : 1, n, out);
+	int j = 1;
+	for (; j + 8 < n; j += 8)
+	{
+		__m256 after = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r.next + j - 1), _mm256_mul_ps(_mm256_loadu_ps(r.next + j), two)), _mm256_loadu_ps(r.next + j + 1));
+		__m256 before = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r.prev + j - 1), _mm256_mul_ps(_mm256_loadu_ps(r.prev + j), two)), _mm256_loadu_ps(r.prev + j + 1));
+		__m256 right = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r.prev + j + 1), _mm256_mul_ps(_mm256_loadu_ps(r.row + j + 1), two)), _mm256_loadu_ps(r.next + j + 1));
+		__m256 left = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r.prev + j - 1), _mm256_mul_ps(_mm256_loadu_ps(r.row + j - 1), two)), _mm256_loadu_ps(r.next + j - 1));
+		__m256 dx = _mm256_mul_ps(_mm256_sub_ps(after, before), scale);
+		__m256 dz = _mm256_mul_ps(_mm256_sub_ps(right, left), scale);
+		__m256 inverse = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dz, dz)), one)));
+
+		alignas(32) float nx[8], ny[8], nz[8];
+		_mm256_store_ps(nx, _mm256_mul_ps(_mm256_xor_ps(dx, sign), inverse));
+		_mm256_store_ps(ny, inverse);
+		_mm256_store_ps(nz, _mm256_mul_ps(_mm256_xor_ps(dz, sign), inverse));
+		for (int l = 0; l < 8; l++)
+			out[j + l] = glm::vec3(nx[l], ny[l], nz[l]);
+	}
+	sobel_scalar(r, j, n, n, out);
+}
+
+#endif
+
+static void select_row_kernels(stats_row_func& stats, mask_row_func& mask)
+{
+	stats = stats_row_scalar;
+	mask = mask_row_scalar;
+#ifdef SIMD_X86
+	switch (simd_detect())
+	{
+	case SIMD_AVX2:
+		stats = stats_row_avx2;
+		mask = mask_row_avx2;
+		break;
+	case SIMD_SSE2:
+		stats = stats_row_sse2;
+		mask = mask_row_sse2;
+		break;
+	default:
+		break;
+	}
+#endif
+}
+
+static heightfield_stats merge_stats(heightfield_stats a, const heightfield_stats& b)
+{
+	a.merge(b);
+	return a;
+}
+
+heightfield_stats heightfield_statistics(const heightfield<double>& map, thread_pool& pool)
+{
+	stats_row_func stats;
+	mask_row_func mask;
+	select_row_kernels(stats, mask);
+
+	return pool.parallel_reduce(map.size_x(), HEIGHTFIELD_BLOCK_ROWS, heightfield_stats(), [&](int x0, int x1)
+	{
+		heightfield_stats s;
+		for (int x = x0; x < x1; x++)
+			stats(map[x], map.size_y(), s);
+		s.count = (size_t)(x1 - x0) * map.size_y();
+		return s;
+	}, merge_stats);
+}
+
+heightfield_stats island_mask(heightfield<double>& map, double spacing, double offset, double min_width, double max_width, double mask_height, heightfield<float>& heights, thread_pool& pool)
+{
+	stats_row_func stats;
+	mask_row_func mask;
+	select_row_kernels(stats, mask);
+
+	heights.resize(map.size_x(), map.size_y());
+
+	return pool.parallel_reduce(map.size_x(), HEIGHTFIELD_BLOCK_ROWS, heightfield_stats(), [&](int x0, int x1)
+	{
+		heightfield_stats s;
+		for (int x = x0; x < x1; x++)
+		{
+			mask_row m;
+			double x_dist = (map.size_x() / 2 - x) * spacing;
+			m.offset = offset;
+			m.x_dist_squared = x_dist * x_dist;
+			m.center = map.size_y() / 2;
+			m.spacing = spacing;
+			m.min_width = min_width;
+			m.width_range = max_width - min_width;
+			m.mask_height = mask_height;
+
+			mask(map[x], heights[x], m, map.size_y(), s);
+		}
+		s.count = (size_t)(x1 - x0) * map.size_y();
+		return s;
+	}, merge_stats);
+}
+
+void sobel_normal_row(const heightfield<float>& heights, float spacing, int x, glm::vec3* out)
+{
+	sobel_row r;
+	r.prev = heights[x > 0 ? x - 1 : 0];
+	r.row = heights[x];
+	r.next = heights[x + 1 < heights.size_x() ? x + 1 : heights.size_x() - 1];
+	r.scale = 1.0f / (8.0f * spacing);
+	int n = heights.size_y();
+
+#ifdef SIMD_X86
+	switch (simd_detect())
+	{
+	case SIMD_AVX2:
+		sobel_row_avx2(r, n, out);
+		return;
+	case SIMD_SSE2:
+		sobel_row_sse2(r, n, out);
+		return;
+	default:
+		break;
+	}
+#endif
+	sobel_scalar(r, 0, n, n, out);
+}
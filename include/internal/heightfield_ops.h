@@ -0,0 +1,52 @@
+#ifndef HEIGHTFIELD_OPS_DEF
+#define HEIGHTFIELD_OPS_DEF
+
+#include <internal/heightfield.h>
+#include <internal/thread_pool.h>
+#include <internal/simd.h>
+#include <glm/glm.hpp>
+
+// rows of the map handled by one job of the parallel passes
+#define HEIGHTFIELD_BLOCK_ROWS 16
+
+/*
+	min / max / sum of a part of a map. partial statistics are computed per block of rows in parallel and
+	merged in block order. the sum is kept in 4 lanes the way the AVX2 path adds it, and every path fills
+	the lanes the same way, so the total doesn't depend on the thread count or the CPU.
+*/
+struct heightfield_stats
+{
+	double min;
+	double max;
+	double sum[4];
+	size_t count;
+
+	heightfield_stats();
+
+	void merge(const heightfield_stats& s);
+	double total() const;
+	double average() const;
+};
+
+// statistics of the whole map
+heightfield_stats heightfield_statistics(const heightfield<double>& map, thread_pool& pool);
+
+/*
+	single fused pass of terrain post processing: raise every point by offset, then push it down the further
+	it is from the center of the map (the island mask),
+
+	map = (map + offset) - max(0, distance to center - min_width) * mask_height / (max_width - min_width) / 2
+
+	the points of the map are spacing apart, distances and widths are in the same units as spacing.
+	write the result to map and heights, and return the statistics of the result
+*/
+heightfield_stats island_mask(heightfield<double>& map, double spacing, double offset, double min_width, double max_width, double mask_height, heightfield<float>& heights, thread_pool& pool);
+
+/*
+	smooth normals of the points of row x of heights, with the points spacing apart: the slope from the Sobel
+	filter over the 3 x 3 points around every point (repeating the edges), as a unit normal pointing up.
+	out gets one normal per point of the row. every path gives the same normals
+*/
+void sobel_normal_row(const heightfield<float>& heights, float spacing, int x, glm::vec3* out);
+
+#endif // !HEIGHTFIELD_OPS_DEF
@@ -0,0 +1,332 @@
+#include <internal/heightfield_query.h>
+#include <cmath>
+
+// points are taken this many at a time through the gradients, then turned into what was asked for
+#define QUERY_BATCH 64
+
+heightfield_query::heightfield_query(const heightfield<float>& map, float step, glm::vec2 origin, query_bounds bounds, float outside)
+	: map(&map), step(step), origin(origin), bounds(bounds), outside(outside)
+{
+}
+
+bool heightfield_query::contains(float x, float z) const
+{
+	glm::vec2 g = to_grid(glm::vec2(x, z));
+	return g.x >= 0 && g.x <= (float)(map->size_x() - 1) && g.y >= 0 && g.y <= (float)(map->size_y() - 1);
+}
+
+/*
+	the heightmap and the query settings as the kernels use them. positions are clamped onto the map, then
+	the cell is the one they are in, or the last one on the far edges. every path does exactly these steps
+*/
+struct query_kernel
+{
+	const float* data;
+	int pitch;
+	float last_x;
+	float last_z;
+	float step;
+	float origin_x;
+	float origin_z;
+	bool clamp;
+	float outside;
+};
+
+static void gradients_scalar(const query_kernel& k, const float* x, const float* z, int start, int count, float* height, float* dx, float* dz)
+{
+	for (int i = start; i < count; i++)
+	{
+		float gx = (x[i] - k.origin_x) / k.step;
+		float gz = (z[i] - k.origin_z) / k.step;
+		float cx = gx > 0.0f ? gx : 0.0f;
+		float cz = gz > 0.0f ? gz : 0.0f;
+		cx = cx < k.last_x ? cx : k.last_x;
+		cz = cz < k.last_z ? cz : k.last_z;
+
+		float fi = (float)(int)cx;
+		float fj = (float)(int)cz;
+		fi = fi < k.last_x - 1.0f ? fi : k.last_x - 1.0f;
+		fj = fj < k.last_z - 1.0f ? fj : k.last_z - 1.0f;
+		float fx = cx - fi;
+		float fz = cz - fj;
+		float ux = 1.0f - fx;
+		float uz = 1.0f - fz;
+
+		const float* p = k.data + (size_t)(int)fi * k.pitch + (int)fj;
+		float h00 = p[0], h01 = p[1], h10 = p[k.pitch], h11 = p[k.pitch + 1];
+		float h = (h00 * ux + h10 * fx) * uz + (h01 * ux + h11 * fx) * fz;
+		float gdx = ((h10 - h00) * uz + (h11 - h01) * fz) / k.step;
+		float gdz = ((h01 - h00) * ux + (h11 - h10) * fx) / k.step;
+
+		if (k.clamp)
+		{
+			if (gx != cx) gdx = 0.0f;
+			if (gz != cz) gdz = 0.0f;
+		}
+		else if (gx != cx || gz != cz)
+		{
+			h = k.outside;
+			gdx = 0.0f;
+			gdz = 0.0f;
+		}
+
+		if (height != nullptr) height[i] = h;
+		if (dx != nullptr) dx[i] = gdx;
+		if (dz != nullptr) dz[i] = gdz;
+	}
+}
+
+#ifdef SIMD_X86
+
+/*
+	SSE2 path, 4 points at a time. there is no gather, so the corners are loaded one lane at a time
+*/
+
+SIMD_TARGET_SSE2 static inline __m128 select_sse2(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+SIMD_TARGET_SSE2 static void gradients_sse2(const query_kernel& k, const float* x, const float* z, int count, float* height, float* dx, float* dz)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 step = _mm_set1_ps(k.step);
+	const __m128 last_x = _mm_set1_ps(k.last_x);
+	const __m128 last_z = _mm_set1_ps(k.last_z);
+	const __m128 cell_x = _mm_set1_ps(k.last_x - 1.0f);
+	const __m128 cell_z = _mm_set1_ps(k.last_z - 1.0f);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 gx = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(x + i), _mm_set1_ps(k.origin_x)), step);
+		__m128 gz = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(z + i), _mm_set1_ps(k.origin_z)), step);
+		__m128 cx = _mm_min_ps(_mm_max_ps(gx, zero), last_x);
+		__m128 cz = _mm_min_ps(_mm_max_ps(gz, zero), last_z);
+
+		// the positions are on the map, so truncating is rounding down
+		__m128 fi = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(cx)), cell_x);
+		__m128 fj = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(cz)), cell_z);
+		__m128 fx = _mm_sub_ps(cx, fi);
+		__m128 fz = _mm_sub_ps(cz, fj);
+		__m128 ux = _mm_sub_ps(one, fx);
+		__m128 uz = _mm_sub_ps(one, fz);
+
+		alignas(16) int32_t ci[4], cj[4];
+		alignas(16) float c00[4], c01[4], c10[4], c11[4];
+		_mm_store_si128((__m128i*)ci, _mm_cvttps_epi32(fi));
+		_mm_store_si128((__m128i*)cj, _mm_cvttps_epi32(fj));
+		for (int l = 0; l < 4; l++)
+		{
+			const float* p = k.data + (size_t)ci[l] * k.pitch + cj[l];
+			c00[l] = p[0];
+			c01[l] = p[1];
+			c10[l] = p[k.pitch];
+			c11[l] = p[k.pitch + 1];
+		}
+		__m128 h00 = _mm_load_ps(c00), h01 = _mm_load_ps(c01), h10 = _mm_load_ps(c10), h11 = _mm_load_ps(c11);
+
+		__m128 h = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(h00, ux), _mm_mul_ps(h10, fx)), uz), _mm_mul_ps(_mm_add_ps(_mm_mul_ps(h01, ux), _mm_mul_ps(h11, fx)), fz));
+		__m128 gdx = _mm_div_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(h10, h00), uz), _mm_mul_ps(_mm_sub_ps(h11, h01), fz)), step);
+		__m128 gdz = _mm_div_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(h01, h00), ux), _mm_mul_ps(_mm_sub_ps(h11, h10), fx)), step);
+
+		__m128 off_x = _mm_cmpneq_ps(gx, cx);
+		__m128 off_z = _mm_cmpneq_ps(gz, cz);
+		if (k.clamp)
+		{
+			gdx = _mm_andnot_ps(off_x, gdx);
+			gdz = _mm_andnot_ps(off_z, gdz);
+		}
+		else
+		{
+			__m128 off = _mm_or_ps(off_x, off_z);
+			h = select_sse2(off, _mm_set1_ps(k.outside), h);
+			gdx = _mm_andnot_ps(off, gdx);
+			gdz = _mm_andnot_ps(off, gdz);
+		}
+
+		if (height != nullptr) _mm_storeu_ps(height + i, h);
+		if (dx != nullptr) _mm_storeu_ps(dx + i, gdx);
+		if (dz != nullptr) _mm_storeu_ps(dz + i, gdz);
+	}
+	gradients_scalar(k, x, z, i, count, height, dx, dz);
+}
+
+/*
+	AVX2 path, 8 points at a time
+*/
+
+SIMD_TARGET_AVX2 static void gradients_avx2(const query_kernel& k, const float* x, const float* z, int count, float* height, float* dx, float* dz)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 step = _mm256_set1_ps(k.step);
+	const __m256 last_x = _mm256_set1_ps(k.last_x);
+	const __m256 last_z = _mm256_set1_ps(k.last_z);
+	const __m256 cell_x = _mm256_set1_ps(k.last_x - 1.0f);
+	const __m256 cell_z = _mm256_set1_ps(k.last_z - 1.0f);
+	const __m256i pitch = _mm256_set1_epi32(k.pitch);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 gx = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_set1_ps(k.origin_x)), step);
+		__m256 gz = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(z + i), _mm256_set1_ps(k.origin_z)), step);
+		__m256 cx = _mm256_min_ps(_mm256_max_ps(gx, zero), last_x);
+		__m256 cz = _mm256_min_ps(_mm256_max_ps(gz, zero), last_z);
+
+		__m256 fi = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(cx)), cell_x);
+		__m256 fj = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(cz)), cell_z);
+		__m256 fx = _mm256_sub_ps(cx, fi);
+		__m256 fz = _mm256_sub_ps(cz, fj);
+		__m256 ux = _mm256_sub_ps(one, fx);
+		__m256 uz = _mm256_sub_ps(one, fz);
+
+		// the corners are gathered, the maps are small enough for their indices to fit in 32 bits
+		__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(fi), pitch), _mm256_cvttps_epi32(fj));
+		__m256 h00 = _mm256_i32gather_ps(k.data, index, 4);
+		__m256 h01 = _mm256_i32gather_ps(k.data + 1, index, 4);
+		__m256 h10 = _mm256_i32gather_ps(k.data + k.pitch, index, 4);
+		__m256 h11 = _mm256_i32gather_ps(k.data + k.pitch + 1, index, 4);
+
+		__m256 h = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(h00, ux), _mm256_mul_ps(h10, fx)), uz), _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(h01, ux), _mm256_mul_ps(h11, fx)), fz));
+		__m256 gdx = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(h10, h00), uz), _mm256_mul_ps(_mm256_sub_ps(h11, h01), fz)), step);
+		__m256 gdz = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(h01, h00), ux), _mm256_mul_ps(_mm256_sub_ps(h11, h10), fx)), step);
+
+		__m256 off_x = _mm256_cmp_ps(gx, cx, _CMP_NEQ_UQ);
+		__m256 off_z = _mm256_cmp_ps(gz, cz, _CMP_NEQ_UQ);
+		if (k.clamp)
+		{
+			gdx = _mm256_andnot_ps(off_x, gdx);
+			gdz = _mm256_andnot_ps(off_z, gdz);
+		}
+		else
+		{
+			__m256 off = _mm256_or_ps(off_x, off_z);
+			h = _mm256_blendv_ps(h, _mm256_set1_ps(k.outside), off);
+			gdx = _mm256_andnot_ps(off, gdx);
+			gdz = _mm256_andnot_ps(off, gdz);
+		}
+
+		if (height != nullptr) _mm256_storeu_ps(height + i, h);
+		if (dx != nullptr) _mm256_storeu_ps(dx + i, gdx);
+		if (dz != nullptr) _mm256_storeu_ps(dz + i, gdz);
+	}
+	gradients_scalar(k, x, z, i, count, height, dx, dz);
+}
+
+#endif
+
+void heightfield_query::gradients(const float* x, const float* z, int count, float* height, float* dx, float* dz) const
+{
+	query_kernel k;
+	k.data = map->data();
+	k.pitch = map->size_y();
+	k.last_x = (float)(map->size_x() - 1);
+	k.last_z = (float)(map->size_y() - 1);
+	k.step = step;
+	k.origin_x = origin.x;
+	k.origin_z = origin.y;
+	k.clamp = bounds == QUERY_CLAMP;
+	k.outside = outside;
+
+#ifdef SIMD_X86
+	switch (simd_detect())
+	{
+	case SIMD_AVX2:
+		gradients_avx2(k, x, z, count, height, dx, dz);
+		return;
+	case SIMD_SSE2:
+		gradients_sse2(k, x, z, count, height, dx, dz);
+		return;
+	default:
+		break;
+	}
+#endif
+	gradients_scalar(k, x, z, 0, count, height, dx, dz);
+}
+
+static inline glm::vec3 gradient_normal(float dx, float dz)
+{
+	float length = sqrtf(dx * dx + dz * dz + 1.0f);
+	return glm::vec3(-dx / length, 1.0f / length, -dz / length);
+}
+
+static inline float gradient_slope(float dx, float dz)
+{
+	return sqrtf(dx * dx + dz * dz);
+}
+
+void heightfield_query::heights(const float* x, const float* z, int count, float* out) const
+{
+	gradients(x, z, count, out, nullptr, nullptr);
+}
+
+void heightfield_query::normals(const float* x, const float* z, int count, glm::vec3* out) const
+{
+	float dx[QUERY_BATCH], dz[QUERY_BATCH];
+	for (int start = 0; start < count; start += QUERY_BATCH)
+	{
+		int n = count - start < QUERY_BATCH ? count - start : QUERY_BATCH;
+		gradients(x + start, z + start, n, nullptr, dx, dz);
+		for (int i = 0; i < n; i++)
+			out[start + i] = gradient_normal(dx[i], dz[i]);
+	}
+}
+
+void heightfield_query::slopes(const float* x, const float* z, int count, float* out) const
+{
+	float dx[QUERY_BATCH], dz[QUERY_BATCH];
+	for (int start = 0; start < count; start += QUERY_BATCH)
+	{
+		int n = count - start < QUERY_BATCH ? count - start : QUERY_BATCH;
+		gradients(x + start, z + start, n, nullptr, dx, dz);
+		for (int i = 0; i < n; i++)
+			out[start + i] = gradient_slope(dx[i], dz[i]);
+	}
+}
+
+void heightfield_query::samples(const float* x, const float* z, int count, ground_sample* out) const
+{
+	float h[QUERY_BATCH], dx[QUERY_BATCH], dz[QUERY_BATCH];
+	for (int start = 0; start < count; start += QUERY_BATCH)
+	{
+		int n = count - start < QUERY_BATCH ? count - start : QUERY_BATCH;
+		gradients(x + start, z + start, n, h, dx, dz);
+		for (int i = 0; i < n; i++)
+		{
+			out[start + i].height = h[i];
+			out[start + i].normal = gradient_normal(dx[i], dz[i]);
+			out[start + i].slope = gradient_slope(dx[i], dz[i]);
+		}
+	}
+}
+
+float heightfield_query::height(float x, float z) const
+{
+	float h;
+	gradients(&x, &z, 1, &h, nullptr, nullptr);
+	return h;
+}
+
+glm::vec3 heightfield_query::normal(float x, float z) const
+{
+	glm::vec3 n;
+	normals(&x, &z, 1, &n);
+	return n;
+}
+
+float heightfield_query::slope(float x, float z) const
+{
+	float s;
+	slopes(&x, &z, 1, &s);
+	return s;
+}
+
+ground_sample heightfield_query::sample(float x, float z) const
+{
+	ground_sample s;
+	samples(&x, &z, 1, &s);
+	return s;
+}
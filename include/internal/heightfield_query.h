@@ -0,0 +1,71 @@
+#ifndef HEIGHTFIELD_QUERY_DEF
+#define HEIGHTFIELD_QUERY_DEF
+
+#include <internal/heightfield.h>
+#include <internal/simd.h>
+#include <glm/glm.hpp>
+
+/*
+	ground under points of the world, for the player and anything else that stands on the terrain. a query
+	is a view over a heightmap with points step world units apart, the first one at origin, and reads it
+	bilinearly between the points. batches of points are read 8 at a time with AVX2,
+	4 with SSE2, doing the same operations as a single point so the results are the same either way.
+*/
+
+// what points off the heightmap read as
+enum query_bounds
+{
+	// the edge points go on forever, flat in the direction away from the map
+	QUERY_CLAMP = 0,
+
+	// flat ground at the outside height, like the sea around an island
+	QUERY_OUTSIDE = 1
+};
+
+// ground under a point: its height, its normal and its slope (height per unit of distance)
+struct ground_sample
+{
+	float height;
+	glm::vec3 normal;
+	float slope;
+};
+
+class heightfield_query
+{
+public:
+	// the heightmap needs at least 2 x 2 points and has to outlive the query, which is cheap to make and copy
+	heightfield_query(const heightfield<float>& map, float step, glm::vec2 origin, query_bounds bounds = QUERY_CLAMP, float outside = 0);
+
+	// between world x, z and points of the heightmap, fractional in between
+	glm::vec2 to_grid(glm::vec2 world) const { return (world - origin) / step; }
+	glm::vec2 to_world(glm::vec2 grid) const { return grid * step + origin; }
+
+	// whether world x, z is over the heightmap, edges included
+	bool contains(float x, float z) const;
+
+	float height(float x, float z) const;
+	glm::vec3 normal(float x, float z) const;
+	float slope(float x, float z) const;
+	ground_sample sample(float x, float z) const;
+
+	// the same for count points (x[i], z[i]) into out[i]
+	void heights(const float* x, const float* z, int count, float* out) const;
+	void normals(const float* x, const float* z, int count, glm::vec3* out) const;
+	void slopes(const float* x, const float* z, int count, float* out) const;
+	void samples(const float* x, const float* z, int count, ground_sample* out) const;
+
+	/*
+		the height and the gradient (dx, dz) at count points, into whichever outputs aren't null. what the
+		functions above are built on, gradients are turned into normals and slopes the same way at every point
+	*/
+	void gradients(const float* x, const float* z, int count, float* height, float* dx, float* dz) const;
+
+private:
+	const heightfield<float>* map;
+	float step;
+	glm::vec2 origin;
+	query_bounds bounds;
+	float outside;
+};
+
+#endif // !HEIGHTFIELD_QUERY_DEF
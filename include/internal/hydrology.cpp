@@ -0,0 +1,520 @@
+#include <internal/hydrology.h>
+#include <internal/distance_field.h>
+#include <cmath>
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// the 8 neighbours of a point, the index is the flow direction
+static const int neighbour_x[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+static const int neighbour_y[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+static const double neighbour_distance[8] = { 1.41421356237309515, 1, 1.41421356237309515, 1, 1, 1.41421356237309515, 1, 1.41421356237309515 };
+
+// watershed of the points that drain off the edge of the map
+#define LABEL_OCEAN 0
+
+// points of a tile waiting in the flood queue without a watershed yet, and points not reached at all
+#define LABEL_PENDING -1
+#define LABEL_NONE -2
+
+hydrology_settings default_hydrology_settings()
+{
+	hydrology_settings settings;
+	settings.river_area = 2000;
+	settings.river_depth = 3;
+	settings.lake_depth = 0.5;
+	return settings;
+}
+
+// the tiles of a map, numbered row after row
+struct tile_grid
+{
+	int size_x;
+	int size_y;
+	int count_x;
+	int count_y;
+
+	tile_grid(int size_x, int size_y) : size_x(size_x), size_y(size_y),
+		count_x((size_x + HYDROLOGY_TILE_SIZE - 1) / HYDROLOGY_TILE_SIZE), count_y((size_y + HYDROLOGY_TILE_SIZE - 1) / HYDROLOGY_TILE_SIZE) {}
+
+	int count() const { return count_x * count_y; }
+	int tile(int x, int y) const { return (x / HYDROLOGY_TILE_SIZE) * count_y + y / HYDROLOGY_TILE_SIZE; }
+
+	int x0(int t) const { return (t / count_y) * HYDROLOGY_TILE_SIZE; }
+	int y0(int t) const { return (t % count_y) * HYDROLOGY_TILE_SIZE; }
+	int x1(int t) const { return std::min(x0(t) + HYDROLOGY_TILE_SIZE, size_x); }
+	int y1(int t) const { return std::min(y0(t) + HYDROLOGY_TILE_SIZE, size_y); }
+
+	// call f(x, y) for every point on the edge of tile t, once each
+	template <typename F>
+	void perimeter(int t, F f) const
+	{
+		int ax = x0(t), bx = x1(t), ay = y0(t), by = y1(t);
+		for (int y = ay; y < by; y++)
+		{
+			f(ax, y);
+			if (bx - 1 > ax) f(bx - 1, y);
+		}
+		for (int x = ax + 1; x < bx - 1; x++)
+		{
+			f(x, ay);
+			if (by - 1 > ay) f(x, by - 1);
+		}
+	}
+};
+
+// lowest known spill height between two watersheds
+struct spill_edge
+{
+	int a;
+	int b;
+	double height;
+
+	bool operator<(const spill_edge& e) const { return a != e.a ? a < e.a : (b != e.b ? b < e.b : height < e.height); }
+};
+
+static void add_spill_edge(std::vector<spill_edge>& edges, int a, int b, double height)
+{
+	spill_edge e;
+	e.a = std::min(a, b);
+	e.b = std::max(a, b);
+	e.height = height;
+	edges.push_back(e);
+}
+
+// point of the flood queue, lowest first. ties go to the point queued first, so the order is fixed
+struct flood_point
+{
+	double height;
+	int64_t order;
+	int x;
+	int y;
+
+	bool operator<(const flood_point& p) const { return height != p.height ? height > p.height : order > p.order; }
+};
+
+void fill_depressions(const heightfield<double>& map, heightfield<double>& filled, thread_pool& pool)
+{
+	int size_x = map.size_x();
+	int size_y = map.size_y();
+	tile_grid tiles(size_x, size_y);
+
+	filled.resize(size_x, size_y);
+	heightfield<int32_t> label(size_x, size_y, LABEL_NONE);
+
+	// every edge point of a tile can start a watershed, labels of tile t start at first_label(t)
+	const int labels_per_tile = 4 * HYDROLOGY_TILE_SIZE;
+	auto first_label = [&](int t) { return 1 + t * labels_per_tile; };
+	std::vector<std::vector<spill_edge>> tile_edges(tiles.count());
+
+	// flood every tile from its own edge
+	pool.parallel_for(tiles.count(), [&](int t)
+	{
+		int ax = tiles.x0(t), bx = tiles.x1(t), ay = tiles.y0(t), by = tiles.y1(t);
+		std::priority_queue<flood_point> queue;
+		int64_t order = 0;
+		int next_label = first_label(t);
+		std::vector<spill_edge>& edges = tile_edges[t];
+
+		tiles.perimeter(t, [&](int x, int y)
+		{
+			bool map_edge = x == 0 || y == 0 || x == size_x - 1 || y == size_y - 1;
+			filled[x][y] = map[x][y];
+			label[x][y] = map_edge ? LABEL_OCEAN : LABEL_PENDING;
+			flood_point p = { map[x][y], order++, x, y };
+			queue.push(p);
+		});
+
+		while (!queue.empty())
+		{
+			flood_point p = queue.top();
+			queue.pop();
+
+			int32_t l = label[p.x][p.y];
+			if (l == LABEL_PENDING)
+				label[p.x][p.y] = l = next_label++;
+
+			for (int k = 0; k < 8; k++)
+			{
+				int x = p.x + neighbour_x[k];
+				int y = p.y + neighbour_y[k];
+				if (x < ax || x >= bx || y < ay || y >= by)
+					continue;
+
+				int32_t n = label[x][y];
+				if (n == LABEL_NONE)
+				{
+					filled[x][y] = std::max(map[x][y], p.height);
+					label[x][y] = l;
+					flood_point q = { filled[x][y], order++, x, y };
+					queue.push(q);
+				}
+				else if (n >= 0 && n != l)
+					add_spill_edge(edges, l, n, std::max(p.height, filled[x][y]));
+			}
+		}
+
+		std::sort(edges.begin(), edges.end());
+	});
+
+	// the edges of neighbouring tiles touch as well
+	std::vector<spill_edge> edges;
+	for (int t = 0; t < tiles.count(); t++)
+	{
+		edges.insert(edges.end(), tile_edges[t].begin(), tile_edges[t].end());
+		std::vector<spill_edge>().swap(tile_edges[t]);
+
+		tiles.perimeter(t, [&](int x, int y)
+		{
+			for (int k = 0; k < 8; k++)
+			{
+				int nx = x + neighbour_x[k];
+				int ny = y + neighbour_y[k];
+				if (nx < 0 || nx >= size_x || ny < 0 || ny >= size_y || tiles.tile(nx, ny) <= t)
+					continue;
+				if (label[x][y] != label[nx][ny])
+					add_spill_edge(edges, label[x][y], label[nx][ny], std::max(filled[x][y], filled[nx][ny]));
+			}
+		});
+	}
+
+	// keep the lowest edge between every two watersheds
+	std::sort(edges.begin(), edges.end());
+	int label_count = first_label(tiles.count());
+	std::vector<std::vector<std::pair<int, double>>> graph(label_count);
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		if (i > 0 && edges[i].a == edges[i - 1].a && edges[i].b == edges[i - 1].b)
+			continue;
+		graph[edges[i].a].push_back(std::make_pair(edges[i].b, edges[i].height));
+		graph[edges[i].b].push_back(std::make_pair(edges[i].a, edges[i].height));
+	}
+
+	// height every watershed fills up to before it spills into the ocean, the same flood on the graph
+	std::vector<double> spill(label_count, INFINITY);
+	std::vector<bool> done(label_count, false);
+	std::priority_queue<flood_point> queue;
+	int64_t order = 0;
+	spill[LABEL_OCEAN] = -INFINITY;
+	flood_point start = { -INFINITY, order++, LABEL_OCEAN, 0 };
+	queue.push(start);
+
+	while (!queue.empty())
+	{
+		flood_point p = queue.top();
+		queue.pop();
+		if (done[p.x]) continue;
+		done[p.x] = true;
+
+		for (size_t i = 0; i < graph[p.x].size(); i++)
+		{
+			int n = graph[p.x][i].first;
+			double height = std::max(p.height, graph[p.x][i].second);
+			if (!done[n] && height < spill[n])
+			{
+				spill[n] = height;
+				flood_point q = { height, order++, n, 0 };
+				queue.push(q);
+			}
+		}
+	}
+
+	pool.parallel_for(size_x, [&](int x)
+	{
+		for (int y = 0; y < size_y; y++)
+			filled[x][y] = std::max(filled[x][y], spill[label[x][y]]);
+	});
+}
+
+// direction marking a flat point until the flats are resolved
+#define FLOW_FLAT 9
+
+void flow_directions(const heightfield<double>& filled, double water_level, heightfield<uint8_t>& direction, thread_pool& pool)
+{
+	int size_x = filled.size_x();
+	int size_y = filled.size_y();
+	direction.resize(size_x, size_y, FLOW_NONE);
+
+	// steepest way down, or flat if there is none
+	pool.parallel_for(size_x, [&](int x)
+	{
+		for (int y = 0; y < size_y; y++)
+		{
+			double h = filled[x][y];
+			if (x == 0 || y == 0 || x == size_x - 1 || y == size_y - 1 || h <= water_level)
+			{
+				direction[x][y] = FLOW_NONE;
+				continue;
+			}
+
+			int best = FLOW_FLAT;
+			double steepest = 0;
+			for (int k = 0; k < 8; k++)
+			{
+				double slope = (h - filled[x + neighbour_x[k]][y + neighbour_y[k]]) / neighbour_distance[k];
+				if (slope > steepest)
+				{
+					steepest = slope;
+					best = k;
+				}
+			}
+			direction[x][y] = (uint8_t)best;
+		}
+	});
+
+	/*
+		flats are the surfaces of filled hollows, all at the same height. spread out from the points next to a
+		flat that water can leave by, every flat point draining towards the point it was reached from, so the
+		water crosses the flat the shortest way to its outlet
+	*/
+	std::vector<int64_t> frontier;
+	std::vector<uint8_t> outlets;
+	for (int x = 1; x < size_x - 1; x++)
+	{
+		for (int y = 1; y < size_y - 1; y++)
+		{
+			if (direction[x][y] != FLOW_FLAT)
+				continue;
+			for (int k = 0; k < 8; k++)
+			{
+				int nx = x + neighbour_x[k];
+				int ny = y + neighbour_y[k];
+				if (direction[nx][ny] != FLOW_FLAT && filled[nx][ny] <= filled[x][y])
+				{
+					frontier.push_back((int64_t)x * size_y + y);
+					outlets.push_back((uint8_t)k);
+					break;
+				}
+			}
+		}
+	}
+	for (size_t i = 0; i < frontier.size(); i++)
+		direction[(int)(frontier[i] / size_y)][(int)(frontier[i] % size_y)] = outlets[i];
+
+	for (size_t i = 0; i < frontier.size(); i++)
+	{
+		int x = (int)(frontier[i] / size_y);
+		int y = (int)(frontier[i] % size_y);
+		for (int k = 0; k < 8; k++)
+		{
+			int nx = x + neighbour_x[k];
+			int ny = y + neighbour_y[k];
+			if (direction[nx][ny] == FLOW_FLAT)
+			{
+				// the opposite direction of k
+				direction[nx][ny] = (uint8_t)(7 - k);
+				frontier.push_back((int64_t)nx * size_y + ny);
+			}
+		}
+	}
+
+	// flats with no way out (only if the map wasn't filled) hold their water
+	pool.parallel_for(size_x, [&](int x)
+	{
+		for (int y = 0; y < size_y; y++)
+			if (direction[x][y] == FLOW_FLAT)
+				direction[x][y] = FLOW_NONE;
+	});
+}
+
+void flow_accumulation(const heightfield<uint8_t>& direction, heightfield<uint32_t>& accumulation, thread_pool& pool)
+{
+	int size_x = direction.size_x();
+	int size_y = direction.size_y();
+	tile_grid tiles(size_x, size_y);
+
+	accumulation.resize(size_x, size_y, 1);
+
+	// for every point, the last point its water reaches in its own tile: where it leaves the tile, or the
+	// point it stops at (with FLOW_NONE)
+	heightfield<int64_t> last(size_x, size_y);
+	auto inside = [&](int t, int x, int y) { return x >= tiles.x0(t) && x < tiles.x1(t) && y >= tiles.y0(t) && y < tiles.y1(t); };
+
+	// count what drains through every point from its own tile, in topological order
+	pool.parallel_for(tiles.count(), [&](int t)
+	{
+		int ax = tiles.x0(t), bx = tiles.x1(t), ay = tiles.y0(t), by = tiles.y1(t);
+		int w = by - ay;
+		std::vector<uint8_t> inflows((size_t)(bx - ax) * w, 0);
+		for (int x = ax; x < bx; x++)
+		{
+			for (int y = ay; y < by; y++)
+			{
+				int k = direction[x][y];
+				if (k != FLOW_NONE && inside(t, x + neighbour_x[k], y + neighbour_y[k]))
+					inflows[(size_t)(x + neighbour_x[k] - ax) * w + y + neighbour_y[k] - ay]++;
+			}
+		}
+
+		std::vector<int64_t> order;
+		order.reserve(inflows.size());
+		for (int x = ax; x < bx; x++)
+			for (int y = ay; y < by; y++)
+				if (inflows[(size_t)(x - ax) * w + y - ay] == 0)
+					order.push_back((int64_t)x * size_y + y);
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			int x = (int)(order[i] / size_y);
+			int y = (int)(order[i] % size_y);
+			int k = direction[x][y];
+			if (k == FLOW_NONE) continue;
+
+			int nx = x + neighbour_x[k];
+			int ny = y + neighbour_y[k];
+			if (!inside(t, nx, ny)) continue;
+
+			accumulation[nx][ny] += accumulation[x][y];
+			if (--inflows[(size_t)(nx - ax) * w + ny - ay] == 0)
+				order.push_back((int64_t)nx * size_y + ny);
+		}
+
+		// downstream points come later in the order
+		for (size_t i = order.size(); i-- > 0;)
+		{
+			int x = (int)(order[i] / size_y);
+			int y = (int)(order[i] % size_y);
+			int k = direction[x][y];
+			if (k == FLOW_NONE || !inside(t, x + neighbour_x[k], y + neighbour_y[k]))
+				last[x][y] = order[i];
+			else
+				last[x][y] = last[x + neighbour_x[k]][y + neighbour_y[k]];
+		}
+	});
+
+	/*
+		the points water leaves the tiles by form a much smaller graph: each one passes everything it carries to
+		the point the water leaves the next tile by. total it up in topological order
+	*/
+	std::vector<int64_t> exits;
+	std::unordered_map<int64_t, int> exit_index;
+	for (int t = 0; t < tiles.count(); t++)
+	{
+		tiles.perimeter(t, [&](int x, int y)
+		{
+			int k = direction[x][y];
+			if (k != FLOW_NONE && !inside(t, x + neighbour_x[k], y + neighbour_y[k]))
+			{
+				exit_index[(int64_t)x * size_y + y] = (int)exits.size();
+				exits.push_back((int64_t)x * size_y + y);
+			}
+		});
+	}
+
+	// the exit of the next tile every exit drains to, -1 if the water stops in that tile
+	std::vector<int> next(exits.size(), -1);
+	std::vector<int> inflows(exits.size(), 0);
+	std::vector<uint32_t> carried(exits.size());
+	for (size_t e = 0; e < exits.size(); e++)
+	{
+		int x = (int)(exits[e] / size_y);
+		int y = (int)(exits[e] % size_y);
+		int k = direction[x][y];
+		carried[e] = accumulation[x][y];
+
+		std::unordered_map<int64_t, int>::const_iterator found = exit_index.find(last[x + neighbour_x[k]][y + neighbour_y[k]]);
+		if (found != exit_index.end())
+		{
+			next[e] = found->second;
+			inflows[found->second]++;
+		}
+	}
+
+	std::vector<int> order;
+	for (size_t e = 0; e < exits.size(); e++)
+		if (inflows[e] == 0)
+			order.push_back((int)e);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		int n = next[order[i]];
+		if (n < 0) continue;
+		carried[n] += carried[order[i]];
+		if (--inflows[n] == 0)
+			order.push_back(n);
+	}
+
+	// what flows into every tile, and where
+	std::vector<std::vector<std::pair<int64_t, uint32_t>>> entries(tiles.count());
+	for (size_t e = 0; e < exits.size(); e++)
+	{
+		int x = (int)(exits[e] / size_y);
+		int y = (int)(exits[e] % size_y);
+		int k = direction[x][y];
+		int nx = x + neighbour_x[k];
+		int ny = y + neighbour_y[k];
+		entries[tiles.tile(nx, ny)].push_back(std::make_pair((int64_t)nx * size_y + ny, carried[e]));
+	}
+
+	// add it along the path from where it enters to where it leaves
+	pool.parallel_for(tiles.count(), [&](int t)
+	{
+		for (size_t i = 0; i < entries[t].size(); i++)
+		{
+			int x = (int)(entries[t][i].first / size_y);
+			int y = (int)(entries[t][i].first % size_y);
+			uint32_t amount = entries[t][i].second;
+			for (;;)
+			{
+				accumulation[x][y] += amount;
+				int k = direction[x][y];
+				if (k == FLOW_NONE || !inside(t, x + neighbour_x[k], y + neighbour_y[k]))
+					break;
+				x += neighbour_x[k];
+				y += neighbour_y[k];
+			}
+		}
+	});
+}
+
+void compute_hydrology(heightfield<double>& map, double spacing, double water_level, const hydrology_settings& settings, hydrology_map& hydrology, thread_pool& pool)
+{
+	fill_depressions(map, hydrology.filled, pool);
+	flow_directions(hydrology.filled, water_level, hydrology.direction, pool);
+	flow_accumulation(hydrology.direction, hydrology.accumulation, pool);
+
+	int size_x = map.size_x();
+	int size_y = map.size_y();
+	hydrology.water.resize(size_x, size_y, WATER_NONE);
+	hydrology.surface.resize(size_x, size_y);
+
+	// points a river starts at, the rivers get deeper with the square root of what they carry
+	double threshold = std::max(settings.river_area / (spacing * spacing), 1.0);
+
+	pool.parallel_for(size_x, [&](int x)
+	{
+		for (int y = 0; y < size_y; y++)
+		{
+			double filled = hydrology.filled[x][y];
+			double ground = map[x][y];
+
+			if (filled <= water_level)
+			{
+				hydrology.water[x][y] = WATER_SEA;
+				hydrology.surface[x][y] = (float)water_level;
+			}
+			else if (filled - ground > settings.lake_depth)
+			{
+				hydrology.water[x][y] = WATER_LAKE;
+				hydrology.surface[x][y] = (float)filled;
+			}
+			else if (hydrology.accumulation[x][y] >= threshold)
+			{
+				double depth = settings.river_depth * std::min(0.25 * sqrt(hydrology.accumulation[x][y] / threshold), 1.0);
+				map[x][y] = ground - depth;
+				hydrology.water[x][y] = WATER_RIVER;
+				hydrology.surface[x][y] = (float)(ground - depth / 2);
+			}
+			else
+				hydrology.surface[x][y] = (float)ground;
+		}
+	});
+
+	heightfield<uint8_t> land(size_x, size_y);
+	pool.parallel_for(size_x, [&](int x)
+	{
+		for (int y = 0; y < size_y; y++)
+			land[x][y] = hydrology.water[x][y] != WATER_SEA;
+	});
+	signed_distance_field(land, (float)spacing, hydrology.coast, pool);
+}
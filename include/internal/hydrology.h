@@ -0,0 +1,93 @@
+#ifndef HYDROLOGY_DEF
+#define HYDROLOGY_DEF
+
+#include <stdint.h>
+#include <internal/heightfield.h>
+#include <internal/thread_pool.h>
+
+/*
+	where the rain that falls on an island goes: which hollows fill up into lakes, which way water flows from
+	every point, how much of the island drains through it, and where that is enough to cut a river.
+
+	the map is processed in square tiles of HYDROLOGY_TILE_SIZE points, so the heavy passes run one tile per job
+	and only small graphs between the tiles are solved on one thread. the tiles don't depend on the number of
+	threads and everything is integers or maxima, so neither does the result.
+*/
+
+// side length of the tiles the flood and accumulation passes are split into
+#define HYDROLOGY_TILE_SIZE 256
+
+// flow directions, index into the 8 neighbours (see hydrology.cpp) or one of these
+#define FLOW_NONE 8
+
+// beaches reach this far from the coast (in world units) and this high above the water level
+#define BEACH_WIDTH 24
+#define BEACH_HEIGHT 2.5
+
+enum water_type
+{
+	WATER_NONE,
+	WATER_SEA,
+	WATER_LAKE,
+	WATER_RIVER
+};
+
+struct hydrology_settings
+{
+	// area of the island, in world units squared, that has to drain through a point for a river to start there
+	double river_area;
+
+	// how deep the largest rivers are cut, they start at a quarter of that
+	double river_depth;
+
+	// hollows shallower than this when filled are left dry
+	double lake_depth;
+};
+
+hydrology_settings default_hydrology_settings();
+
+struct hydrology_map
+{
+	// the map with every hollow filled up to where it would spill over
+	heightfield<double> filled;
+
+	// direction water flows from every point, FLOW_NONE where it leaves the island or reaches the sea
+	heightfield<uint8_t> direction;
+
+	// points that drain through every point, itself included
+	heightfield<uint32_t> accumulation;
+
+	// water_type of every point, and the height of the water there
+	heightfield<uint8_t> water;
+	heightfield<float> surface;
+
+	// signed distance to the coast in world units, positive on land (lakes and rivers included), negative in the sea
+	heightfield<float> coast;
+};
+
+// coast: signed distance to the sea, height: above the water level. sand within BEACH_WIDTH of the coast and below BEACH_HEIGHT
+inline bool is_beach(double coast, double height)
+{
+	return coast < BEACH_WIDTH && height < BEACH_HEIGHT;
+}
+
+/*
+	priority-flood depression filling (Barnes, Lehman and Mulla), split into tiles: every tile is flooded from
+	its own edge, labelling the watershed of every edge point, then the spill heights between the watersheds are
+	found on the much smaller graph of labels, and every point is raised to the spill height of its watershed.
+	water leaves the map at its edges
+*/
+void fill_depressions(const heightfield<double>& map, heightfield<double>& filled, thread_pool& pool);
+
+// D8 steepest descent on the filled map. flat areas drain towards the nearest point they can spill from.
+// points on the edge of the map or at or below water_level get FLOW_NONE
+void flow_directions(const heightfield<double>& filled, double water_level, heightfield<uint8_t>& direction, thread_pool& pool);
+
+// number of points upstream of every point, every tile on its own first and then what flows in from other tiles
+void flow_accumulation(const heightfield<uint8_t>& direction, heightfield<uint32_t>& accumulation, thread_pool& pool);
+
+// run all of the above on a map with points spacing apart, then cut the rivers into the map, classify the water
+// and measure the distance to the coast
+void compute_hydrology(heightfield<double>& map, double spacing, double water_level, const hydrology_settings& settings, hydrology_map& hydrology, thread_pool& pool);
+
+#endif // !HYDROLOGY_DEF
@@ -1,6 +1,6 @@
 #include <internal/loading_screen.h>
 
-void loading_screen(GLFWwindow* window, int& percentage, GLuint program_id, glm::vec3 background, glm::vec3 progress_bar, glm::vec3 progress_bar_border)
+bool loading_screen(GLFWwindow* window, const terrain_progress& progress, GLuint program_id, glm::vec3 background, glm::vec3 progress_bar, glm::vec3 progress_bar_border)
 {
 	glDisable(GL_CULL_FACE);
 	glDisable(GL_DEPTH_TEST);
@@ -79,11 +79,20 @@ void loading_screen(GLFWwindow* window, int& percentage, GLuint program_id, glm:
 	glm::vec3 ambient_light_color = glm::vec3(0.2f, 0.2f, 0.2f);
 	GLuint ambient_light_id = glGetUniformLocation(program_id, "ambient_light_color");
 
-	while (percentage != 100)
+	bool window_open = true;
+	while (!progress.finished())
 	{
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		
 		glfwPollEvents();
+		if (glfwWindowShouldClose(window))
+		{
+			window_open = false;
+			break;
+		}
+
+		// read once, the generator keeps updating it while the bar is built
+		int percentage = progress.percentage();
 
 		vertices[6] = glm::vec3(0, 0, 0);
 		vertices[7] = glm::vec3(0, 0, percentage*2);
@@ -163,4 +172,6 @@ void loading_screen(GLFWwindow* window, int& percentage, GLuint program_id, glm:
 	}
 	glEnable(GL_CULL_FACE);
 	glEnable(GL_DEPTH_TEST);
+
+	return window_open;
 }
\ No newline at end of file
@@ -5,5 +5,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <GLFW/glfw3.h>
+#include <internal/terrain_generation.h>
 
-void loading_screen(GLFWwindow* window, int& percentage, GLuint program_id, glm::vec3 background, glm::vec3 progress_bar, glm::vec3 progress_bar_border);
\ No newline at end of file
+// draw a progress bar until progress is finished. returns false if the window was closed first
+bool loading_screen(GLFWwindow* window, const terrain_progress& progress, GLuint program_id, glm::vec3 background, glm::vec3 progress_bar, glm::vec3 progress_bar_border);
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include <internal/mapped_file.h>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+mapped_file::mapped_file() : file(INVALID_HANDLE_VALUE), mapping(NULL), view(NULL), view_length(0), failed(false)
+{
+}
+
+bool mapped_file::create(const char* path, uint64_t size)
+{
+	close();
+	failed = false;
+
+	file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// the mapping sets the size of the file
+	mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+	if (mapping == NULL)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+char* mapped_file::map(uint64_t offset, size_t length)
+{
+	unmap();
+	if (mapping == NULL)
+		return NULL;
+
+	// views have to start on the allocation granularity
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	uint64_t start = offset - offset % info.dwAllocationGranularity;
+
+	view_length = (size_t)(offset - start) + length;
+	view = MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)(start >> 32), (DWORD)start, view_length);
+	if (view == NULL)
+	{
+		failed = true;
+		return NULL;
+	}
+	return (char*)view + (offset - start);
+}
+
+void mapped_file::unmap()
+{
+	if (view == NULL)
+		return;
+
+	if (!FlushViewOfFile(view, 0))
+		failed = true;
+	UnmapViewOfFile(view);
+	view = NULL;
+}
+
+bool mapped_file::close()
+{
+	unmap();
+	if (mapping != NULL)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+	return !failed;
+}
+
+#else
+
+mapped_file::mapped_file() : file(-1), view(NULL), view_length(0), failed(false)
+{
+}
+
+bool mapped_file::create(const char* path, uint64_t size)
+{
+	close();
+	failed = false;
+
+	file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (file < 0)
+		return false;
+
+	if (ftruncate(file, (off_t)size) != 0)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+char* mapped_file::map(uint64_t offset, size_t length)
+{
+	unmap();
+	if (file < 0)
+		return NULL;
+
+	// views have to start on a page
+	uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+	uint64_t start = offset - offset % page;
+
+	view_length = (size_t)(offset - start) + length;
+	view = mmap(NULL, view_length, PROT_READ | PROT_WRITE, MAP_SHARED, file, (off_t)start);
+	if (view == MAP_FAILED)
+	{
+		view = NULL;
+		failed = true;
+		return NULL;
+	}
+	return (char*)view + (offset - start);
+}
+
+void mapped_file::unmap()
+{
+	if (view == NULL)
+		return;
+
+	// write the pages out now, so they can be dropped instead of piling up as dirty memory
+	if (msync(view, view_length, MS_SYNC) != 0)
+		failed = true;
+	munmap(view, view_length);
+	view = NULL;
+}
+
+bool mapped_file::close()
+{
+	unmap();
+	if (file >= 0 && ::close(file) != 0)
+		failed = true;
+	file = -1;
+	return !failed;
+}
+
+#endif
+
+mapped_file::~mapped_file()
+{
+	close();
+}
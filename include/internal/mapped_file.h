@@ -0,0 +1,45 @@
+#ifndef MAPPED_FILE_DEF
+#define MAPPED_FILE_DEF
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+	file written through a memory mapped window, for outputs too large to keep in RAM. only the part that is
+	mapped is in the address space, and the OS writes pages back to the file and drops them as it needs,
+	so the memory used is bounded by the window rather than the file.
+*/
+class mapped_file
+{
+public:
+	mapped_file();
+	~mapped_file();
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	// create the file, or truncate an existing one, with size bytes of zeros
+	bool create(const char* path, uint64_t size);
+
+	// map bytes [offset, offset + length) for writing, replacing the previous window. null on failure
+	char* map(uint64_t offset, size_t length);
+
+	// write the window back and unmap it
+	void unmap();
+
+	// unmap and close, returns false if anything failed to be written
+	bool close();
+
+private:
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+	void* view;
+	size_t view_length;
+	bool failed;
+};
+
+#endif // !MAPPED_FILE_DEF
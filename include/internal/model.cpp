@@ -1,4 +1,6 @@
+#define _CRT_SECURE_NO_WARNINGS // fopen and fscanf, the _s versions only exist on Windows
 #include <internal/model.h>
+#include <string.h>
 
 model::model()
 {
@@ -21,9 +23,7 @@ bool model::load_model(const char * obj_path, const char * mtl_path)
 	std::vector<glm::vec3> temp_vertices, temp_colors, temp_normals;
 	int color_index = -1;
 
-	FILE * file;
-
-	fopen_s(&file, obj_path, "r");
+	FILE * file = fopen(obj_path, "r");
 	if (file == NULL)
 	{
 		printf("could not open object file!\n");
@@ -34,7 +34,7 @@ bool model::load_model(const char * obj_path, const char * mtl_path)
 		char line_header[128];
 
 		// read first word of line
-		int res = fscanf_s(file, "%s", line_header, 128);
+		int res = fscanf(file, "%127s", line_header);
 		if (res == EOF)
 		{
 			break;
@@ -43,24 +43,24 @@ bool model::load_model(const char * obj_path, const char * mtl_path)
 		{
 			// vertex position
 			glm::vec3 vertex;
-			fscanf_s(file, "%f %f %f", &vertex.x, &vertex.y, &vertex.z);
+			fscanf(file, "%f %f %f", &vertex.x, &vertex.y, &vertex.z);
 			temp_vertices.push_back(vertex);
 		}
 		else if (strcmp(line_header, "vn") == 0)
 		{
 			// vertex normal
 			glm::vec3 normal;
-			fscanf_s(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
+			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
 			temp_normals.push_back(normal);
 		}
 		else if (strcmp(line_header, "f") == 0)
 		{
 			// face
-			std::string vertex1, vertex2, vertex3;
 			unsigned int vertex_index[3], normal_index[3];
-			int matches = fscanf_s(file, "%d//%d %d//%d %d//%d\n", &vertex_index[0], &normal_index[0], &vertex_index[1], &normal_index[1], &vertex_index[2], &normal_index[2]);
+			int matches = fscanf(file, "%d//%d %d//%d %d//%d\n", &vertex_index[0], &normal_index[0], &vertex_index[1], &normal_index[1], &vertex_index[2], &normal_index[2]);
 			if (matches != 6) {
 				printf("file can't be read.\n");
+				fclose(file);
 				return false;
 			}
 			vertex_indices.push_back(vertex_index[0]);
@@ -83,6 +83,8 @@ bool model::load_model(const char * obj_path, const char * mtl_path)
 		}
 	}
 
+	fclose(file);
+
 	// process data
 	for (unsigned int i = 0; i < vertex_indices.size(); i++)
 	{
@@ -98,7 +100,7 @@ bool model::load_model(const char * obj_path, const char * mtl_path)
 	}
 
 	// read the mtl file
-	fopen_s(&file, mtl_path, "r");
+	file = fopen(mtl_path, "r");
 	color_index = -1;
 	if (file == NULL)
 	{
@@ -110,7 +112,7 @@ bool model::load_model(const char * obj_path, const char * mtl_path)
 		char line_header[128];
 
 		// read first word of line
-		int res = fscanf_s(file, "%s", line_header, 128);
+		int res = fscanf(file, "%127s", line_header);
 		if (res == EOF)
 		{
 			break;
@@ -122,10 +124,11 @@ bool model::load_model(const char * obj_path, const char * mtl_path)
 		else if (strcmp(line_header, "Kd") == 0)
 		{
 			glm::vec3 color;
-			fscanf_s(file, "%f %f %f", &color.x, &color.y, &color.z);
+			fscanf(file, "%f %f %f", &color.x, &color.y, &color.z);
 			temp_colors.push_back(color);
 		}
 	}
+	fclose(file);
 
 	// process data
 	for (unsigned int i = 0; i < color_indices.size(); i++)
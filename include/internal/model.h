@@ -4,10 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <cstdlib>
-#include <glad/glad.h>
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <GLFW/glfw3.h>
 class model
 {
 private:
@@ -0,0 +1,432 @@
+#ifndef NOISE_GRAPH_DEF
+#define NOISE_GRAPH_DEF
+
+#include <stdint.h>
+#include <cmath>
+#include <initializer_list>
+#include <utility>
+#include <internal/simplex_noise.h>
+
+/*
+	composable noise expressions for shaping terrain. every node is a small struct holding its parameters and
+	its inputs by value, and evaluating it calls operator()(x, y) of its inputs directly. the type of a graph is
+	the whole expression, so the compiler sees all of it and inlines it into one kernel per point: no virtual
+	calls and no buffers between the nodes, filling a map is one pass over the output.
+
+		auto hills = noise_fbm(noise_simplex(256, seed), 6);
+		auto peaks = noise_curve(noise_ridged(noise_simplex(128, seed + 1), 5), { { 0, 0 }, { 0.6, 0.2 }, { 1, 1 } });
+		auto land = noise_warp(noise_select(hills, peaks, noise_simplex(512, seed + 2), 0.2, 0.3), noise_fbm(noise_simplex(64, seed + 3), 3), 16);
+		noise_graph_block(land * 40.0 + 20.0, step, x0, x1, y0, y1, out, pitch);
+
+	coordinates are in points of the full size island, so every step and every tile samples the same graph.
+	sources and fractals give values in about [-1, 1] (ridged [0, 1]).
+*/
+
+#if defined(_MSC_VER)
+#define NOISE_INLINE __forceinline
+#elif defined(__GNUC__) || defined(__clang__)
+#define NOISE_INLINE inline __attribute__((always_inline))
+#else
+#define NOISE_INLINE inline
+#endif
+
+// most control points of a curve
+#define NOISE_CURVE_POINTS 8
+
+// base of every node, so the operators below only take noise expressions
+template <typename Derived>
+struct noise_node
+{
+	const Derived& self() const { return static_cast<const Derived&>(*this); }
+};
+
+// shift of octave i of the fractals, so the octaves don't all line up at the origin
+NOISE_INLINE double noise_octave_shift(int i)
+{
+	return i * 131.7;
+}
+
+/*
+	sources
+*/
+
+struct simplex_node : noise_node<simplex_node>
+{
+	double frequency;
+	uint32_t seed;
+
+	NOISE_INLINE double operator()(double x, double y) const { return simplex_noise((float)(x * frequency), (float)(y * frequency), seed); }
+};
+
+// simplex noise with features about period points apart
+inline simplex_node noise_simplex(double period, uint32_t seed)
+{
+	simplex_node n;
+	n.frequency = 1 / period;
+	n.seed = seed;
+	return n;
+}
+
+struct constant_node : noise_node<constant_node>
+{
+	double value;
+
+	NOISE_INLINE double operator()(double, double) const { return value; }
+};
+
+inline constant_node noise_constant(double value)
+{
+	constant_node n;
+	n.value = value;
+	return n;
+}
+
+// distance from point x, y, to shape islands and craters with
+struct distance_node : noise_node<distance_node>
+{
+	double x;
+	double y;
+
+	NOISE_INLINE double operator()(double px, double py) const { return sqrt((px - x) * (px - x) + (py - y) * (py - y)); }
+};
+
+inline distance_node noise_distance(double x, double y)
+{
+	distance_node n;
+	n.x = x;
+	n.y = y;
+	return n;
+}
+
+/*
+	fractals: octaves of the source, every one lacunarity times finer and gain times weaker than the one
+	before, divided by the sum of the weights so they stay in the range of the source
+*/
+
+template <typename E>
+struct fbm_node : noise_node<fbm_node<E>>
+{
+	E source;
+	int octaves;
+	double lacunarity;
+	double gain;
+	double scale;
+
+	NOISE_INLINE double operator()(double x, double y) const
+	{
+		double sum = 0;
+		double frequency = 1;
+		double amplitude = 1;
+		for (int i = 0; i < octaves; i++)
+		{
+			sum += source(x * frequency + noise_octave_shift(i), y * frequency - noise_octave_shift(i)) * amplitude;
+			frequency *= lacunarity;
+			amplitude *= gain;
+		}
+		return sum * scale;
+	}
+};
+
+// sum of the weights of the octaves, 1 / what the fractals scale by
+inline double noise_octave_weights(int octaves, double gain)
+{
+	double sum = 0;
+	double amplitude = 1;
+	for (int i = 0; i < octaves; i++)
+	{
+		sum += amplitude;
+		amplitude *= gain;
+	}
+	return sum > 0 ? sum : 1;
+}
+
+template <typename E>
+fbm_node<E> noise_fbm(const noise_node<E>& source, int octaves, double lacunarity = 2, double gain = 0.5)
+{
+	fbm_node<E> n;
+	n.source = source.self();
+	n.octaves = octaves;
+	n.lacunarity = lacunarity;
+	n.gain = gain;
+	n.scale = 1 / noise_octave_weights(octaves, gain);
+	return n;
+}
+
+// sharp crests where the source crosses 0, in [0, 1]. every octave is weighed by the one before it
+// (Musgrave's ridged multifractal), so the fine detail gathers on the ridges and the valleys stay smooth
+template <typename E>
+struct ridged_node : noise_node<ridged_node<E>>
+{
+	E source;
+	int octaves;
+	double lacunarity;
+	double gain;
+	double scale;
+
+	NOISE_INLINE double operator()(double x, double y) const
+	{
+		double sum = 0;
+		double frequency = 1;
+		double amplitude = 1;
+		double weight = 1;
+		for (int i = 0; i < octaves; i++)
+		{
+			double v = 1 - fabs(source(x * frequency + noise_octave_shift(i), y * frequency - noise_octave_shift(i)));
+			v = v * v * weight;
+			weight = v * 2 > 1 ? 1 : v * 2;
+			sum += v * amplitude;
+			frequency *= lacunarity;
+			amplitude *= gain;
+		}
+		return sum * scale;
+	}
+};
+
+template <typename E>
+ridged_node<E> noise_ridged(const noise_node<E>& source, int octaves, double lacunarity = 2, double gain = 0.5)
+{
+	ridged_node<E> n;
+	n.source = source.self();
+	n.octaves = octaves;
+	n.lacunarity = lacunarity;
+	n.gain = gain;
+	n.scale = 1 / noise_octave_weights(octaves, gain);
+	return n;
+}
+
+// rounded hills with creases in between, the absolute value of every octave
+template <typename E>
+struct billow_node : noise_node<billow_node<E>>
+{
+	E source;
+	int octaves;
+	double lacunarity;
+	double gain;
+	double scale;
+
+	NOISE_INLINE double operator()(double x, double y) const
+	{
+		double sum = 0;
+		double frequency = 1;
+		double amplitude = 1;
+		for (int i = 0; i < octaves; i++)
+		{
+			sum += (2 * fabs(source(x * frequency + noise_octave_shift(i), y * frequency - noise_octave_shift(i))) - 1) * amplitude;
+			frequency *= lacunarity;
+			amplitude *= gain;
+		}
+		return sum * scale;
+	}
+};
+
+template <typename E>
+billow_node<E> noise_billow(const noise_node<E>& source, int octaves, double lacunarity = 2, double gain = 0.5)
+{
+	billow_node<E> n;
+	n.source = source.self();
+	n.octaves = octaves;
+	n.lacunarity = lacunarity;
+	n.gain = gain;
+	n.scale = 1 / noise_octave_weights(octaves, gain);
+	return n;
+}
+
+/*
+	domain warp: the source sampled strength points away, in the direction given by the warp at two far apart
+	places of it, so it bends instead of just moving
+*/
+
+template <typename E, typename W>
+struct warp_node : noise_node<warp_node<E, W>>
+{
+	E source;
+	W warp;
+	double strength;
+
+	NOISE_INLINE double operator()(double x, double y) const
+	{
+		double dx = warp(x, y);
+		double dy = warp(x + 5203.1, y - 1307.7);
+		return source(x + dx * strength, y + dy * strength);
+	}
+};
+
+template <typename E, typename W>
+warp_node<E, W> noise_warp(const noise_node<E>& source, const noise_node<W>& warp, double strength)
+{
+	warp_node<E, W> n;
+	n.source = source.self();
+	n.warp = warp.self();
+	n.strength = strength;
+	return n;
+}
+
+/*
+	combining
+*/
+
+template <typename A, typename B>
+struct add_node : noise_node<add_node<A, B>>
+{
+	A a;
+	B b;
+
+	NOISE_INLINE double operator()(double x, double y) const { return a(x, y) + b(x, y); }
+};
+
+template <typename A, typename B>
+struct mul_node : noise_node<mul_node<A, B>>
+{
+	A a;
+	B b;
+
+	NOISE_INLINE double operator()(double x, double y) const { return a(x, y) * b(x, y); }
+};
+
+// source * scale + bias, what arithmetic with plain numbers turns into
+template <typename E>
+struct scale_bias_node : noise_node<scale_bias_node<E>>
+{
+	E source;
+	double scale;
+	double bias;
+
+	NOISE_INLINE double operator()(double x, double y) const { return source(x, y) * scale + bias; }
+};
+
+template <typename A, typename B>
+add_node<A, B> operator+(const noise_node<A>& a, const noise_node<B>& b)
+{
+	add_node<A, B> n;
+	n.a = a.self();
+	n.b = b.self();
+	return n;
+}
+
+template <typename A, typename B>
+mul_node<A, B> operator*(const noise_node<A>& a, const noise_node<B>& b)
+{
+	mul_node<A, B> n;
+	n.a = a.self();
+	n.b = b.self();
+	return n;
+}
+
+template <typename E>
+scale_bias_node<E> noise_scale_bias(const noise_node<E>& source, double scale, double bias)
+{
+	scale_bias_node<E> n;
+	n.source = source.self();
+	n.scale = scale;
+	n.bias = bias;
+	return n;
+}
+
+template <typename E>
+scale_bias_node<E> operator*(const noise_node<E>& source, double scale) { return noise_scale_bias(source, scale, 0.0); }
+template <typename E>
+scale_bias_node<E> operator*(double scale, const noise_node<E>& source) { return noise_scale_bias(source, scale, 0.0); }
+template <typename E>
+scale_bias_node<E> operator+(const noise_node<E>& source, double bias) { return noise_scale_bias(source, 1.0, bias); }
+template <typename E>
+scale_bias_node<E> operator+(double bias, const noise_node<E>& source) { return noise_scale_bias(source, 1.0, bias); }
+template <typename E>
+scale_bias_node<E> operator-(const noise_node<E>& source, double bias) { return noise_scale_bias(source, 1.0, -bias); }
+
+// a where control is below threshold, b above it, blended smoothly over falloff around the threshold
+template <typename A, typename B, typename C>
+struct select_node : noise_node<select_node<A, B, C>>
+{
+	A a;
+	B b;
+	C control;
+	double threshold;
+	double falloff;
+
+	NOISE_INLINE double operator()(double x, double y) const
+	{
+		double c = control(x, y);
+		if (c <= threshold - falloff / 2) return a(x, y);
+		if (c >= threshold + falloff / 2) return b(x, y);
+
+		double t = (c - (threshold - falloff / 2)) / falloff;
+		t = t * t * (3 - 2 * t);
+		double va = a(x, y);
+		return va + (b(x, y) - va) * t;
+	}
+};
+
+template <typename A, typename B, typename C>
+select_node<A, B, C> noise_select(const noise_node<A>& a, const noise_node<B>& b, const noise_node<C>& control, double threshold, double falloff = 0)
+{
+	select_node<A, B, C> n;
+	n.a = a.self();
+	n.b = b.self();
+	n.control = control.self();
+	n.threshold = threshold;
+	n.falloff = falloff;
+	return n;
+}
+
+// the source remapped through a smooth curve (Catmull-Rom) through control points with increasing x,
+// flat past the first and the last one
+template <typename E>
+struct curve_node : noise_node<curve_node<E>>
+{
+	E source;
+	int count;
+	double x[NOISE_CURVE_POINTS];
+	double y[NOISE_CURVE_POINTS];
+
+	NOISE_INLINE double operator()(double px, double py) const
+	{
+		double v = source(px, py);
+		if (v <= x[0]) return y[0];
+		if (v >= x[count - 1]) return y[count - 1];
+
+		int i = 0;
+		while (v > x[i + 1])
+			i++;
+		double t = (v - x[i]) / (x[i + 1] - x[i]);
+
+		// neighbours past the ends are the end points themselves
+		double y0 = y[i > 0 ? i - 1 : 0];
+		double y1 = y[i];
+		double y2 = y[i + 1];
+		double y3 = y[i + 2 < count ? i + 2 : count - 1];
+		return 0.5 * ((2 * y1) + (-y0 + y2) * t + (2 * y0 - 5 * y1 + 4 * y2 - y3) * t * t + (-y0 + 3 * y1 - 3 * y2 + y3) * t * t * t);
+	}
+};
+
+// at least one point, the ones past NOISE_CURVE_POINTS are left out
+template <typename E>
+curve_node<E> noise_curve(const noise_node<E>& source, std::initializer_list<std::pair<double, double>> points)
+{
+	curve_node<E> n;
+	n.source = source.self();
+	n.count = 0;
+	for (const std::pair<double, double>& p : points)
+	{
+		if (n.count == NOISE_CURVE_POINTS) break;
+		n.x[n.count] = p.first;
+		n.y[n.count] = p.second;
+		n.count++;
+	}
+	return n;
+}
+
+// add the graph at points (x * step, y * step) onto a block of the map, out[(x - x0) * pitch + (y - y0)] for
+// x0 <= x < x1, y0 <= y < y1, like simplex_fbm_block
+template <typename E>
+void noise_graph_block(const noise_node<E>& graph, int step, int x0, int x1, int y0, int y1, double* out, int pitch)
+{
+	const E g = graph.self();
+	for (int x = x0; x < x1; x++)
+	{
+		double* row = out + (size_t)(x - x0) * pitch;
+		for (int y = y0; y < y1; y++)
+			row[y - y0] += g((double)x * step, (double)y * step);
+	}
+}
+
+#endif // !NOISE_GRAPH_DEF
@@ -0,0 +1,206 @@
+#include <internal/scatter.h>
+#include <internal/terrain_random.h>
+#include <algorithm>
+#include <cmath>
+
+std::vector<scatter_species> default_scatter_species()
+{
+	std::vector<scatter_species> species(2);
+
+	scatter_species& tree = species[0];
+	tree.density = 1.0 / 200;
+	tree.spacing = 10;
+	tree.footprint = 2;
+	tree.min_height = BEACH_HEIGHT;
+	tree.max_height = INFINITY;
+	tree.max_slope = 1;
+	tree.biomes = BIOME_GRASS | BIOME_SHORE;
+	tree.min_scale = 0.8;
+	tree.max_scale = 1.2;
+
+	scatter_species& bush = species[1];
+	bush.density = 1.0 / 100;
+	bush.spacing = 4;
+	bush.footprint = 1;
+	bush.min_height = 0.5;
+	bush.max_height = INFINITY;
+	bush.max_slope = 1.5;
+	bush.biomes = BIOME_BEACH | BIOME_GRASS | BIOME_SHORE;
+	bush.min_scale = 0.3;
+	bush.max_scale = 0.5;
+
+	return species;
+}
+
+// the ground at a position of the map, in units from its first point
+struct scatter_ground
+{
+	double height;
+	double slope;
+	int biome;
+};
+
+// false where there is water, or off the map
+static bool ground_at(const heightfield<double>& map, int step, const hydrology_map& hydrology, double water_level, double x, double z, scatter_ground& ground)
+{
+	int points_x = map.size_x();
+	int points_z = map.size_y();
+	if (x < 0 || z < 0 || x > (double)(points_x - 1) * step || z > (double)(points_z - 1) * step)
+		return false;
+
+	int nx = (int)(x / step + 0.5);
+	int nz = (int)(z / step + 0.5);
+	if (hydrology.water[nx][nz] != WATER_NONE)
+		return false;
+
+	// bilinear height in the cell, and the slope of the cell there
+	int i = std::min((int)(x / step), points_x - 2);
+	int j = std::min((int)(z / step), points_z - 2);
+	double fx = x / step - i;
+	double fz = z / step - j;
+	double h00 = map[i][j], h10 = map[i + 1][j], h01 = map[i][j + 1], h11 = map[i + 1][j + 1];
+	double dx = ((h10 - h00) * (1 - fz) + (h11 - h01) * fz) / step;
+	double dz = ((h01 - h00) * (1 - fx) + (h11 - h10) * fx) / step;
+	ground.height = (h00 * (1 - fx) + h10 * fx) * (1 - fz) + (h01 * (1 - fx) + h11 * fx) * fz;
+	ground.slope = sqrt(dx * dx + dz * dz);
+
+	ground.biome = is_beach(hydrology.coast[nx][nz], ground.height - water_level) ? BIOME_BEACH : BIOME_GRASS;
+	for (int a = std::max(nx - 1, 0); a <= std::min(nx + 1, points_x - 1); a++)
+	{
+		for (int b = std::max(nz - 1, 0); b <= std::min(nz + 1, points_z - 1); b++)
+		{
+			int water = hydrology.water[a][b];
+			if (water == WATER_LAKE || water == WATER_RIVER)
+				ground.biome = BIOME_SHORE;
+		}
+	}
+	return true;
+}
+
+bool scatter_instances(const heightfield<double>& map, int step, const hydrology_map& hydrology, double water_level, const std::vector<scatter_species>& species,
+	uint64_t seed, std::vector<scatter_instance>& instances, const cancel_token& cancel, thread_pool& pool)
+{
+	instances.clear();
+	int points_x = map.size_x();
+	int points_z = map.size_y();
+	if (points_x < 2 || points_z < 2)
+		return true;
+
+	// tiles per side, rounded up to even so the colors tile, and cells per side
+	const int tile = SCATTER_TILE_SIZE;
+	const int cell = SCATTER_CELL_SIZE;
+	const int tile_cells = tile / cell;
+	int tiles_x = ((points_x - 1) * step + tile - 1) / tile + 1;
+	int tiles_z = ((points_z - 1) * step + tile - 1) / tile + 1;
+	tiles_x += tiles_x % 2;
+	tiles_z += tiles_z % 2;
+	int cells_x = tiles_x * tile_cells;
+	int cells_z = tiles_z * tile_cells;
+
+	/*
+		the instances of every tile, positioned in map units while scattering, and the grid: the first instance
+		of every cell, and for every instance the next one in its cell, both indices into the instances of the
+		tile the cell is in
+	*/
+	std::vector<std::vector<scatter_instance>> tile_instances((size_t)tiles_x * tiles_z);
+	std::vector<std::vector<int32_t>> tile_next((size_t)tiles_x * tiles_z);
+	std::vector<int32_t> cell_first((size_t)cells_x * cells_z, -1);
+
+	double max_footprint = 0;
+	for (size_t s = 0; s < species.size(); s++)
+		max_footprint = std::max(max_footprint, species[s].footprint);
+
+	for (int s = 0; s < (int)species.size(); s++)
+	{
+		const scatter_species& sp = species[s];
+		double reach = std::min(std::max(sp.spacing, sp.footprint + max_footprint), (double)tile);
+		double darts = sp.density * tile * tile;
+
+		for (int color = 0; color < 4 && !cancel.cancelled(); color++)
+		{
+			int count_x = tiles_x / 2;
+			int count_z = tiles_z / 2;
+
+			pool.parallel_for(count_x * count_z, [&](int t)
+			{
+				int tx = (t / count_z) * 2 + color / 2;
+				int tz = (t % count_z) * 2 + color % 2;
+				int key = tx * tiles_z + tz;
+				std::vector<scatter_instance>& own = tile_instances[key];
+				std::vector<int32_t>& own_next = tile_next[key];
+
+				// the fraction of a dart left over is thrown or not at random
+				int count = (int)darts + (random_double(seed, RANDOM_STREAM_SCATTER_X, key, -1 - s) < darts - floor(darts));
+				for (int d = 0; d < count; d++)
+				{
+					int32_t dart = (int32_t)((uint32_t)s << 20 | (uint32_t)d);
+					double x = (tx + random_double(seed, RANDOM_STREAM_SCATTER_X, key, dart)) * tile;
+					double z = (tz + random_double(seed, RANDOM_STREAM_SCATTER_Z, key, dart)) * tile;
+
+					scatter_ground ground;
+					if (!ground_at(map, step, hydrology, water_level, x, z, ground))
+						continue;
+					double height = ground.height - water_level;
+					if (height < sp.min_height || height > sp.max_height || ground.slope > sp.max_slope || !(ground.biome & sp.biomes))
+						continue;
+
+					// nothing too close in the cells within reach
+					bool clear = true;
+					int cx0 = std::max((int)((x - reach) / cell), 0);
+					int cx1 = std::min((int)((x + reach) / cell), cells_x - 1);
+					int cz0 = std::max((int)((z - reach) / cell), 0);
+					int cz1 = std::min((int)((z + reach) / cell), cells_z - 1);
+					for (int cx = cx0; cx <= cx1 && clear; cx++)
+					{
+						for (int cz = cz0; cz <= cz1 && clear; cz++)
+						{
+							int owner = (cx / tile_cells) * tiles_z + cz / tile_cells;
+							const std::vector<scatter_instance>& other = tile_instances[owner];
+							for (int32_t o = cell_first[(size_t)cx * cells_z + cz]; o >= 0; o = tile_next[owner][o])
+							{
+								double need = other[o].species == s ? sp.spacing : sp.footprint + species[other[o].species].footprint;
+								double ox = other[o].position.x - x;
+								double oz = other[o].position.z - z;
+								if (ox * ox + oz * oz < need * need)
+								{
+									clear = false;
+									break;
+								}
+							}
+						}
+					}
+					if (!clear)
+						continue;
+
+					scatter_instance instance;
+					instance.position = glm::vec3((float)x, (float)ground.height, (float)z);
+					instance.scale = (float)(sp.min_scale + (sp.max_scale - sp.min_scale) * random_double(seed, RANDOM_STREAM_SCATTER_SCALE, key, dart));
+					instance.rotation = (uint16_t)(random_hash(seed, RANDOM_STREAM_SCATTER_ROTATION, key, dart) >> 48);
+					instance.species = (uint16_t)s;
+
+					size_t c = (size_t)(int)(x / cell) * cells_z + (int)(z / cell);
+					own_next.push_back(cell_first[c]);
+					cell_first[c] = (int32_t)own.size();
+					own.push_back(instance);
+				}
+			});
+		}
+	}
+	if (cancel.cancelled())
+		return false;
+
+	// into world coordinates, centered like the terrain
+	float half_x = (float)(points_x * step / 2);
+	float half_z = (float)(points_z * step / 2);
+	for (size_t t = 0; t < tile_instances.size(); t++)
+	{
+		for (size_t i = 0; i < tile_instances[t].size(); i++)
+		{
+			scatter_instance instance = tile_instances[t][i];
+			instance.position.x -= half_x;
+			instance.position.z -= half_z;
+			instances.push_back(instance);
+		}
+	}
+	return true;
+}
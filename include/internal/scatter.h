@@ -0,0 +1,78 @@
+#ifndef SCATTER_DEF
+#define SCATTER_DEF
+
+#include <stdint.h>
+#include <vector>
+#include <internal/heightfield.h>
+#include <internal/hydrology.h>
+#include <internal/thread_pool.h>
+#include <internal/task_graph.h>
+#include <glm/glm.hpp>
+
+/*
+	vegetation and other things scattered over the island with Poisson-disk (blue noise) sampling: darts are
+	thrown at random, and one is only kept if the ground suits its species and nothing else is too close to it.
+	what is close is found in a uniform grid of cells over the island, every cell holding the instances in it.
+*/
+
+// side length, in world units, of the square tiles darts are thrown in, colored like a 2 x 2 checkerboard.
+// the tiles of one color are run in parallel, so no spacing or footprint can reach further than this
+#define SCATTER_TILE_SIZE 64
+
+// side length of the cells of the grid, which divides the tiles
+#define SCATTER_CELL_SIZE 4
+
+// where an instance can grow, species take any combination of these
+enum scatter_biome
+{
+	// sand within reach of the sea, like the colors of the terrain
+	BIOME_BEACH = 1,
+	BIOME_GRASS = 2,
+
+	// next to a lake or a river
+	BIOME_SHORE = 4
+};
+
+struct scatter_species
+{
+	// darts thrown per square unit. the spacing and the rules keep fewer of them
+	double density;
+
+	// least distance to another instance of the same species, and the radius every other species keeps clear of
+	double spacing;
+	double footprint;
+
+	// height above the water level and slope (height per unit of distance) it grows at, and the biomes it grows in
+	double min_height;
+	double max_height;
+	double max_slope;
+	int biomes;
+
+	double min_scale;
+	double max_scale;
+};
+
+// trees, then bushes in the gaps between them
+std::vector<scatter_species> default_scatter_species();
+
+struct scatter_instance
+{
+	// in world coordinates, like the terrain mesh, on the ground
+	glm::vec3 position;
+	float scale;
+
+	// around the vertical axis, in 1 / 65536 of a turn
+	uint16_t rotation;
+	uint16_t species;
+};
+
+/*
+	scatter the species over a map with points step apart, in the order they are given. every species goes over
+	the tiles one color at a time, and a tile throws its darts in the same order every time, from random numbers
+	keyed on the tile and the dart, so the instances don't depend on the number of threads.
+	instances are returned tile by tile. returns false if cancelled
+*/
+bool scatter_instances(const heightfield<double>& map, int step, const hydrology_map& hydrology, double water_level, const std::vector<scatter_species>& species,
+	uint64_t seed, std::vector<scatter_instance>& instances, const cancel_token& cancel, thread_pool& pool);
+
+#endif // !SCATTER_DEF
@@ -0,0 +1,63 @@
+#include <internal/simd.h>
+#include <atomic>
+
+static std::atomic<int> simd_cap(SIMD_AVX2);
+
+static simd_level simd_cpu_level()
+{
+#ifdef SIMD_X86
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int max_leaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	// the OS has to save the ymm registers on context switches too
+	bool ymm_enabled = osxsave && avx && (_xgetbv(0) & 6) == 6;
+
+	bool avx2 = false;
+	if (max_leaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	if (avx2 && ymm_enabled) return SIMD_AVX2;
+	if (sse2) return SIMD_SSE2;
+	return SIMD_SCALAR;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+	return SIMD_SCALAR;
+#endif
+#else
+	return SIMD_SCALAR;
+#endif
+}
+
+simd_level simd_detect()
+{
+	static const simd_level cpu_level = simd_cpu_level();
+	int cap = simd_cap.load();
+	return cpu_level < cap ? cpu_level : (simd_level)cap;
+}
+
+void simd_limit(simd_level level)
+{
+	simd_cap.store(level);
+}
+
+const char* simd_level_name(simd_level level)
+{
+	switch (level)
+	{
+	case SIMD_AVX2: return "avx2";
+	case SIMD_SSE2: return "sse2";
+	default: return "scalar";
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef SIMD_DEF
+#define SIMD_DEF
+
+/*
+	runtime selection of SIMD code paths. kernels are written once per instruction set and the best one
+	the CPU supports is picked when they are first used, so one build runs everywhere.
+	kernels must do the same operations in the same order on every path (no FMA), so the output of
+	terrain generation doesn't depend on the machine it ran on.
+*/
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#endif
+
+#ifdef SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// gcc and clang need functions using instructions above the compiler's baseline marked, msvc allows them anywhere
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_SSE2
+#define SIMD_TARGET_AVX2
+#endif
+
+enum simd_level
+{
+	SIMD_SCALAR = 0,
+	SIMD_SSE2 = 1,
+	SIMD_AVX2 = 2
+};
+
+// best instruction set supported by both the CPU and the OS, capped by simd_limit()
+simd_level simd_detect();
+
+// don't use anything above level, used to compare the paths against each other
+void simd_limit(simd_level level);
+
+const char* simd_level_name(simd_level level);
+
+#endif // !SIMD_DEF
@@ -0,0 +1,430 @@
+#include <internal/simplex_noise.h>
+#include <cmath>
+#include <vector>
+
+/*
+	every path below does the same float operations in the same order, so the scalar, SSE2 and AVX2
+	versions give the same bits for the same input.
+*/
+
+// skewing factors between the square and the simplex (triangle) grid: (sqrt(3) - 1) / 2 and (3 - sqrt(3)) / 6
+static const float F2 = 0.366025403f;
+static const float G2 = 0.211324865f;
+static const float G2_2_MINUS_1 = 2.0f * 0.211324865f - 1.0f;
+
+// brings the sum of the three corners to about [-1, 1]
+static const float NOISE_SCALE = 45.23065f;
+
+static const uint32_t HASH_X = 0x8da6b343u;
+static const uint32_t HASH_Y = 0xd8163841u;
+static const uint32_t HASH_SEED = 0xcb1ab31fu;
+static const uint32_t HASH_MIX = 0x5bd1e995u;
+
+// per octave constants, shared by all paths
+struct fbm_octaves
+{
+	int count;
+	float inv_period[FBM_MAX_OCTAVES];
+	float amplitude[FBM_MAX_OCTAVES];
+	uint32_t seed[FBM_MAX_OCTAVES];
+};
+
+static void build_octaves(const fbm_settings& settings, fbm_octaves& o)
+{
+	o.count = settings.octaves < FBM_MAX_OCTAVES ? settings.octaves : FBM_MAX_OCTAVES;
+
+	double period = settings.period;
+	double amplitude = settings.amplitude;
+	for (int i = 0; i < o.count; i++)
+	{
+		o.inv_period[i] = (float)(1.0 / period);
+		o.amplitude[i] = (float)amplitude;
+		o.seed[i] = (settings.seed + i * 0x9e3779b9u) * HASH_SEED;
+		period *= settings.period_scale;
+		amplitude *= settings.amplitude_scale;
+	}
+}
+
+/*
+	scalar path
+*/
+
+static inline uint32_t hash_scalar(int32_t i, int32_t j, uint32_t seed_mix)
+{
+	uint32_t h = (uint32_t)i * HASH_X + (uint32_t)j * HASH_Y + seed_mix;
+	h ^= h >> 13;
+	h *= HASH_MIX;
+	h ^= h >> 15;
+	return h;
+}
+
+static inline float corner_scalar(float x, float y, uint32_t h)
+{
+	float t = (0.5f - x * x) - y * y;
+	if (t < 0.0f) t = 0.0f;
+
+	// one of 8 gradients
+	bool low = (h & 4) == 0;
+	float u = low ? x : y;
+	float v = low ? y : x;
+	if (h & 1) u = -u;
+	v = 2.0f * v;
+	if (h & 2) v = -v;
+
+	t = t * t;
+	return t * t * (u + v);
+}
+
+static inline float simplex_scalar(float x, float y, uint32_t seed_mix)
+{
+	float s = (x + y) * F2;
+	float fi = floorf(x + s);
+	float fj = floorf(y + s);
+	float t = (fi + fj) * G2;
+	float x0 = x - (fi - t);
+	float y0 = y - (fj - t);
+
+	// which triangle of the skewed cell the point is in
+	bool upper = x0 > y0;
+	float i1 = upper ? 1.0f : 0.0f;
+	float j1 = upper ? 0.0f : 1.0f;
+
+	float x1 = (x0 - i1) + G2;
+	float y1 = (y0 - j1) + G2;
+	float x2 = x0 + G2_2_MINUS_1;
+	float y2 = y0 + G2_2_MINUS_1;
+
+	int32_t ii = (int32_t)fi;
+	int32_t jj = (int32_t)fj;
+	float n0 = corner_scalar(x0, y0, hash_scalar(ii, jj, seed_mix));
+	float n1 = corner_scalar(x1, y1, hash_scalar(ii + (upper ? 1 : 0), jj + (upper ? 0 : 1), seed_mix));
+	float n2 = corner_scalar(x2, y2, hash_scalar(ii + 1, jj + 1, seed_mix));
+
+	return NOISE_SCALE * ((n0 + n1) + n2);
+}
+
+static void fbm_scalar(const fbm_octaves& o, const float* x, const float* y, int i, int count, float* out)
+{
+	for (; i < count; i++)
+	{
+		float sum = 0.0f;
+		for (int k = 0; k < o.count; k++)
+		{
+			float n = simplex_scalar(x[i] * o.inv_period[k], y[i] * o.inv_period[k], o.seed[k]);
+			sum = sum + ((n + 1.0f) * 0.5f) * o.amplitude[k];
+		}
+		out[i] = sum;
+	}
+}
+
+float simplex_noise(float x, float y, uint32_t seed)
+{
+	return simplex_scalar(x, y, seed * HASH_SEED);
+}
+
+/*
+	3D version, scalar only: skewing factors 1 / 3 and 1 / 6, the 12 gradients pointing to the edges of a cube
+*/
+
+static const float F3 = 1.0f / 3.0f;
+static const float G3 = 1.0f / 6.0f;
+static const uint32_t HASH_Z = 0x9e3779b1u;
+
+// brings the sum of the four corners to about [-1, 1]
+static const float NOISE_SCALE_3D = 32.0f;
+
+static inline float corner3_scalar(float x, float y, float z, uint32_t h)
+{
+	float t = ((0.6f - x * x) - y * y) - z * z;
+	if (t < 0.0f) return 0.0f;
+
+	// one of 12 gradients, two of the axes with a sign each
+	int g = (int)(h % 12);
+	float u = g < 8 ? x : y;
+	float v = g < 4 ? y : z;
+	if (g & 1) u = -u;
+	if (g & 2) v = -v;
+
+	t = t * t;
+	return t * t * (u + v);
+}
+
+float simplex_noise3(float x, float y, float z, uint32_t seed)
+{
+	uint32_t seed_mix = seed * HASH_SEED;
+
+	float s = ((x + y) + z) * F3;
+	float fi = floorf(x + s);
+	float fj = floorf(y + s);
+	float fk = floorf(z + s);
+	float t = ((fi + fj) + fk) * G3;
+	float x0 = x - (fi - t);
+	float y0 = y - (fj - t);
+	float z0 = z - (fk - t);
+
+	// which of the 6 tetrahedra of the skewed cube the point is in
+	int i1, j1, k1, i2, j2, k2;
+	if (x0 >= y0)
+	{
+		if (y0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+		else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+		else { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+	}
+	else
+	{
+		if (y0 < z0) { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+		else if (x0 < z0) { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+		else { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+	}
+
+	int32_t ii = (int32_t)fi;
+	int32_t jj = (int32_t)fj;
+	int32_t kk = (int32_t)fk;
+	float n = 0.0f;
+	for (int c = 0; c < 4; c++)
+	{
+		int di = c == 0 ? 0 : (c == 1 ? i1 : (c == 2 ? i2 : 1));
+		int dj = c == 0 ? 0 : (c == 1 ? j1 : (c == 2 ? j2 : 1));
+		int dk = c == 0 ? 0 : (c == 1 ? k1 : (c == 2 ? k2 : 1));
+		float offset = c * G3;
+		uint32_t h = hash_scalar(ii + di, jj + dj, seed_mix + (uint32_t)(kk + dk) * HASH_Z);
+		n = n + corner3_scalar((x0 - di) + offset, (y0 - dj) + offset, (z0 - dk) + offset, h);
+	}
+	return NOISE_SCALE_3D * n;
+}
+
+#ifdef SIMD_X86
+
+/*
+	SSE2 path, 4 points at a time
+*/
+
+SIMD_TARGET_SSE2 static inline __m128i mullo_sse2(__m128i a, __m128i b)
+{
+	// SSE2 only multiplies the even lanes, so do the odd ones separately and put them back together
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+SIMD_TARGET_SSE2 static inline __m128i hash_sse2(__m128i i, __m128i j, __m128i seed_mix)
+{
+	__m128i h = _mm_add_epi32(_mm_add_epi32(mullo_sse2(i, _mm_set1_epi32((int)HASH_X)), mullo_sse2(j, _mm_set1_epi32((int)HASH_Y))), seed_mix);
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+	h = mullo_sse2(h, _mm_set1_epi32((int)HASH_MIX));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+	return h;
+}
+
+SIMD_TARGET_SSE2 static inline __m128 select_sse2(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+SIMD_TARGET_SSE2 static inline __m128 floor_sse2(__m128 x)
+{
+	__m128 f = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+	return _mm_sub_ps(f, _mm_and_ps(_mm_cmpgt_ps(f, x), _mm_set1_ps(1.0f)));
+}
+
+SIMD_TARGET_SSE2 static inline __m128 corner_sse2(__m128 x, __m128 y, __m128i h)
+{
+	__m128 t = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y));
+	t = _mm_max_ps(t, _mm_setzero_ps());
+
+	__m128 low = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(4)), _mm_setzero_si128()));
+	__m128 u = select_sse2(low, x, y);
+	__m128 v = select_sse2(low, y, x);
+	u = _mm_xor_ps(u, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31)));
+	v = _mm_mul_ps(_mm_set1_ps(2.0f), v);
+	v = _mm_xor_ps(v, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30)));
+
+	t = _mm_mul_ps(t, t);
+	return _mm_mul_ps(_mm_mul_ps(t, t), _mm_add_ps(u, v));
+}
+
+SIMD_TARGET_SSE2 static inline __m128 simplex_sse2(__m128 x, __m128 y, __m128i seed_mix)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128 s = _mm_mul_ps(_mm_add_ps(x, y), _mm_set1_ps(F2));
+	__m128 fi = floor_sse2(_mm_add_ps(x, s));
+	__m128 fj = floor_sse2(_mm_add_ps(y, s));
+	__m128 t = _mm_mul_ps(_mm_add_ps(fi, fj), _mm_set1_ps(G2));
+	__m128 x0 = _mm_sub_ps(x, _mm_sub_ps(fi, t));
+	__m128 y0 = _mm_sub_ps(y, _mm_sub_ps(fj, t));
+
+	__m128 upper = _mm_cmpgt_ps(x0, y0);
+	__m128 i1 = _mm_and_ps(upper, one);
+	__m128 j1 = _mm_andnot_ps(upper, one);
+
+	__m128 x1 = _mm_add_ps(_mm_sub_ps(x0, i1), _mm_set1_ps(G2));
+	__m128 y1 = _mm_add_ps(_mm_sub_ps(y0, j1), _mm_set1_ps(G2));
+	__m128 x2 = _mm_add_ps(x0, _mm_set1_ps(G2_2_MINUS_1));
+	__m128 y2 = _mm_add_ps(y0, _mm_set1_ps(G2_2_MINUS_1));
+
+	__m128i ii = _mm_cvttps_epi32(fi);
+	__m128i jj = _mm_cvttps_epi32(fj);
+	__m128i one_i = _mm_set1_epi32(1);
+	__m128i i1i = _mm_and_si128(_mm_castps_si128(upper), one_i);
+	__m128i j1i = _mm_andnot_si128(_mm_castps_si128(upper), one_i);
+
+	__m128 n0 = corner_sse2(x0, y0, hash_sse2(ii, jj, seed_mix));
+	__m128 n1 = corner_sse2(x1, y1, hash_sse2(_mm_add_epi32(ii, i1i), _mm_add_epi32(jj, j1i), seed_mix));
+	__m128 n2 = corner_sse2(x2, y2, hash_sse2(_mm_add_epi32(ii, one_i), _mm_add_epi32(jj, one_i), seed_mix));
+
+	return _mm_mul_ps(_mm_set1_ps(NOISE_SCALE), _mm_add_ps(_mm_add_ps(n0, n1), n2));
+}
+
+SIMD_TARGET_SSE2 static void fbm_sse2(const fbm_octaves& o, const float* x, const float* y, int count, float* out)
+{
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i);
+		__m128 py = _mm_loadu_ps(y + i);
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < o.count; k++)
+		{
+			__m128 inv_period = _mm_set1_ps(o.inv_period[k]);
+			__m128 n = simplex_sse2(_mm_mul_ps(px, inv_period), _mm_mul_ps(py, inv_period), _mm_set1_epi32((int)o.seed[k]));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_mul_ps(_mm_add_ps(n, _mm_set1_ps(1.0f)), _mm_set1_ps(0.5f)), _mm_set1_ps(o.amplitude[k])));
+		}
+		_mm_storeu_ps(out + i, sum);
+	}
+	fbm_scalar(o, x, y, i, count, out);
+}
+
+/*
+	AVX2 path, 8 points at a time
+*/
+
+SIMD_TARGET_AVX2 static inline __m256i hash_avx2(__m256i i, __m256i j, __m256i seed_mix)
+{
+	__m256i h = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(i, _mm256_set1_epi32((int)HASH_X)), _mm256_mullo_epi32(j, _mm256_set1_epi32((int)HASH_Y))), seed_mix);
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+	h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)HASH_MIX));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+	return h;
+}
+
+SIMD_TARGET_AVX2 static inline __m256 corner_avx2(__m256 x, __m256 y, __m256i h)
+{
+	__m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+	t = _mm256_max_ps(t, _mm256_setzero_ps());
+
+	__m256 low = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(h, _mm256_set1_epi32(4)), _mm256_setzero_si256()));
+	__m256 u = _mm256_blendv_ps(y, x, low);
+	__m256 v = _mm256_blendv_ps(x, y, low);
+	u = _mm256_xor_ps(u, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31)));
+	v = _mm256_mul_ps(_mm256_set1_ps(2.0f), v);
+	v = _mm256_xor_ps(v, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30)));
+
+	t = _mm256_mul_ps(t, t);
+	return _mm256_mul_ps(_mm256_mul_ps(t, t), _mm256_add_ps(u, v));
+}
+
+SIMD_TARGET_AVX2 static inline __m256 simplex_avx2(__m256 x, __m256 y, __m256i seed_mix)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	__m256 s = _mm256_mul_ps(_mm256_add_ps(x, y), _mm256_set1_ps(F2));
+	__m256 fi = _mm256_floor_ps(_mm256_add_ps(x, s));
+	__m256 fj = _mm256_floor_ps(_mm256_add_ps(y, s));
+	__m256 t = _mm256_mul_ps(_mm256_add_ps(fi, fj), _mm256_set1_ps(G2));
+	__m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(fi, t));
+	__m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(fj, t));
+
+	__m256 upper = _mm256_cmp_ps(x0, y0, _CMP_GT_OQ);
+	__m256 i1 = _mm256_and_ps(upper, one);
+	__m256 j1 = _mm256_andnot_ps(upper, one);
+
+	__m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, i1), _mm256_set1_ps(G2));
+	__m256 y1 = _mm256_add_ps(_mm256_sub_ps(y0, j1), _mm256_set1_ps(G2));
+	__m256 x2 = _mm256_add_ps(x0, _mm256_set1_ps(G2_2_MINUS_1));
+	__m256 y2 = _mm256_add_ps(y0, _mm256_set1_ps(G2_2_MINUS_1));
+
+	__m256i ii = _mm256_cvttps_epi32(fi);
+	__m256i jj = _mm256_cvttps_epi32(fj);
+	__m256i one_i = _mm256_set1_epi32(1);
+	__m256i i1i = _mm256_and_si256(_mm256_castps_si256(upper), one_i);
+	__m256i j1i = _mm256_andnot_si256(_mm256_castps_si256(upper), one_i);
+
+	__m256 n0 = corner_avx2(x0, y0, hash_avx2(ii, jj, seed_mix));
+	__m256 n1 = corner_avx2(x1, y1, hash_avx2(_mm256_add_epi32(ii, i1i), _mm256_add_epi32(jj, j1i), seed_mix));
+	__m256 n2 = corner_avx2(x2, y2, hash_avx2(_mm256_add_epi32(ii, one_i), _mm256_add_epi32(jj, one_i), seed_mix));
+
+	return _mm256_mul_ps(_mm256_set1_ps(NOISE_SCALE), _mm256_add_ps(_mm256_add_ps(n0, n1), n2));
+}
+
+SIMD_TARGET_AVX2 static void fbm_avx2(const fbm_octaves& o, const float* x, const float* y, int count, float* out)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(x + i);
+		__m256 py = _mm256_loadu_ps(y + i);
+		__m256 sum = _mm256_setzero_ps();
+		for (int k = 0; k < o.count; k++)
+		{
+			__m256 inv_period = _mm256_set1_ps(o.inv_period[k]);
+			__m256 n = simplex_avx2(_mm256_mul_ps(px, inv_period), _mm256_mul_ps(py, inv_period), _mm256_set1_epi32((int)o.seed[k]));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(n, _mm256_set1_ps(1.0f)), _mm256_set1_ps(0.5f)), _mm256_set1_ps(o.amplitude[k])));
+		}
+		_mm256_storeu_ps(out + i, sum);
+	}
+	fbm_scalar(o, x, y, i, count, out);
+}
+
+#endif
+
+static void fbm_dispatch(const fbm_octaves& o, const float* x, const float* y, int count, float* out)
+{
+#ifdef SIMD_X86
+	switch (simd_detect())
+	{
+	case SIMD_AVX2:
+		fbm_avx2(o, x, y, count, out);
+		return;
+	case SIMD_SSE2:
+		fbm_sse2(o, x, y, count, out);
+		return;
+	default:
+		break;
+	}
+#endif
+	fbm_scalar(o, x, y, 0, count, out);
+}
+
+void simplex_fbm(const fbm_settings& settings, const float* x, const float* y, int count, float* out)
+{
+	fbm_octaves o;
+	build_octaves(settings, o);
+	fbm_dispatch(o, x, y, count, out);
+}
+
+void simplex_fbm_block(const fbm_settings& settings, int x0, int x1, int y0, int y1, double* out, int pitch)
+{
+	if (x1 <= x0 || y1 <= y0) return;
+
+	fbm_octaves o;
+	build_octaves(settings, o);
+
+	// one row of the block at a time
+	int width = y1 - y0;
+	std::vector<float> xs(width), ys(width), values(width);
+	for (int y = y0; y < y1; y++)
+		ys[y - y0] = (float)y;
+
+	for (int x = x0; x < x1; x++)
+	{
+		for (int i = 0; i < width; i++)
+			xs[i] = (float)x;
+
+		fbm_dispatch(o, &xs[0], &ys[0], width, &values[0]);
+
+		double* row = out + (size_t)(x - x0) * pitch;
+		for (int i = 0; i < width; i++)
+			row[i] += values[i];
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef SIMPLEX_NOISE_DEF
+#define SIMPLEX_NOISE_DEF
+
+#include <stdint.h>
+#include <internal/simd.h>
+
+/*
+	2D simplex noise (Gustavson's formulation, gradients as in SRombauts/SimplexNoise) summed into fractal
+	brownian motion. gradients are picked by hashing the lattice coordinates with a seed instead of a
+	permutation table, so it can be evaluated at any point, for any part of an unbounded map, and in SIMD
+	lanes without gathers: 8 points per instruction with AVX2, 4 with SSE2.
+*/
+
+#define FBM_MAX_OCTAVES 32
+
+struct fbm_settings
+{
+	uint32_t seed;
+	int octaves;
+
+	// octave 0 has lattice points period cells apart and values in [0, amplitude],
+	// every following octave multiplies them by period_scale and amplitude_scale
+	double period;
+	double amplitude;
+	double period_scale;
+	double amplitude_scale;
+};
+
+// single noise value in about [-1, 1]
+float simplex_noise(float x, float y, uint32_t seed);
+
+// 3D simplex noise in about [-1, 1], for density fields. scalar only
+float simplex_noise3(float x, float y, float z, uint32_t seed);
+
+// fbm at count points (x[i], y[i]) into out[i], evaluated a batch of SIMD lanes at a time
+void simplex_fbm(const fbm_settings& settings, const float* x, const float* y, int count, float* out);
+
+// add fbm onto a block of the map, out[(x - x0) * pitch + (y - y0)] for x0 <= x < x1, y0 <= y < y1
+void simplex_fbm_block(const fbm_settings& settings, int x0, int x1, int y0, int y1, double* out, int pitch);
+
+#endif // !SIMPLEX_NOISE_DEF
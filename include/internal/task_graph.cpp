@@ -0,0 +1,67 @@
+#include <internal/task_graph.h>
+#include <cassert>
+#include <chrono>
+
+int task_graph::add(const char* name, const std::function<void()>& job, std::initializer_list<int> dependencies)
+{
+	task t;
+	t.name = name;
+	t.job = job;
+	t.dependencies = dependencies;
+	t.seconds = 0;
+	t.done = false;
+
+	for (std::vector<int>::const_iterator d = t.dependencies.begin(); d != t.dependencies.end(); d++)
+		assert(*d >= 0 && *d < (int)tasks.size());
+
+	tasks.push_back(t);
+	return (int)tasks.size() - 1;
+}
+
+bool task_graph::run(thread_pool& pool, const cancel_token& cancel)
+{
+	for (std::vector<task>::iterator t = tasks.begin(); t != tasks.end(); t++)
+	{
+		t->seconds = 0;
+		t->done = false;
+	}
+
+	// run the graph in waves: everything whose dependencies are done runs together, then the next wave
+	// is picked. there is always at least one ready task, since dependencies only point backwards
+	int remaining = (int)tasks.size();
+	while (remaining > 0)
+	{
+		if (cancel.cancelled())
+			return false;
+
+		std::vector<int> ready;
+		for (int i = 0; i < (int)tasks.size(); i++)
+		{
+			if (tasks[i].done) continue;
+
+			bool dependencies_done = true;
+			for (std::vector<int>::const_iterator d = tasks[i].dependencies.begin(); d != tasks[i].dependencies.end(); d++)
+				dependencies_done = dependencies_done && tasks[*d].done;
+
+			if (dependencies_done)
+				ready.push_back(i);
+		}
+
+		pool.parallel_for((int)ready.size(), [&](int r)
+		{
+			task& t = tasks[ready[r]];
+			if (cancel.cancelled()) return;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			t.job();
+			t.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		});
+
+		for (std::vector<int>::const_iterator r = ready.begin(); r != ready.end(); r++)
+			tasks[*r].done = true;
+		remaining -= (int)ready.size();
+	}
+
+	// a task that was interrupted partway through still counts as run, so check the token once more
+	return !cancel.cancelled();
+}
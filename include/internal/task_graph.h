@@ -0,0 +1,61 @@
+#ifndef TASK_GRAPH_DEF
+#define TASK_GRAPH_DEF
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+#include <internal/thread_pool.h>
+
+// flag set by whoever started a job to ask it to stop early. jobs check it between pieces of work
+class cancel_token
+{
+public:
+	cancel_token() : flag(false) {}
+
+	cancel_token(const cancel_token&) = delete;
+	cancel_token& operator=(const cancel_token&) = delete;
+
+	void cancel() { flag.store(true); }
+	void reset() { flag.store(false); }
+	bool cancelled() const { return flag.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<bool> flag;
+};
+
+/*
+	small set of named tasks with dependencies between them. run() starts every task whose dependencies
+	are done, so independent tasks run at the same time on the pool, and records how long each one took.
+	a task can only depend on tasks added before it, so the graph can't have cycles.
+*/
+class task_graph
+{
+public:
+	// returns the id of the task, for use in the dependencies of later tasks
+	int add(const char* name, const std::function<void()>& job, std::initializer_list<int> dependencies = {});
+
+	// run all the tasks and wait for them. once cancel is set no more tasks are started,
+	// returns false if any task was skipped because of it
+	bool run(thread_pool& pool, const cancel_token& cancel);
+
+	int size() const { return (int)tasks.size(); }
+	const char* name(int task) const { return tasks[task].name; }
+
+	// wall time of a task in seconds, 0 if it didn't run
+	double time(int task) const { return tasks[task].seconds; }
+
+private:
+	struct task
+	{
+		const char* name;
+		std::function<void()> job;
+		std::vector<int> dependencies;
+		double seconds;
+		bool done;
+	};
+
+	std::vector<task> tasks;
+};
+
+#endif // !TASK_GRAPH_DEF
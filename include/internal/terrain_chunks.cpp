@@ -0,0 +1,234 @@
+#include <internal/terrain_chunks.h>
+#include <internal/simplex_noise.h>
+#include <internal/terrain_random.h>
+#include <internal/heightfield_query.h>
+#include <internal/compact_heightfield.h>
+#include <internal/hydrology.h>
+#include <internal/heightfield_ops.h>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+chunk_settings default_chunk_settings(uint64_t seed)
+{
+	chunk_settings settings;
+	settings.seed = seed;
+	settings.chunk_size = CHUNK_SIZE;
+	settings.octaves = 10;
+	settings.amplitude = 0.25;
+	settings.island_spacing = 1536;
+	settings.island_radius = 768;
+	settings.mask_height = 256;
+	settings.water_level = 96;
+	return settings;
+}
+
+// distance from world point x, z to the center of the nearest island
+static double island_distance(const chunk_settings& settings, double x, double z)
+{
+	int cell_x = (int)floor(x / settings.island_spacing);
+	int cell_z = (int)floor(z / settings.island_spacing);
+
+	// centers stay within a quarter of the spacing of their cell's center, so the nearest one is always
+	// in this cell or one next to it
+	double nearest = HUGE_VAL;
+	for (int i = cell_x - 1; i <= cell_x + 1; i++)
+	{
+		for (int j = cell_z - 1; j <= cell_z + 1; j++)
+		{
+			double center_x = (i + 0.25 + random_double(settings.seed, RANDOM_STREAM_ISLAND_X, i, j) * 0.5) * settings.island_spacing;
+			double center_z = (j + 0.25 + random_double(settings.seed, RANDOM_STREAM_ISLAND_Z, i, j) * 0.5) * settings.island_spacing;
+			nearest = std::min(nearest, (center_x - x) * (center_x - x) + (center_z - z) * (center_z - z));
+		}
+	}
+	return sqrt(nearest);
+}
+
+// heights of the n world points from x, z0 to x, z0 + n - 1
+static void world_heights(const chunk_settings& settings, int x, int z0, int n, float* out)
+{
+	fbm_settings fbm;
+	fbm.seed = (uint32_t)random_hash(settings.seed, RANDOM_STREAM_SIMPLEX, 0, 0);
+	fbm.octaves = std::min(settings.octaves, FBM_MAX_OCTAVES);
+	fbm.period = 1;
+	fbm.amplitude = settings.amplitude;
+	fbm.period_scale = 2;
+	fbm.amplitude_scale = 2;
+
+	double min_width = settings.island_radius / 4;
+	double max_width = settings.island_radius;
+
+	std::vector<double> row(n, 0.0);
+	simplex_fbm_block(fbm, x, x + 1, z0, z0 + n, &row[0], n);
+
+	for (int j = 0; j < n; j++)
+	{
+		double distance = island_distance(settings, x, z0 + j);
+		out[j] = (float)(row[j] - std::max(0.0, distance - min_width) * settings.mask_height / (max_width - min_width) / 2);
+	}
+}
+
+void generate_chunk(const chunk_settings& settings, int x, int z, terrain_chunk& chunk, thread_pool& pool)
+{
+	int size = settings.chunk_size;
+	int points = size + 1;
+	int x0 = x * size;
+	int z0 = z * size;
+
+	chunk.x = x;
+	chunk.z = z;
+	chunk.heights.resize(points, points);
+
+	// every row is a pure function of its world coordinates, so the rows can go in parallel
+	pool.parallel_for(points, [&](int i)
+	{
+		world_heights(settings, x0 + i, z0, points, chunk.heights[i]);
+	});
+
+	chunk.min_height = HUGE_VALF;
+	chunk.max_height = -HUGE_VALF;
+	for (int i = 0; i < points; i++)
+	{
+		for (int j = 0; j < points; j++)
+		{
+			chunk.min_height = std::min(chunk.min_height, chunk.heights[i][j]);
+			chunk.max_height = std::max(chunk.max_height, chunk.heights[i][j]);
+		}
+	}
+}
+
+/*
+two triangles per cell
+   ______
+v1 |\   | v3
+   | \  |
+   |  \ |
+v2 |___\| v4
+*/
+
+void build_chunk_mesh(const chunk_settings& settings, const terrain_chunk& chunk, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& colors, std::vector<glm::vec3>& normals, std::vector<uint32_t>& indices)
+{
+	int size = settings.chunk_size;
+	int points = size + 1;
+	int x0 = chunk.x * size;
+	int z0 = chunk.z * size;
+	float water_level = (float)settings.water_level;
+	const heightfield<float>& map = chunk.heights;
+
+	// the heights with a ring of the neighbouring chunks' points around them, so the normals on the edges are
+	// the same as the ones the neighbours give the points they share
+	heightfield<float> ring(points + 2, points + 2);
+	world_heights(settings, x0 - 1, z0 - 1, points + 2, ring[0]);
+	world_heights(settings, x0 + points, z0 - 1, points + 2, ring[points + 1]);
+	for (int i = 0; i < points; i++)
+	{
+		world_heights(settings, x0 + i, z0 - 1, 1, &ring[i + 1][0]);
+		memcpy(&ring[i + 1][1], map[i], points * sizeof(float));
+		world_heights(settings, x0 + i, z0 + points, 1, &ring[i + 1][points + 1]);
+	}
+
+	// sand up to BEACH_HEIGHT above the water. chunks don't measure the distance to the coast, so unlike
+	// generate_terrain low ground away from the sea is sand too
+	glm::vec3 grass = material_color(MATERIAL_GRASS);
+	glm::vec3 sand = material_color(MATERIAL_SAND);
+
+	// a vertex per point, one row after the other like the island
+	size_t grid = (size_t)points * points;
+	vertices.resize(grid);
+	colors.resize(grid);
+	normals.resize(grid);
+	std::vector<glm::vec3> row_normals(points + 2);
+	for (int i = 0; i < points; i++)
+	{
+		sobel_normal_row(ring, 1, i + 1, &row_normals[0]);
+		for (int j = 0; j < points; j++)
+		{
+			size_t v = (size_t)i * points + j;
+			vertices[v] = glm::vec3((float)(x0 + i), map[i][j], (float)(z0 + j));
+			colors[v] = map[i][j] - water_level < BEACH_HEIGHT ? sand : grass;
+			normals[v] = row_normals[j + 1];
+		}
+	}
+
+	indices.clear();
+	indices.reserve((size_t)size * size * 6 + 6);
+	for (uint32_t x = 0; x < (uint32_t)size; x++)
+	{
+		for (uint32_t z = 0; z < (uint32_t)size; z++)
+		{
+			uint32_t v1 = x * points + z;
+			uint32_t v2 = v1 + points;
+			uint32_t v3 = v1 + 1;
+			uint32_t v4 = v2 + 1;
+
+			indices.push_back(v2);
+			indices.push_back(v1);
+			indices.push_back(v4);
+
+			indices.push_back(v1);
+			indices.push_back(v3);
+			indices.push_back(v4);
+		}
+	}
+
+	// water over the part of the chunk that is below it
+	if (chunk.min_height < water_level)
+	{
+		uint32_t first = (uint32_t)vertices.size();
+		vertices.push_back(glm::vec3((float)x0, water_level, (float)z0));
+		vertices.push_back(glm::vec3((float)x0, water_level, (float)(z0 + size)));
+		vertices.push_back(glm::vec3((float)(x0 + size), water_level, (float)z0));
+		vertices.push_back(glm::vec3((float)(x0 + size), water_level, (float)(z0 + size)));
+		colors.insert(colors.end(), 4, glm::vec3(0.2, 0.2, 1));
+		normals.insert(normals.end(), 4, glm::vec3(0, 1, 0));
+
+		uint32_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+		for (int i = 0; i < 6; i++)
+			indices.push_back(first + quad[i]);
+	}
+}
+
+float chunk_height(const chunk_settings& settings, const terrain_chunk& chunk, float x, float z)
+{
+	glm::vec2 origin((float)chunk.x * settings.chunk_size, (float)chunk.z * settings.chunk_size);
+	return heightfield_query(chunk.heights, 1, origin).height(x, z);
+}
+
+chunk_cache::chunk_cache(size_t max_bytes) : max_bytes(max_bytes), bytes(0)
+{
+}
+
+std::shared_ptr<const terrain_chunk> chunk_cache::find(int x, int z)
+{
+	std::unordered_map<uint64_t, chunk_list::iterator>::iterator found = index.find(chunk_key(x, z));
+	if (found == index.end())
+		return std::shared_ptr<const terrain_chunk>();
+
+	// move it to the front
+	chunks.splice(chunks.begin(), chunks, found->second);
+	return chunks.front();
+}
+
+void chunk_cache::insert(const std::shared_ptr<const terrain_chunk>& chunk)
+{
+	uint64_t key = chunk_key(chunk->x, chunk->z);
+	std::unordered_map<uint64_t, chunk_list::iterator>::iterator found = index.find(key);
+	if (found != index.end())
+	{
+		bytes -= (*found->second)->memory();
+		chunks.erase(found->second);
+	}
+
+	chunks.push_front(chunk);
+	index[key] = chunks.begin();
+	bytes += chunk->memory();
+
+	// drop the least recently used chunks until it fits again, but always keep the new one
+	while (bytes > max_bytes && chunks.size() > 1)
+	{
+		const std::shared_ptr<const terrain_chunk>& oldest = chunks.back();
+		bytes -= oldest->memory();
+		index.erase(chunk_key(oldest->x, oldest->z));
+		chunks.pop_back();
+	}
+}
@@ -0,0 +1,105 @@
+#ifndef TERRAIN_CHUNKS_DEF
+#define TERRAIN_CHUNKS_DEF
+
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <internal/heightfield.h>
+#include <internal/thread_pool.h>
+#include <glm/glm.hpp>
+
+/*
+	unbounded world of islands, split into square chunks that can be generated in any order. every height is a
+	function of its world position only (simplex fbm, pushed down with the distance to the nearest island center),
+	so chunks don't need their neighbours, or anything global like the statistics generate_terrain normalizes with,
+	and the points on the edge of two chunks are the same in both.
+*/
+
+// cells per side of a chunk
+#define CHUNK_SIZE 128
+
+struct chunk_settings
+{
+	uint64_t seed;
+	int chunk_size;
+
+	// fbm like octave_noise: octave 0 has lattice points one cell apart, every following one doubles the
+	// spacing and the amplitude
+	int octaves;
+	double amplitude;
+
+	// islands sit on a grid island_spacing cells apart, each moved randomly by up to a quarter of that.
+	// the ground is lowered from island_radius / 4 to island_radius away from the center by up to mask_height
+	double island_spacing;
+	double island_radius;
+	double mask_height;
+
+	double water_level;
+};
+
+// defaults for a world about as hilly as a map_size 1536 island
+chunk_settings default_chunk_settings(uint64_t seed);
+
+// generated part of the world
+struct terrain_chunk
+{
+	int x;
+	int z;
+
+	// chunk_size + 1 points per side, world point (x * chunk_size + i, z * chunk_size + j)
+	heightfield<float> heights;
+	float min_height;
+	float max_height;
+
+	size_t memory() const { return sizeof(terrain_chunk) + heights.size_x() * heights.size_y() * sizeof(float); }
+};
+
+// key of chunk x, z in maps of chunks
+inline uint64_t chunk_key(int x, int z) { return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z; }
+
+// generate the heights of chunk x, z. rows are handed out to the pool
+void generate_chunk(const chunk_settings& settings, int x, int z, terrain_chunk& chunk, thread_pool& pool);
+
+/*
+	indexed mesh of a chunk in world space: a vertex per point with its material_color and its sobel_normal_row
+	normal, triangulated like the island, plus a water quad if any of the chunk is below the water level.
+	the normals on the edges take the neighbouring chunks' points into account, so chunks meet without a seam
+*/
+void build_chunk_mesh(const chunk_settings& settings, const terrain_chunk& chunk, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& colors, std::vector<glm::vec3>& normals, std::vector<uint32_t>& indices);
+
+// height of the ground at world position x, z, which has to be inside the chunk
+float chunk_height(const chunk_settings& settings, const terrain_chunk& chunk, float x, float z);
+
+/*
+	generated chunks that were used recently, so walking back somewhere doesn't generate it again.
+	holds at most max_bytes of chunks, the least recently used are dropped first. not thread safe
+*/
+class chunk_cache
+{
+public:
+	explicit chunk_cache(size_t max_bytes);
+
+	chunk_cache(const chunk_cache&) = delete;
+	chunk_cache& operator=(const chunk_cache&) = delete;
+
+	// null if the chunk isn't cached, marks it as used otherwise
+	std::shared_ptr<const terrain_chunk> find(int x, int z);
+
+	void insert(const std::shared_ptr<const terrain_chunk>& chunk);
+
+	size_t size() const { return chunks.size(); }
+	size_t memory() const { return bytes; }
+
+private:
+	typedef std::list<std::shared_ptr<const terrain_chunk>> chunk_list;
+
+	// most recently used first
+	chunk_list chunks;
+	std::unordered_map<uint64_t, chunk_list::iterator> index;
+	size_t max_bytes;
+	size_t bytes;
+};
+
+#endif // !TERRAIN_CHUNKS_DEF
@@ -1,15 +1,86 @@
 #include <internal/terrain_generation.h>
-#include <internal/spline.h> // won't compile if this is in the header?
-// won't take define from header file? fix this
-//#define max(a, b) a > b ? a : b
-//#define min(a, b) a < b ? a : b
+#include <internal/upsample.h>
+#include <internal/simplex_noise.h>
+#include <internal/terrain_random.h>
+#include <internal/heightfield_ops.h>
+#include <internal/scatter.h>
+#include <internal/noise_graph.h>
+#include <internal/compact_heightfield.h>
+#include <internal/simd.h>
+#include <chrono>
+
+static const char* stage_names[STAGE_COUNT] = { "noise", "normalize", "mask", "erosion", "thermal", "hydrology", "features", "water", "classify", "mesh" };
+
+// rough share of the generation time each stage takes, used to weigh the progress bar
+static const int stage_weights[STAGE_COUNT] = { 40, 2, 3, 30, 10, 10, 8, 1, 10, 1 };
+
+const char* terrain_stage_name(terrain_stage stage)
+{
+	return stage_names[stage];
+}
+
+terrain_progress::terrain_progress()
+{
+	reset();
+}
+
+void terrain_progress::reset()
+{
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		stage_done[i] = 0;
+		stage_total[i] = 0;
+		times[i] = 0;
+		counts[i] = 0;
+	}
+	total = 0;
+	done = false;
+}
+
+void terrain_progress::begin(terrain_stage stage, int total)
+{
+	stage_done[stage] = 0;
+	stage_total[stage] = total;
+}
+
+void terrain_progress::advance(terrain_stage stage, int amount)
+{
+	stage_done[stage] += amount;
+}
+
+void terrain_progress::complete(terrain_stage stage, double seconds)
+{
+	counts[stage] = stage_done[stage];
+
+	// stages with nothing to count only show up once they're complete
+	if (stage_total[stage] == 0) stage_total[stage] = 1;
+	stage_done[stage] = stage_total[stage].load();
+	times[stage] = seconds;
+}
+
+void terrain_progress::finish(double seconds)
+{
+	total = seconds;
+	done.store(true, std::memory_order_release);
+}
 
-// generate a ramdom double between 0 and 1
-double random() 
+int terrain_progress::percentage() const
 {
-	static thread_local std::mt19937 generator = std::mt19937(time(0));
-	std::uniform_real_distribution<double> distribution(0.0, 1.0);
-	return distribution(generator);
+	if (finished()) return 100;
+
+	double total_weight = 0;
+	double done_weight = 0;
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		int total = stage_total[i];
+		int count = std::min((int)stage_done[i], total);
+		total_weight += stage_weights[i];
+		if (total > 0)
+			done_weight += stage_weights[i] * (double)count / total;
+	}
+
+	// 100 only once the island is actually finished
+	return std::min((int)(done_weight * 100 / total_weight), 99);
 }
 
 int round_down(int n, int m)
@@ -45,333 +116,432 @@ double bilinear_interpolation(double v1, double v2, double v3, double v4, double
 		);
 }
 
-std::vector<std::vector<double>> bicubic_interpolation(std::vector<std::vector<double>> h, int gap) 
+// one layer of value noise: random values on a coarse lattice, upsampled to the size of the map
+struct noise_octave
 {
-	int size = h.size() * gap;
-
-	// output vector
-	std::vector<std::vector<double>> out(size, std::vector<double>(size, INIT_VALUE));
+	int frequency;
 
-	// spline to calculate interpolation
-	tk::spline s;
+	// points of the map between lattice points, frequency / step. 1 if the lattice is as fine as the map or finer,
+	// only the lattice points that fall on the map are generated then
+	int factor;
 
-	// array of positions of known points
-	std::vector<double> pos_arr;
-	for (int i = 0; i < size; i += gap) 
-		pos_arr.push_back(i);
+	// random values, or their B-spline coefficients for the bicubic octaves
+	heightfield<double> lattice;
+};
 
-	// interpolate columns
-	for (unsigned int x = 0; x < h.size(); x++)
-	{
-		s.set_points(pos_arr, h[x]);
-
-		for (int y = 0; y < size; y++)
-		{
-			out[x*gap][y] = s(y);
-		}
-	}
-	
-	// interpolate rows
-	for (int y = 0; y < size; y++)
+// generate the lattice of an octave and do the parts of its interpolation that need the whole lattice.
+// lattice point i, j always gets the same value whatever the step, so every step samples the same octave
+static void prepare_octave(noise_octave& octave, int size, int step, double amplitude, int frequency, uint64_t seed, int index, thread_pool& pool)
+{
+	int stride = frequency >= step ? 1 : step / frequency;
+	int s = size / frequency / stride;
+	octave.frequency = frequency;
+	octave.factor = frequency >= step ? frequency / step : 1;
+
+	// generate the noise, every lattice point has its own random number so the rows can be done in parallel
+	octave.lattice.resize(s, s);
+	pool.parallel_for(s, [&](int i)
 	{
-		// separate vector to store the points in the rows correctly
-		std::vector<double> row;
-		for (int i = 0; i < size; i += gap)
+		for (int j = 0; j < s; j++)
 		{
-			row.push_back(out[i][y]);
+			octave.lattice[i][j] = random_double(seed, index, i * stride, j * stride) * amplitude;
 		}
+	});
 
-		s.set_points(pos_arr, row);
+	// bicubic interpolation for low frequencies (slower but more accurate) is done with a B-spline,
+	// which has to be prefiltered so it passes through the lattice points
+	if (octave.factor > 4)
+		bspline_prefilter(octave.lattice);
+}
 
-		for (int x = 0; x < size; x++)
-		{
-			out[x][y] = s(x);
-		}
+// add the octave onto the part of the map covered by a tile, tile[(x - x0) * (y1 - y0) + (y - y0)]
+static void sample_octave(const noise_octave& octave, int x0, int x1, int y0, int y1, double* tile)
+{
+	int frequency = octave.factor;
+	int pitch = y1 - y0;
+	const heightfield<double>& temp = octave.lattice;
+
+	if (frequency == 1)
+	{
+		for (int x = x0; x < x1; x++)
+			for (int y = y0; y < y1; y++)
+				tile[(x - x0) * pitch + (y - y0)] += temp[x][y];
 	}
+	else if (frequency <= 4)
+		bilinear_upsample(temp, frequency, x0, x1, y0, y1, tile, pitch);
+	else
+		bspline_upsample(temp, frequency, x0, x1, y0, y1, tile, pitch);
+}
 
-	return out;
+int noise_octave_count(int size, int iterations)
+{
+	if (iterations == 0) iterations = size;
+
+	int octave_count = 0;
+	while (octave_count < iterations && octave_count < RANDOM_STREAM_OCTAVES && pow(2, octave_count) < size / 2)
+		octave_count++;
+	return octave_count;
+}
+
+/*
+	rolling fbm hills, with ridged mountain ranges where a coarse control noise is high, everything warped so
+	the ridges and coasts bend instead of following the lattice. the whole graph is one kernel per point
+*/
+void ridged_island_block(int size, int octaves, double amplitude, uint64_t seed, int step, int x0, int x1, int y0, int y1, double* out, int pitch)
+{
+	uint32_t s = (uint32_t)random_hash(seed, RANDOM_STREAM_SIMPLEX, 1, 0);
+	double half = amplitude * size / 4;
+
+	auto hills = noise_fbm(noise_simplex(size / 4.0, s), std::max(octaves - 2, 1));
+	auto peaks = noise_curve(noise_ridged(noise_simplex(size / 6.0, s + 1), std::max(octaves - 3, 1)), { { 0, 0 }, { 0.4, 0.15 }, { 0.8, 0.7 }, { 1, 1 } });
+	auto ranges = noise_fbm(noise_simplex(size / 2.0, s + 2), 2);
+	auto land = noise_select(hills * 0.5, hills * 0.3 + peaks, ranges, 0.1, 0.4);
+	auto island = noise_warp(land, noise_fbm(noise_simplex(size / 8.0, s + 3), 3), size / 24.0);
+	noise_graph_block(island * half + half, step, x0, x1, y0, y1, out, pitch);
 }
 
-void noise(int size, std::vector<std::vector<double>>& map, double amplitude, int frequency)
+void octave_noise(int size, int step, int iterations, double amplitude, terrain_generator generator, uint64_t seed, heightfield<double>& map, terrain_progress& progress, const cancel_token& cancel, thread_pool& pool)
 {
-	int s = size / frequency;
+	int octave_count = noise_octave_count(size, iterations);
 
-	// vector of vectors of doubles to store the noise
-	std::vector<std::vector<double>> temp(s, std::vector<double>(s, INIT_VALUE));
+	// points of the map on each side
+	int points = size / step;
 
-	// generate the noise
-	for (int i = 0; i < s; i++)
-	{
-		for (int j = 0; j < s; j++)
-		{
-			temp[i][j] = random() * amplitude;
-		}
-	}
+	// one unit of progress per prepared octave and per tile
+	int tiles = (points + NOISE_TILE_SIZE - 1) / NOISE_TILE_SIZE;
+	progress.begin(STAGE_NOISE, (generator == GENERATOR_VALUE_NOISE ? octave_count : 0) + tiles * tiles);
 
-	// interpolation
-	if (frequency != 1)
+	// prepare every octave up front, so the tiles below only read shared data
+	std::vector<noise_octave> octaves;
+	if (generator == GENERATOR_VALUE_NOISE)
 	{
-		if (frequency <= 4)
+		for (int i = 0; i < octave_count && !cancel.cancelled(); i++)
 		{
-			// bilinear interpolation for high frequencies (faster but less accurate)
-			std::vector<std::vector<double>> t(size, std::vector<double>(size, INIT_VALUE));
-			for (int x = 0; x < size; x++)
-				for (int y = 0; y < size; y++)
-					t[x][y] = bilinear_interpolation(                                                                                                   //        ____
-						temp[(int)(x / frequency)                                       ][(int)(y / frequency)                                       ], // v1  y2|    |
-						temp[(int)(x / frequency)                                       ][(int)(y / frequency) < s - 1 ? (int)(y / frequency) + 1 : 0], // v2    |    |
-						temp[(int)(x / frequency) < s - 1 ? (int)(x / frequency) + 1 : 0][(int)(y / frequency)                                       ], // v3  y1|____|
-						temp[(int)(x / frequency) < s - 1 ? (int)(x / frequency) + 1 : 0][(int)(y / frequency) < s - 1 ? (int)(y / frequency) + 1 : 0], // v4    x1  x2
-						round_down(x, frequency),
-						round_down(x, frequency) + frequency,
-						round_down(y, frequency),
-						round_down(y, frequency) + frequency,
-						x,
-						y
-						);
-			temp = t;
+			octaves.push_back(noise_octave());
+			//                             size, step, amplitude,             frequency
+			prepare_octave(octaves.back(), size, step, pow(2, i) * amplitude, (int)pow(2, i), seed, i, pool);
+			progress.advance(STAGE_NOISE);
 		}
-		else
-			// bicubic interpolation for low frequencies (slower but more accurate)
-			temp = bicubic_interpolation(temp, frequency);
 	}
 
-	// add onto existing map
-	for (int i = 0; i < size; i++)
+	// simplex octaves are spaced and scaled like the value noise ones, but need nothing prepared.
+	// a period of 1 / step makes point x of the map land on x * step, exactly, as step is a power of 2
+	fbm_settings fbm;
+	fbm.seed = (uint32_t)random_hash(seed, RANDOM_STREAM_SIMPLEX, 0, 0);
+	fbm.octaves = octave_count;
+	fbm.period = 1.0 / step;
+	fbm.amplitude = amplitude;
+	fbm.period_scale = 2;
+	fbm.amplitude_scale = 2;
+
+	// each tile of the map is owned by one job, which sums every octave for it and writes it out once
+	map.resize(points, points, INIT_VALUE);
+	pool.parallel_for(tiles * tiles, [&](int t)
 	{
-		for (int j = 0; j < size; j++)
-		{
-			map[i][j] += temp[i][j];
-		}
-	}
+		if (cancel.cancelled()) return;
+
+		int x0 = (t / tiles) * NOISE_TILE_SIZE;
+		int y0 = (t % tiles) * NOISE_TILE_SIZE;
+		int x1 = std::min(x0 + NOISE_TILE_SIZE, points);
+		int y1 = std::min(y0 + NOISE_TILE_SIZE, points);
+
+		std::vector<double> tile((x1 - x0) * (y1 - y0), INIT_VALUE);
+		if (generator == GENERATOR_SIMPLEX)
+			simplex_fbm_block(fbm, x0, x1, y0, y1, &tile[0], y1 - y0);
+		else if (generator == GENERATOR_RIDGED)
+			ridged_island_block(size, octave_count, amplitude, seed, step, x0, x1, y0, y1, &tile[0], y1 - y0);
+		else
+			for (std::vector<noise_octave>::const_iterator octave = octaves.begin(); octave != octaves.end(); octave++)
+				sample_octave(*octave, x0, x1, y0, y1, &tile[0]);
 
+		for (int x = x0; x < x1; x++)
+			memcpy(&map[x][y0], &tile[(x - x0) * (y1 - y0)], (y1 - y0) * sizeof(double));
+		progress.advance(STAGE_NOISE);
+	});
 }
 
-void generate_terrain(int size, int iterations, double amplitude, std::vector<std::vector<glm::vec3>>& vertices, std::vector<glm::vec3>& colors, std::vector<glm::vec3>& normals, int& completion)
+bool generate_terrain(int size, int step, int iterations, double amplitude, terrain_generator generator, uint64_t seed, const erosion_settings& erosion, heightfield<float>& heights, material_layer& materials, std::vector<glm::vec3>& features, std::vector<glm::vec3>& colors, std::vector<glm::vec3>& normals, terrain_progress& progress, const cancel_token& cancel, thread_pool& pool)
 {
-	// seed the random number generator
-	//srand(time(NULL));	
-
 	// output map
-	std::vector<std::vector<double>> map(size, std::vector<double>(size, INIT_VALUE));
+	heightfield<double> map;
 
 	// if iterations is 0, make the terrain generation run until it hits the smallest frequency
 	if (iterations == 0) iterations = size;
-	
-	// timing system
-	time_t start_time = time(0);
-	time_t step_time = time(0);
-
-	// generate the map
-
-	// parallel threads to improve performance and generation speed
-	std::vector<std::thread> threads;
-	for (int i = 0; i < iterations && pow(2, i) < size / 2; i++)
-		// create one thread per layer of noise
-		//                            func,  size, map,           amplitude,                frequency
-		threads.push_back(std::thread(noise, size, std::ref(map), pow(2, i) * amplitude, pow(2, i)));
-
-	// join the parallel threads
-	int j = 1;
-	for (std::vector<std::thread>::iterator i = threads.begin(); i != threads.end(); i++)
-	{
-		i->join();
-		completion = (j++ / threads.size()) * 40;
-	}
 
-	printf("noise generation complete in t <= %f sec\n", difftime(time(0), start_time));
-	completion = 40;
+	// points of the map on each side
+	int points = size / step;
 
-	// calculate minimum height on map to ensure that all points are positive
-	double min_height = size / 2;
+	progress.reset();
+	features.clear();
+	colors.clear();
+	normals.clear();
+
+	// state passed between the stages
+	heightfield_stats stats;
+	double min_height = 0;
 	double max_height = 0;
-	for (int i = 0; i < size; i++)
+	double water_level = 0;
+
+	// trees and water, put together in the outputs once they're both done
+	std::vector<glm::vec3> tree_vertices, tree_colors, tree_normals;
+	std::vector<glm::vec3> water_vertices, water_colors, water_normals;
+
+	/*
+	noise -> normalize -> mask -> erosion -> thermal -> hydrology -> features -> mesh
+	                                                              -> water    -> mesh
+	                                                              -> classify
+	*/
+	task_graph graph;
+	int noise_task = graph.add(stage_names[STAGE_NOISE], [&]()
 	{
-		for (int j = 0; j < size; j++)
-		{
-			min_height = min(map[i][j], min_height);
-			max_height = max(map[i][j], max_height);
-		}
-	}
+		octave_noise(size, step, iterations, amplitude, generator, seed, map, progress, cancel, pool);
+	});
 
-	for (int i = 0; i < size; i++)
+	// calculate minimum height on map to ensure that all points are positive
+	int normalize_task = graph.add(stage_names[STAGE_NORMALIZE], [&]()
 	{
-		for (int j = 0; j < size; j++)
-		{
-			map[i][j] += min_height;
-			max_height = max(map[i][j], max_height);
-		}
-	}
-
-	// island mask
-	double max_width = size / 2;
-	double min_width = size / 8;
-	for (int x = 0; x < size; x++)
+		stats = heightfield_statistics(map, pool);
+		min_height = std::min(stats.min, (double)(size / 2));
+		max_height = std::max(std::max(stats.max, 0.0), stats.max + min_height);
+	}, { noise_task });
+
+	// raise the map by min_height and apply the island mask in one pass, which also outputs the
+	// single precision heightmap for rendering and collision
+	int mask_task = graph.add(stage_names[STAGE_MASK], [&]()
 	{
-		for (int y = 0; y < size; y++)
-		{
-			double x_dist = size / 2 - x;
-			double y_dist = size / 2 - y;
-			double dist = max(0, sqrt((x_dist * x_dist) + (y_dist * y_dist)) - min_width);
-			double factor = dist * max_height / (max_width - min_width);
-			 
-			map[x][y] = map[x][y] - factor / 2; 
-		}
-	}
+		double max_width = size / 2;
+		double min_width = size / 8;
+		stats = island_mask(map, step, min_height, min_width, max_width, max_height, heights, pool);
+
+		// average and minimum heights on new map
+		min_height = std::min(stats.min, (double)size);
+		max_height = std::max(stats.max, 0.0);
+		double avg_height = stats.average();
 
-	// recalculate average and minimum heights on new map
-	double avg_height = 0;
-	min_height = size;
-	max_height = 0;
-	for (int i = 0; i < size; i++)
+		water_level = (avg_height * 2 + max_height) / 3;
+	}, { normalize_task });
+
+	// bring the single precision heights up to date once erosion changed the map
+	auto refresh_heights = [&]()
 	{
-		for (int j = 0; j < size; j++)
+		pool.parallel_for(points, [&](int i)
 		{
-			min_height = min(map[i][j], min_height);
-			max_height = max(map[i][j], max_height);
-			avg_height += map[i][j];
-		}
-	}
-	avg_height /= size * size;
+			for (int j = 0; j < points; j++)
+				heights[i][j] = (float)map[i][j];
+		});
+	};
+
+	// wash the slopes down with droplets. the water level stays the one of the uneroded island, so coarse and
+	// full detail islands keep the same coast
+	int erosion_task = graph.add(stage_names[STAGE_EROSION], [&]()
+	{
+		erosion_settings settings = erosion;
+		settings.droplets = erosion.droplets / (step * step);
+		progress.begin(STAGE_EROSION, settings.droplets);
 
-	double water_level = (avg_height * 2 + max_height) / 3;
+		if (hydraulic_erosion(map, settings, seed, cancel, pool, [&](int n) { progress.advance(STAGE_EROSION, n); }) > 0)
+			refresh_heights();
+	}, { mask_task });
 
-	printf("noise processing complete in t <= %f sec\n", difftime(time(0), step_time));
-	time(&step_time);
-	printf("terrain generation complete in t <= %f sec\n", difftime(time(0), start_time));
-	completion = 50;
+	// let steep slopes slide down into cliffs and scree
+	int thermal_task = graph.add(stage_names[STAGE_THERMAL], [&]()
+	{
+		progress.begin(STAGE_THERMAL, erosion.thermal_iterations);
+
+		if (thermal_erosion(map, erosion, step, cancel, pool, [&](int n) { progress.advance(STAGE_THERMAL, n); }) > 0)
+			refresh_heights();
+	}, { erosion_task });
 
-	// output to vector
-	vertices.resize(size);
-	vertices[0].resize(size);
-	for (int i = 0; i < size - 1; i++)
+	// fill the hollows into lakes and cut rivers where enough of the island drains through
+	hydrology_map hydrology;
+	int hydrology_task = graph.add(stage_names[STAGE_HYDROLOGY], [&]()
+	{
+		compute_hydrology(map, step, water_level, default_hydrology_settings(), hydrology, pool);
+		refresh_heights();
+	}, { thermal_task });
+
+	/*
+		scatter trees and bushes over the island with blue noise. the tree model is read once, and every instance
+		is a copy of it turned, scaled and moved into place
+	*/
+	int features_task = graph.add(stage_names[STAGE_FEATURES], [&]()
 	{
-		vertices[i + 1].resize(size);
-		for (int j = 0; j < size - 1; j++)
+		std::vector<scatter_instance> instances;
+		if (!scatter_instances(map, step, hydrology, water_level, default_scatter_species(), seed, instances, cancel, pool))
+			return;
+		progress.begin(STAGE_FEATURES, (int)instances.size());
+
+		std::vector<glm::vec3> model_vertices, model_colors, model_normals;
+		model tree = model();
+		if (!instances.empty() && tree.load_model("tree.obj", "tree.mtl"))
+			tree.get_model(model_vertices, model_colors, model_normals);
+
+		tree_vertices.reserve(instances.size() * model_vertices.size());
+		tree_colors.reserve(instances.size() * model_colors.size());
+		tree_normals.reserve(instances.size() * model_normals.size());
+		for (size_t i = 0; i < instances.size(); i++)
 		{
-			/*
-			   ______
-			v1 |\   | v3
-			   | \  |
-			   |  \ |
-			v2 |___\| v4
-			*/
-
-			glm::vec3 vert1 = glm::vec3(i - size / 2, map[i][j], j - size / 2);
-			glm::vec3 vert2 = glm::vec3(i + 1 - size / 2, map[i + 1][j], j - size / 2);
-			glm::vec3 vert3 = glm::vec3(i - size / 2, map[i][j + 1], j + 1 - size / 2);
-			glm::vec3 vert4 = glm::vec3(i + 1 - size / 2, map[i + 1][j + 1], j + 1 - size / 2);
-
-			glm::vec3 u1 = vert1 - vert4;
-			glm::vec3 v1 = vert1 - vert2;
-			glm::vec3 normal1 = glm::vec3(
-				(u1.y * v1.z) - (u1.z * v1.y),
-				(u1.z * v1.x) - (u1.x * v1.z),
-				(u1.x * v1.y) - (u1.y * v1.x));
-
-			normals.push_back(normal1);
-			normals.push_back(normal1);
-			normals.push_back(normal1);
-
-			glm::vec3 u2 = vert1 - vert3;
-			glm::vec3 v2 = vert1 - vert4;
-			glm::vec3 normal2 = glm::vec3(
-				(u2.y * v2.z) - (u2.z * v2.y),
-				(u2.z * v2.x) - (u2.x * v2.z),
-				(u2.x * v2.y) - (u2.y * v2.x));
-
-			normals.push_back(normal2);
-			normals.push_back(normal2);
-			normals.push_back(normal2);
-
-			glm::vec3 grass(0.2, 1, 0.2);
-			glm::vec3 sand(0.76, 0.7, 0.5);
-
-			if (((vert1.y + vert2.y + vert4.y) / 3) - water_level < 2.5)
+			const scatter_instance& instance = instances[i];
+			float angle = instance.rotation * (6.28318531f / 65536);
+			float c = cosf(angle);
+			float s = sinf(angle);
+			for (size_t v = 0; v < model_vertices.size(); v++)
 			{
-				colors.push_back(sand);
-				colors.push_back(sand);
-				colors.push_back(sand);
+				glm::vec3 p = model_vertices[v] * instance.scale;
+				tree_vertices.push_back(glm::vec3(p.x * c - p.z * s, p.y, p.x * s + p.z * c) + instance.position);
 			}
-			else
+			for (size_t v = 0; v < model_normals.size(); v++)
 			{
-				colors.push_back(grass);
-				colors.push_back(grass);
-				colors.push_back(grass);
+				glm::vec3 n = model_normals[v];
+				tree_normals.push_back(glm::vec3(n.x * c - n.z * s, n.y, n.x * s + n.z * c));
 			}
-
-			if (((vert1.y + vert3.y + vert4.y) / 3) - water_level < 2.5)
-			{
-				colors.push_back(sand);
-				colors.push_back(sand);
-				colors.push_back(sand);
-			}
-			else
-			{
-				colors.push_back(grass);
-				colors.push_back(grass);
-				colors.push_back(grass);
-			}
-
-			vertices[i][j] = vert1;
-			vertices[i + 1][j] = vert2;
-			vertices[i][j + 1] = vert3;
-			vertices[i + 1][j + 1] = vert4;
+			tree_colors.insert(tree_colors.end(), model_colors.begin(), model_colors.end());
 		}
-		completion = 50 + (i * 50 / size);
-	}
+		progress.advance(STAGE_FEATURES, (int)instances.size());
+	}, { hydrology_task });
 
-	// add features such as trees and rocks
-	std::vector<glm::vec3> trees = std::vector<glm::vec3>();
-	const int tree_freq = 64;
-	for (int i = 0; i < size / tree_freq; i++)
+	// add water: the sea is one plane around the whole island, lakes and rivers get a square at the height of
+	// their water around every point they cover
+	int water_task = graph.add(stage_names[STAGE_WATER], [&]()
 	{
-		for (int j = 0; j < size / tree_freq; j++) // some amount of features must be in every 16x16 square
+		water_vertices.push_back(glm::vec3(-size, water_level, -size));
+		water_vertices.push_back(glm::vec3(-size, water_level, size));
+		water_vertices.push_back(glm::vec3(size, water_level, -size));
+
+		water_vertices.push_back(glm::vec3(size, water_level, -size));
+		water_vertices.push_back(glm::vec3(-size, water_level, size));
+		water_vertices.push_back(glm::vec3(size, water_level, size));
+
+		float half = step / 2.0f;
+		for (int i = 0; i < points; i++)
 		{
-			int x = random() * tree_freq;
-			int z = random() * tree_freq; // randomly place the feature in the 16x16 square
-			if (map[i * tree_freq + x][j * tree_freq + z] > water_level)
+			for (int j = 0; j < points; j++)
 			{
-				model tree = model();
-				tree.load_model("tree.obj", "tree.mtl");
-				tree.translate(i * tree_freq + x - size/2, map[i * tree_freq + x][j * tree_freq + z], j * tree_freq + z - size/2);
-				tree.get_model(trees, colors, normals);
+				int water = hydrology.water[i][j];
+				if (water != WATER_LAKE && water != WATER_RIVER)
+					continue;
+
+				float x = (float)(i * step - size / 2);
+				float z = (float)(j * step - size / 2);
+				float y = hydrology.surface[i][j];
+				water_vertices.push_back(glm::vec3(x - half, y, z - half));
+				water_vertices.push_back(glm::vec3(x - half, y, z + half));
+				water_vertices.push_back(glm::vec3(x + half, y, z - half));
+
+				water_vertices.push_back(glm::vec3(x + half, y, z - half));
+				water_vertices.push_back(glm::vec3(x - half, y, z + half));
+				water_vertices.push_back(glm::vec3(x + half, y, z + half));
 			}
 		}
-	}
-	vertices.push_back(trees);
 
-	// add water
-	std::vector<glm::vec3> water;
+		water_colors.assign(water_vertices.size(), glm::vec3(0.2, 0.2, 1));
+		water_normals.assign(water_vertices.size(), glm::vec3(0, 1, 0));
+	}, { hydrology_task });
 
-	water.push_back(glm::vec3(-size, water_level, -size));
-	water.push_back(glm::vec3(-size, water_level, size));
-	water.push_back(glm::vec3(size, water_level, -size));
+	// material of the terrain points, sand along the coast and grass above it. the rows start on words of their
+	// own, so they are set in parallel
+	graph.add(stage_names[STAGE_CLASSIFY], [&]()
+	{
+		progress.begin(STAGE_CLASSIFY, points);
+		materials.resize(points, points);
 
-	water.push_back(glm::vec3(size, water_level, -size));
-	water.push_back(glm::vec3(-size, water_level, size));
-	water.push_back(glm::vec3(size, water_level, size));
+		pool.parallel_for(points, [&](int i)
+		{
+			if (cancel.cancelled()) return;
 
-	vertices.push_back(water);
+			for (int j = 0; j < points; j++)
+				if (is_beach(hydrology.coast[i][j], map[i][j] - water_level))
+					materials.set_material(i, j, MATERIAL_SAND);
+			progress.advance(STAGE_CLASSIFY);
+		});
+	}, { hydrology_task });
 
-	colors.push_back(glm::vec3(0.2, 0.2, 1));
-	colors.push_back(glm::vec3(0.2, 0.2, 1));
-	colors.push_back(glm::vec3(0.2, 0.2, 1));
+	// the trees and the water as one list of triangles
+	graph.add(stage_names[STAGE_MESH], [&]()
+	{
+		features.insert(features.end(), tree_vertices.begin(), tree_vertices.end());
+		features.insert(features.end(), water_vertices.begin(), water_vertices.end());
+		colors.insert(colors.end(), tree_colors.begin(), tree_colors.end());
+		colors.insert(colors.end(), water_colors.begin(), water_colors.end());
+		normals.insert(normals.end(), tree_normals.begin(), tree_normals.end());
+		normals.insert(normals.end(), water_normals.begin(), water_normals.end());
+	}, { features_task, water_task });
+
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	bool complete = graph.run(pool, cancel);
+
+	// the tasks were added in the order of terrain_stage
+	for (int i = 0; i < graph.size(); i++)
+		progress.complete((terrain_stage)i, graph.time(i));
+
+	progress.finish(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+	return complete;
+}
 
-	colors.push_back(glm::vec3(0.2, 0.2, 1));
-	colors.push_back(glm::vec3(0.2, 0.2, 1));
-	colors.push_back(glm::vec3(0.2, 0.2, 1));
+void print_terrain_times(const terrain_progress& progress)
+{
+	for (int i = 0; i < STAGE_COUNT; i++)
+		printf("%s: %f sec\n", stage_names[i], progress.stage_time((terrain_stage)i));
+	if (progress.stage_count(STAGE_EROSION) > 0 && progress.stage_time(STAGE_EROSION) > 0)
+		printf("%d droplets, %.0f droplets/sec\n", progress.stage_count(STAGE_EROSION), progress.stage_count(STAGE_EROSION) / progress.stage_time(STAGE_EROSION));
+	if (progress.stage_count(STAGE_THERMAL) > 0 && progress.stage_time(STAGE_THERMAL) > 0)
+		printf("%d thermal passes, %.0f passes/sec\n", progress.stage_count(STAGE_THERMAL), progress.stage_count(STAGE_THERMAL) / progress.stage_time(STAGE_THERMAL));
+	if (progress.stage_count(STAGE_FEATURES) > 0)
+		printf("%d plants scattered\n", progress.stage_count(STAGE_FEATURES));
+	printf("total time = %f sec\n", progress.total_time());
+}
 
-	normals.push_back(glm::vec3(0, 1, 0));
-	normals.push_back(glm::vec3(0, 1, 0));
-	normals.push_back(glm::vec3(0, 1, 0));
+bool check_terrain_determinism(int size, int iterations, double amplitude, terrain_generator generator, uint64_t seed, const erosion_settings& erosion)
+{
+	struct determinism_run
+	{
+		unsigned int threads;
+		simd_level simd;
+	};
 
-	normals.push_back(glm::vec3(0, 1, 0));
-	normals.push_back(glm::vec3(0, 1, 0));
-	normals.push_back(glm::vec3(0, 1, 0));
+	// every thread count on the best SIMD path the CPU has, then the slower paths with all the threads
+	simd_level best = simd_detect();
+	std::vector<determinism_run> runs = { { 1, best }, { 4, best }, { 0, best } };
+	for (int level = best - 1; level >= SIMD_SCALAR; level--)
+		runs.push_back({ 0, (simd_level)level });
+
+	uint64_t first_hash = 0;
+	uint64_t first_normals_hash = 0;
+	bool identical = true;
+
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		simd_limit(runs[i].simd);
+		thread_pool pool(runs[i].threads);
+		heightfield<float> heights;
+		material_layer materials;
+		std::vector<glm::vec3> features, colors, normals;
+		terrain_progress progress;
+		cancel_token cancel;
+
+		generate_terrain(size, 1, iterations, amplitude, generator, seed, erosion, heights, materials, features, colors, normals, progress, cancel, pool);
+
+		// the terrain normals, made from the heights the way the game does while uploading
+		std::vector<glm::vec3> terrain_normals(heights.size());
+		pool.parallel_for(heights.size_x(), [&](int x)
+		{
+			sobel_normal_row(heights, 1, x, &terrain_normals[(size_t)x * heights.size_y()]);
+		});
+
+		uint64_t hash = heightfield_hash(heights);
+		uint64_t normals_hash = heightfield_hash_bytes(HEIGHTFIELD_HASH_START, terrain_normals.data(), terrain_normals.size() * sizeof(glm::vec3));
+		printf("\n%u threads, %s: heightmap hash %016llx, normals hash %016llx\n", pool.size(), simd_level_name(runs[i].simd), (unsigned long long)hash, (unsigned long long)normals_hash);
+
+		if (i == 0)
+		{
+			first_hash = hash;
+			first_normals_hash = normals_hash;
+		}
+		else if (hash != first_hash || normals_hash != first_normals_hash)
+			identical = false;
+	}
+	simd_limit(SIMD_AVX2);
 
-	printf("terrain output complete in t <= %f sec\n", difftime(time(0), step_time));
-	printf("total time = %f sec\n", difftime(time(0), start_time));
-	printf("water level: %f", water_level);
-	completion = 100;
+	printf(identical ? "terrain generation is deterministic\n" : "terrain generation depends on the thread count or the SIMD path!\n");
+	return identical;
 }
@@ -1,22 +1,128 @@
 #ifndef TERRAIN_GENERATION_DEF
-#define TERRAIN_GENRATION_DEF
+#define TERRAIN_GENERATION_DEF
 
 #include <time.h>
 #include <ctime>
 #include <cmath>
+#include <algorithm>
 #include <vector>
 #include <stdio.h>
 #include <thread>
-#include <random>
+#include <stdint.h>
 #include <internal/model.h>
+#include <internal/heightfield.h>
+#include <internal/thread_pool.h>
+#include <internal/task_graph.h>
+#include <internal/erosion.h>
+#include <internal/hydrology.h>
+#include <internal/compact_heightfield.h>
 #include <glm/glm.hpp>
 
+#define INIT_VALUE 0
+
+// side length of the square tiles the map is split into for parallel noise generation
+#define NOISE_TILE_SIZE 128
+
+// what the octaves of the map are made of
+enum terrain_generator
+{
+	GENERATOR_VALUE_NOISE, // random values on a lattice, upsampled with bilinear and B-spline interpolation
+	GENERATOR_SIMPLEX,     // simplex noise fbm, evaluated point by point
+	GENERATOR_RIDGED       // hills and ridged mountain ranges, warped, built with the noise graph
+};
+
+// steps of generate_terrain, in the order they are started in
+enum terrain_stage
+{
+	STAGE_NOISE,
+	STAGE_NORMALIZE,
+	STAGE_MASK,
+	STAGE_EROSION,
+	STAGE_THERMAL,
+	STAGE_HYDROLOGY,
+	STAGE_FEATURES,
+	STAGE_WATER,
+	STAGE_CLASSIFY,
+	STAGE_MESH,
+	STAGE_COUNT
+};
+
+const char* terrain_stage_name(terrain_stage stage);
+
+/*
+	progress of generate_terrain, updated by the generating threads and read by anyone else (the loading screen).
+	every stage counts its own units of work, and the percentage weighs each stage by roughly how long it takes
+*/
+class terrain_progress
+{
+public:
+	terrain_progress();
+
+	terrain_progress(const terrain_progress&) = delete;
+	terrain_progress& operator=(const terrain_progress&) = delete;
+
+	void reset();
+
+	// called by the generator
+	void begin(terrain_stage stage, int total);
+	void advance(terrain_stage stage, int amount = 1);
+	void complete(terrain_stage stage, double seconds);
+	void finish(double seconds);
+
+	// 0 to 100
+	int percentage() const;
+
+	// true once generation has stopped, whether it completed or was cancelled
+	bool finished() const { return done.load(std::memory_order_acquire); }
+
+	// wall time of a stage and of the whole generation in seconds, valid once finished() is true.
+	// stages that run at the same time overlap, so the stages can add up to more than the total
+	double stage_time(terrain_stage stage) const { return times[stage]; }
+	double total_time() const { return total; }
+
+	// units of work a stage did (droplets for STAGE_EROSION), valid once finished() is true
+	int stage_count(terrain_stage stage) const { return counts[stage]; }
+
+private:
+	std::atomic<int> stage_done[STAGE_COUNT];
+	std::atomic<int> stage_total[STAGE_COUNT];
+	double times[STAGE_COUNT];
+	int counts[STAGE_COUNT];
+	double total;
+	std::atomic<bool> done;
+};
+
 int round_down(int n, int m);
 double bilinear_interpolation(double v1, double v2, double v3, double v4, double x1, double x2, double y1, double y2, double x, double y);
-std::vector<std::vector<double>> bicubic_interpolation(std::vector<std::vector<double>> h, int gap);
-void noise(int size, std::vector<std::vector<double>>& map, double amplitude, int frequency);
-void generate_terrain(int size, int iterations, double amplitude, std::vector<std::vector<glm::vec3>>& vertices, std::vector<glm::vec3>& colors, std::vector<glm::vec3>& normals, int& completion);
 
-#endif // !TERRAIN_GENERATION_DEF
+// number of octaves octave_noise sums for a map of size points, iterations 0 meaning as many as fit
+int noise_octave_count(int size, int iterations);
+
+// fill map with value noise made of octaves with increasing frequency and amplitude, for a size x size island
+// sampled every step points (size / step x size / step, step a power of 2).
+// reports to STAGE_NOISE of progress and stops early if cancel is set
+void octave_noise(int size, int step, int iterations, double amplitude, terrain_generator generator, uint64_t seed, heightfield<double>& map, terrain_progress& progress, const cancel_token& cancel, thread_pool& pool);
 
-#define INIT_VALUE 0
\ No newline at end of file
+// add the heights of GENERATOR_RIDGED onto a block of the map, like simplex_fbm_block. in about the same range
+// as the other generators, [0, amplitude * size / 2]
+void ridged_island_block(int size, int octaves, double amplitude, uint64_t seed, int step, int x0, int x1, int y0, int y1, double* out, int pitch);
+
+// heights receives the final size / step x size / step heightmap and materials what its points are made of,
+// features the vertices of everything on top of it (trees, water) with one entry in colors and normals for each.
+// the terrain normals are left to the caller, sobel_normal_row makes them from the heights.
+// a step above 1 gives a quick, coarser version of the same island: the points are step apart in the world and
+// only the octaves that are coarser than that are interpolated.
+// erosion is run over the island after the mask, its droplets are for the full size island and a step above 1
+// runs step * step times fewer. rivers are then cut along where the water drains, and hollows fill into lakes.
+// the same seed always gives the same island, whatever the size of the pool.
+// returns false if cancel was set before the island was done, the outputs are then incomplete
+bool generate_terrain(int size, int step, int iterations, double amplitude, terrain_generator generator, uint64_t seed, const erosion_settings& erosion, heightfield<float>& heights, material_layer& materials, std::vector<glm::vec3>& features, std::vector<glm::vec3>& colors, std::vector<glm::vec3>& normals, terrain_progress& progress, const cancel_token& cancel, thread_pool& pool);
+
+// print how long every stage took and how fast the droplets ran, once progress is finished
+void print_terrain_times(const terrain_progress& progress);
+
+// generate the same island with 1, 4 and as many threads as the machine has, then with every slower SIMD path
+// the CPU has, and compare the hashes of the heightmaps and normals
+bool check_terrain_determinism(int size, int iterations, double amplitude, terrain_generator generator, uint64_t seed, const erosion_settings& erosion);
+
+#endif // !TERRAIN_GENERATION_DEF
@@ -0,0 +1,48 @@
+#ifndef TERRAIN_RANDOM_DEF
+#define TERRAIN_RANDOM_DEF
+
+#include <stdint.h>
+
+/*
+	stateless, counter based random numbers. a value is a hash of the island seed, a stream (what the number
+	is used for) and the grid position it is used at, so the same seed always gives the same island no matter
+	which thread, tile or order anything is generated in.
+*/
+
+// streams 0 .. RANDOM_STREAM_OCTAVES - 1 are the lattices of the value noise octaves
+enum random_stream
+{
+	RANDOM_STREAM_OCTAVES = 64,
+	RANDOM_STREAM_SIMPLEX = RANDOM_STREAM_OCTAVES,
+	RANDOM_STREAM_SCATTER_X,
+	RANDOM_STREAM_SCATTER_Z,
+	RANDOM_STREAM_ISLAND_X,
+	RANDOM_STREAM_ISLAND_Z,
+	RANDOM_STREAM_DROPLET_X,
+	RANDOM_STREAM_DROPLET_Y,
+	RANDOM_STREAM_SCATTER_ROTATION,
+	RANDOM_STREAM_SCATTER_SCALE,
+	RANDOM_STREAM_RAYS
+};
+
+// splitmix64 finalizer
+inline uint64_t random_mix(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+inline uint64_t random_hash(uint64_t seed, uint32_t stream, int32_t x, int32_t y)
+{
+	uint64_t h = random_mix(seed + 0x9e3779b97f4a7c15ull * ((uint64_t)stream + 1));
+	return random_mix(h ^ (((uint64_t)(uint32_t)x << 32) | (uint32_t)y));
+}
+
+// uniform double in [0, 1)
+inline double random_double(uint64_t seed, uint32_t stream, int32_t x, int32_t y)
+{
+	return (random_hash(seed, stream, x, y) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+#endif // !TERRAIN_RANDOM_DEF
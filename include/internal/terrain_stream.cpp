@@ -0,0 +1,236 @@
+#include <internal/terrain_stream.h>
+#include <cmath>
+#include <algorithm>
+
+// x and z of a chunk key
+static int key_x(uint64_t key) { return (int)(uint32_t)(key >> 32); }
+static int key_z(uint64_t key) { return (int)(uint32_t)key; }
+
+terrain_stream::terrain_stream(const chunk_settings& settings, float view_radius, size_t cache_bytes, thread_pool& pool)
+	: settings(settings), view_radius(view_radius), pool(pool), cache(cache_bytes), stopping(false)
+{
+	worker = std::thread(&terrain_stream::worker_loop, this);
+}
+
+terrain_stream::~terrain_stream()
+{
+	stop();
+}
+
+void terrain_stream::stop()
+{
+	if (!worker.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	work_available.notify_all();
+	worker.join();
+
+	for (std::unordered_map<uint64_t, gpu_chunk>::iterator i = resident.begin(); i != resident.end(); i++)
+	{
+		glDeleteBuffers(1, &i->second.vertex_buffer);
+		glDeleteBuffers(1, &i->second.color_buffer);
+		glDeleteBuffers(1, &i->second.normal_buffer);
+		glDeleteBuffers(1, &i->second.index_buffer);
+	}
+	resident.clear();
+}
+
+float terrain_stream::chunk_distance(int cx, int cz, float x, float z) const
+{
+	float size = (float)settings.chunk_size;
+	float dx = std::max(std::max(cx * size - x, x - (cx + 1) * size), 0.0f);
+	float dz = std::max(std::max(cz * size - z, z - (cz + 1) * size), 0.0f);
+	return sqrt(dx * dx + dz * dz);
+}
+
+void terrain_stream::worker_loop()
+{
+	for (;;)
+	{
+		// take as many of the nearest requests as the pool has threads
+		std::vector<uint64_t> batch;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			work_available.wait(lock, [this]() { return stopping || !requests.empty(); });
+			if (stopping) return;
+
+			size_t count = std::min(requests.size(), (size_t)pool.size());
+			batch.assign(requests.begin(), requests.begin() + count);
+			requests.erase(requests.begin(), requests.begin() + count);
+			working.insert(batch.begin(), batch.end());
+		}
+
+		// generate what isn't cached, a chunk per job, then mesh all of them
+		std::vector<chunk_mesh> meshes(batch.size());
+		std::vector<std::shared_ptr<terrain_chunk>> generated(batch.size());
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			meshes[i].chunk = cache.find(key_x(batch[i]), key_z(batch[i]));
+			if (!meshes[i].chunk)
+				generated[i] = std::make_shared<terrain_chunk>();
+		}
+
+		// a pool of one runs the jobs here, so the rows of a chunk only go in parallel then
+		thread_pool single(1);
+		pool.parallel_for((int)batch.size(), [&](int i)
+		{
+			if (generated[i])
+				generate_chunk(settings, key_x(batch[i]), key_z(batch[i]), *generated[i], single);
+		});
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			if (generated[i])
+			{
+				meshes[i].chunk = generated[i];
+				cache.insert(generated[i]);
+			}
+		}
+
+		pool.parallel_for((int)batch.size(), [&](int i)
+		{
+			build_chunk_mesh(settings, *meshes[i].chunk, meshes[i].vertices, meshes[i].colors, meshes[i].normals, meshes[i].indices);
+		});
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			working.erase(batch[i]);
+			finished.push_back(std::move(meshes[i]));
+		}
+	}
+}
+
+void terrain_stream::upload(const chunk_mesh& mesh)
+{
+	gpu_chunk chunk;
+	chunk.chunk = mesh.chunk;
+	chunk.count = (GLsizei)mesh.indices.size();
+	size_t bytes = mesh.vertices.size() * sizeof(glm::vec3);
+
+	glGenBuffers(1, &chunk.vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, chunk.vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, bytes, &mesh.vertices[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &chunk.color_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, chunk.color_buffer);
+	glBufferData(GL_ARRAY_BUFFER, bytes, &mesh.colors[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &chunk.normal_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, chunk.normal_buffer);
+	glBufferData(GL_ARRAY_BUFFER, bytes, &mesh.normals[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &chunk.index_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.index_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), &mesh.indices[0], GL_STATIC_DRAW);
+
+	resident[chunk_key(mesh.chunk->x, mesh.chunk->z)] = chunk;
+}
+
+void terrain_stream::update(const glm::vec3& camera)
+{
+	float size = (float)settings.chunk_size;
+	float keep_radius = view_radius + size;
+
+	// free the GPU buffers of chunks that are well out of range
+	for (std::unordered_map<uint64_t, gpu_chunk>::iterator i = resident.begin(); i != resident.end();)
+	{
+		if (chunk_distance(key_x(i->first), key_z(i->first), camera.x, camera.z) > keep_radius)
+		{
+			glDeleteBuffers(1, &i->second.vertex_buffer);
+			glDeleteBuffers(1, &i->second.color_buffer);
+			glDeleteBuffers(1, &i->second.normal_buffer);
+			glDeleteBuffers(1, &i->second.index_buffer);
+			i = resident.erase(i);
+		}
+		else
+			i++;
+	}
+
+	std::vector<chunk_mesh> ready;
+	bool requested;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// upload the first few that are done, the rest wait for the next frames
+		size_t count = std::min(finished.size(), (size_t)CHUNK_UPLOADS_PER_FRAME);
+		ready.insert(ready.end(), std::make_move_iterator(finished.begin()), std::make_move_iterator(finished.begin() + count));
+		finished.erase(finished.begin(), finished.begin() + count);
+
+		// everything in range that isn't on the GPU or on its way, nearest first
+		std::unordered_set<uint64_t> pending(working);
+		for (std::vector<chunk_mesh>::const_iterator i = finished.begin(); i != finished.end(); i++)
+			pending.insert(chunk_key(i->chunk->x, i->chunk->z));
+		for (std::vector<chunk_mesh>::const_iterator i = ready.begin(); i != ready.end(); i++)
+			pending.insert(chunk_key(i->chunk->x, i->chunk->z));
+
+		std::vector<std::pair<float, uint64_t>> wanted;
+		int first_x = (int)floor((camera.x - view_radius) / size);
+		int last_x = (int)floor((camera.x + view_radius) / size);
+		int first_z = (int)floor((camera.z - view_radius) / size);
+		int last_z = (int)floor((camera.z + view_radius) / size);
+		for (int x = first_x; x <= last_x; x++)
+		{
+			for (int z = first_z; z <= last_z; z++)
+			{
+				float distance = chunk_distance(x, z, camera.x, camera.z);
+				uint64_t key = chunk_key(x, z);
+				if (distance <= view_radius && resident.find(key) == resident.end() && pending.find(key) == pending.end())
+					wanted.push_back(std::make_pair(distance, key));
+			}
+		}
+		std::sort(wanted.begin(), wanted.end());
+
+		requests.clear();
+		for (std::vector<std::pair<float, uint64_t>>::const_iterator i = wanted.begin(); i != wanted.end(); i++)
+			requests.push_back(i->second);
+		requested = !requests.empty();
+	}
+	if (requested)
+		work_available.notify_one();
+
+	// the camera may have moved on while they were generated
+	for (std::vector<chunk_mesh>::const_iterator i = ready.begin(); i != ready.end(); i++)
+		if (chunk_distance(i->chunk->x, i->chunk->z, camera.x, camera.z) <= keep_radius)
+			upload(*i);
+}
+
+void terrain_stream::draw() const
+{
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	for (std::unordered_map<uint64_t, gpu_chunk>::const_iterator i = resident.begin(); i != resident.end(); i++)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, i->second.vertex_buffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+		glBindBuffer(GL_ARRAY_BUFFER, i->second.color_buffer);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+		glBindBuffer(GL_ARRAY_BUFFER, i->second.normal_buffer);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, i->second.index_buffer);
+		glDrawElements(GL_TRIANGLES, i->second.count, GL_UNSIGNED_INT, (void*)0);
+	}
+
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+}
+
+bool terrain_stream::ground_height(float x, float z, float& height) const
+{
+	float size = (float)settings.chunk_size;
+	std::unordered_map<uint64_t, gpu_chunk>::const_iterator found = resident.find(chunk_key((int)floor(x / size), (int)floor(z / size)));
+	if (found == resident.end())
+		return false;
+
+	height = chunk_height(settings, *found->second.chunk, x, z);
+	return true;
+}
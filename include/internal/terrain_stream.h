@@ -0,0 +1,96 @@
+#ifndef TERRAIN_STREAM_DEF
+#define TERRAIN_STREAM_DEF
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glad/glad.h>
+#include <internal/terrain_chunks.h>
+
+// chunks uploaded to the GPU per frame at most, so walking into new terrain doesn't stall a frame
+#define CHUNK_UPLOADS_PER_FRAME 4
+
+/*
+	keeps the chunks around the camera generated and on the GPU. chunks within view_radius of the camera are
+	requested nearest first and generated and meshed on a background thread (using the pool), then uploaded by
+	update() on the thread that owns the GL context. chunks further than a chunk past the view radius have their
+	buffers deleted; their heights stay in the chunk cache until it runs out of room.
+*/
+class terrain_stream
+{
+public:
+	terrain_stream(const chunk_settings& settings, float view_radius, size_t cache_bytes, thread_pool& pool);
+	~terrain_stream();
+
+	terrain_stream(const terrain_stream&) = delete;
+	terrain_stream& operator=(const terrain_stream&) = delete;
+
+	// call once per frame before drawing
+	void update(const glm::vec3& camera);
+
+	// draw every chunk on the GPU, with the positions, colors and normals in attributes 0, 1 and 2
+	void draw() const;
+
+	// stop generating and free the GPU buffers, while the GL context is still there. called by the destructor
+	// if it wasn't before
+	void stop();
+
+	// height of the ground at x, z, false if that chunk isn't loaded yet
+	bool ground_height(float x, float z, float& height) const;
+
+	size_t loaded_chunks() const { return resident.size(); }
+
+private:
+	// generated and meshed chunk, waiting to be uploaded
+	struct chunk_mesh
+	{
+		std::shared_ptr<const terrain_chunk> chunk;
+		std::vector<glm::vec3> vertices;
+		std::vector<glm::vec3> colors;
+		std::vector<glm::vec3> normals;
+		std::vector<uint32_t> indices;
+	};
+
+	// chunk on the GPU
+	struct gpu_chunk
+	{
+		std::shared_ptr<const terrain_chunk> chunk;
+		GLuint vertex_buffer;
+		GLuint color_buffer;
+		GLuint normal_buffer;
+		GLuint index_buffer;
+		GLsizei count;
+	};
+
+	void worker_loop();
+	void upload(const chunk_mesh& mesh);
+
+	// distance from x, z to the closest point of chunk cx, cz
+	float chunk_distance(int cx, int cz, float x, float z) const;
+
+	chunk_settings settings;
+	float view_radius;
+	thread_pool& pool;
+
+	// only used by the GL thread
+	std::unordered_map<uint64_t, gpu_chunk> resident;
+
+	// only used by the background thread
+	chunk_cache cache;
+
+	// shared, guarded by mutex. requests are replaced every update, so chunks that fell out of range before
+	// they were started are never generated
+	std::mutex mutex;
+	std::condition_variable work_available;
+	std::vector<uint64_t> requests;
+	std::unordered_set<uint64_t> working;
+	std::vector<chunk_mesh> finished;
+	bool stopping;
+
+	std::thread worker;
+};
+
+#endif // !TERRAIN_STREAM_DEF
@@ -0,0 +1,177 @@
+#include <internal/terrain_tiles.h>
+#include <internal/upsample.h>
+#include <internal/simplex_noise.h>
+#include <internal/terrain_random.h>
+#include <internal/heightfield_ops.h>
+
+// rounds towards negative infinity, for the lattice cells of points left of or above the island
+static int floor_div(int a, int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+terrain_tile_plan plan_terrain_tiles(int size, int tile_size, int iterations, double amplitude, terrain_generator generator, uint64_t seed, thread_pool& pool)
+{
+	terrain_tile_plan plan;
+	plan.size = size;
+	plan.tile_size = tile_size;
+	plan.octaves = noise_octave_count(size, iterations);
+	plan.amplitude = amplitude;
+	plan.generator = generator;
+	plan.seed = seed;
+
+	// about 256 points per side is plenty to estimate the heights of the island
+	int step = 1;
+	while (size / step > 256 && size % (step * 2) == 0)
+		step *= 2;
+
+	heightfield<double> map;
+	heightfield<float> heights;
+	terrain_progress progress;
+	cancel_token cancel;
+	octave_noise(size, step, iterations, amplitude, generator, seed, map, progress, cancel, pool);
+
+	// the same as the normalize and mask stages of generate_terrain
+	heightfield_stats stats = heightfield_statistics(map, pool);
+	plan.offset = std::min(stats.min, (double)(size / 2));
+	plan.mask_height = std::max(std::max(stats.max, 0.0), stats.max + plan.offset);
+
+	double max_width = size / 2;
+	double min_width = size / 8;
+	stats = island_mask(map, step, plan.offset, min_width, max_width, plan.mask_height, heights, pool);
+	plan.water_level = (stats.average() * 2 + std::max(stats.max, 0.0)) / 3;
+
+	return plan;
+}
+
+// the window of one value noise octave a tile needs
+struct tile_octave
+{
+	// points of the island between lattice points
+	int spacing;
+
+	// global lattice coordinates of lattice[0][0]
+	int origin_x;
+	int origin_y;
+
+	// random values, or their B-spline coefficients when spacing is above 4
+	heightfield<double> lattice;
+};
+
+// lattice window of octave index covering island points [x0, x1) x [y0, y1)
+static void prepare_tile_octave(const terrain_tile_plan& plan, int index, int x0, int x1, int y0, int y1, tile_octave& octave)
+{
+	int spacing = 1 << index;
+	double amplitude = pow(2, index) * plan.amplitude;
+	octave.spacing = spacing;
+
+	// bilinear needs the lattice points up to the one after the last point, the B-spline one more on each side
+	// plus the border of the prefilter
+	int before = spacing > 4 ? 1 : 0;
+	int after = spacing == 1 ? 1 : spacing <= 4 ? 2 : 3;
+	int border = spacing > 4 ? BSPLINE_FIR_RADIUS : 0;
+
+	octave.origin_x = floor_div(x0, spacing) - before;
+	octave.origin_y = floor_div(y0, spacing) - before;
+	int sx = floor_div(x1 - 1, spacing) + after - octave.origin_x;
+	int sy = floor_div(y1 - 1, spacing) + after - octave.origin_y;
+
+	heightfield<double> samples(sx + 2 * border, sy + 2 * border);
+	for (int i = 0; i < samples.size_x(); i++)
+		for (int j = 0; j < samples.size_y(); j++)
+			samples[i][j] = random_double(plan.seed, index, octave.origin_x - border + i, octave.origin_y - border + j) * amplitude;
+
+	if (border > 0)
+		bspline_prefilter_window(samples, octave.lattice);
+	else
+		octave.lattice = std::move(samples);
+}
+
+// add an octave onto island points [x0, x1) x [y0, y1), block[(x - x0) * (y1 - y0) + (y - y0)]
+static void sample_tile_octave(const tile_octave& octave, int x0, int x1, int y0, int y1, double* block)
+{
+	int pitch = y1 - y0;
+
+	// the kernels count from the start of the lattice window, which is on a lattice point, so every
+	// point keeps its place inside its lattice cell
+	int lx0 = x0 - octave.origin_x * octave.spacing;
+	int ly0 = y0 - octave.origin_y * octave.spacing;
+
+	if (octave.spacing == 1)
+	{
+		for (int x = 0; x < x1 - x0; x++)
+			for (int y = 0; y < pitch; y++)
+				block[x * pitch + y] += octave.lattice[lx0 + x][ly0 + y];
+	}
+	else if (octave.spacing <= 4)
+		bilinear_upsample(octave.lattice, octave.spacing, lx0, lx0 + x1 - x0, ly0, ly0 + pitch, block, pitch);
+	else
+		bspline_upsample(octave.lattice, octave.spacing, lx0, lx0 + x1 - x0, ly0, ly0 + pitch, block, pitch);
+}
+
+void generate_terrain_tile(const terrain_tile_plan& plan, int x, int y, terrain_tile& tile, thread_pool& pool)
+{
+	int points = plan.tile_size + 1 + 2 * TILE_HALO;
+	int x0 = x * plan.tile_size - TILE_HALO;
+	int y0 = y * plan.tile_size - TILE_HALO;
+
+	tile.x = x;
+	tile.y = y;
+	tile.heights.resize(points, points);
+
+	std::vector<tile_octave> octaves;
+	if (plan.generator == GENERATOR_VALUE_NOISE)
+	{
+		octaves.resize(plan.octaves);
+		pool.parallel_for(plan.octaves, [&](int i)
+		{
+			prepare_tile_octave(plan, i, x0, x0 + points, y0, y0 + points, octaves[i]);
+		});
+	}
+
+	fbm_settings fbm;
+	fbm.seed = (uint32_t)random_hash(plan.seed, RANDOM_STREAM_SIMPLEX, 0, 0);
+	fbm.octaves = plan.octaves;
+	fbm.period = 1;
+	fbm.amplitude = plan.amplitude;
+	fbm.period_scale = 2;
+	fbm.amplitude_scale = 2;
+
+	double center = plan.size / 2;
+	double max_width = plan.size / 2;
+	double min_width = plan.size / 8;
+
+	// bands of rows, each summing the octaves in order and applying the mask of island_mask
+	int bands = (points + HEIGHTFIELD_BLOCK_ROWS - 1) / HEIGHTFIELD_BLOCK_ROWS;
+	pool.parallel_for(bands, [&](int b)
+	{
+		int bx0 = x0 + b * HEIGHTFIELD_BLOCK_ROWS;
+		int bx1 = std::min(bx0 + HEIGHTFIELD_BLOCK_ROWS, x0 + points);
+
+		std::vector<double> block((size_t)(bx1 - bx0) * points, INIT_VALUE);
+		if (plan.generator == GENERATOR_SIMPLEX)
+			simplex_fbm_block(fbm, bx0, bx1, y0, y0 + points, &block[0], points);
+		else if (plan.generator == GENERATOR_RIDGED)
+			ridged_island_block(plan.size, plan.octaves, plan.amplitude, plan.seed, 1, bx0, bx1, y0, y0 + points, &block[0], points);
+		else
+			for (std::vector<tile_octave>::const_iterator octave = octaves.begin(); octave != octaves.end(); octave++)
+				sample_tile_octave(*octave, bx0, bx1, y0, y0 + points, &block[0]);
+
+		for (int i = bx0; i < bx1; i++)
+		{
+			const double* row = &block[(size_t)(i - bx0) * points];
+			float* out = tile.heights[i - x0];
+			double x_dist = center - i;
+
+			for (int j = 0; j < points; j++)
+			{
+				double y_dist = center - (y0 + j);
+				double dist = sqrt(x_dist * x_dist + y_dist * y_dist) - min_width;
+				dist = dist > 0.0 ? dist : 0.0;
+				double factor = dist * plan.mask_height / (max_width - min_width);
+
+				out[j] = (float)((row[j] + plan.offset) - factor / 2);
+			}
+		}
+	});
+}
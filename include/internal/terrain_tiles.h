@@ -0,0 +1,60 @@
+#ifndef TERRAIN_TILES_DEF
+#define TERRAIN_TILES_DEF
+
+#include <stdint.h>
+#include <internal/terrain_generation.h>
+
+/*
+	an island cut into square tiles that can be generated independently, on different threads, processes or
+	machines, and put back together without seams. a tile only needs the plan of the island and its own
+	coordinates: the noise lattices are hashed from global lattice coordinates without wrapping around, the
+	B-spline octaves use a fixed size prefilter window instead of one over the whole lattice, and the island
+	mask works in global coordinates. every point is computed the same way whichever tile it is in, so the
+	points neighbouring tiles share are bit-identical.
+
+	tiled islands follow the same recipe as generate_terrain, but aren't the same island for a seed: the whole
+	map lattices wrap around or mirror at the edges of the map, and the coarsest octaves only have a few lattice
+	points, so that changes them everywhere.
+*/
+
+// extra points around a tile, for interpolation and for the normals of its edge vertices
+#define TILE_HALO 1
+
+// what every tile of an island shares. the heights of the whole island are needed to normalize it, so those
+// numbers are estimated once from a quick coarse pass and handed to every tile job
+struct terrain_tile_plan
+{
+	int size;
+	int tile_size;
+	int octaves;
+	double amplitude;
+	terrain_generator generator;
+	uint64_t seed;
+
+	double offset;
+	double mask_height;
+	double water_level;
+};
+
+// plan an island of size x size points cut into tiles of tile_size x tile_size cells
+terrain_tile_plan plan_terrain_tiles(int size, int tile_size, int iterations, double amplitude, terrain_generator generator, uint64_t seed, thread_pool& pool);
+
+// tiles per side of the island
+inline int terrain_tile_count(const terrain_tile_plan& plan) { return (plan.size + plan.tile_size - 1) / plan.tile_size; }
+
+struct terrain_tile
+{
+	int x;
+	int y;
+
+	// tile_size + 1 + 2 * TILE_HALO points per side, point (i, j) is point
+	// (x * tile_size + i - TILE_HALO, y * tile_size + j - TILE_HALO) of the island. the last row and column
+	// of a tile are the first ones of the next tile. the halo of the tiles on the edge of the island lies
+	// outside of it and continues the terrain
+	heightfield<float> heights;
+};
+
+// generate tile x, y of the island. rows of the tile are handed out to the pool
+void generate_terrain_tile(const terrain_tile_plan& plan, int x, int y, terrain_tile& tile, thread_pool& pool);
+
+#endif // !TERRAIN_TILES_DEF
@@ -0,0 +1,98 @@
+#include <internal/thread_pool.h>
+
+thread_pool::thread_pool(unsigned int threads) : stopping(false)
+{
+	if (threads == 0) threads = std::thread::hardware_concurrency();
+	if (threads == 0) threads = 1;
+
+	for (unsigned int i = 1; i < threads; i++)
+		workers.push_back(std::thread(&thread_pool::worker_loop, this));
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	task_available.notify_all();
+
+	for (std::vector<std::thread>::iterator i = workers.begin(); i != workers.end(); i++)
+		i->join();
+}
+
+void thread_pool::worker_loop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		task_available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+		if (tasks.empty()) return; // only happens when stopping
+
+		std::function<void()> task = std::move(tasks.front());
+		tasks.pop_front();
+
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
+
+void thread_pool::parallel_for(int count, const std::function<void(int)>& job)
+{
+	if (count <= 0) return;
+
+	// every thread (the caller included) keeps taking the next index until there are none left
+	std::atomic<int> next(0);
+	auto run = [&]()
+	{
+		for (int i = next++; i < count; i = next++)
+			job(i);
+	};
+
+	// no point waking more workers than there are jobs
+	int helpers = (int)workers.size() < count - 1 ? (int)workers.size() : count - 1;
+	int finished = 0;
+	std::condition_variable helper_done;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int i = 0; i < helpers; i++)
+		{
+			tasks.push_back([&]()
+			{
+				run();
+				std::lock_guard<std::mutex> lock(mutex);
+				finished++;
+				helper_done.notify_all();
+			});
+		}
+	}
+	task_available.notify_all();
+
+	run();
+
+	// the helpers reference this stack frame, so wait for all of them to finish.
+	// queued tasks are run here instead of just waiting, so nested parallel_for calls can't deadlock
+	std::unique_lock<std::mutex> lock(mutex);
+	while (finished < helpers)
+	{
+		if (!tasks.empty())
+		{
+			std::function<void()> task = std::move(tasks.front());
+			tasks.pop_front();
+
+			lock.unlock();
+			task();
+			lock.lock();
+		}
+		else
+			helper_done.wait(lock);
+	}
+}
+
+thread_pool& thread_pool::global()
+{
+	static thread_pool pool;
+	return pool;
+}
@@ -0,0 +1,68 @@
+#ifndef THREAD_POOL_DEF
+#define THREAD_POOL_DEF
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	fixed set of worker threads that parallel work is handed to, instead of starting a thread per job.
+	the thread calling parallel_for() works on the jobs too, so a pool of size n has n - 1 workers
+	and a pool of size 1 runs everything on the calling thread.
+*/
+class thread_pool
+{
+public:
+	// threads = 0 sizes the pool to the machine
+	explicit thread_pool(unsigned int threads = 0);
+	~thread_pool();
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	// total number of threads working on a parallel_for, including the caller
+	unsigned int size() const { return (unsigned int)workers.size() + 1; }
+
+	// run job(i) for every i in [0, count) across the pool and wait until all of them are done.
+	// jobs are handed out in order, but may finish in any order
+	void parallel_for(int count, const std::function<void(int)>& job);
+
+	// split [0, count) into blocks of block_size, reduce every block with job(begin, end) in parallel and
+	// combine the partial results in block order. the blocks don't depend on the number of threads,
+	// so neither does the result, even for floating point sums
+	template <typename T, typename Job, typename Combine>
+	T parallel_reduce(int count, int block_size, const T& identity, Job job, Combine combine)
+	{
+		int blocks = (count + block_size - 1) / block_size;
+		std::vector<T> partial(blocks, identity);
+		parallel_for(blocks, [&](int b)
+		{
+			int begin = b * block_size;
+			int end = begin + block_size < count ? begin + block_size : count;
+			partial[b] = job(begin, end);
+		});
+
+		T result = identity;
+		for (int b = 0; b < blocks; b++)
+			result = combine(result, partial[b]);
+		return result;
+	}
+
+	// pool shared by everything that doesn't ask for a specific thread count
+	static thread_pool& global();
+
+private:
+	void worker_loop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable task_available;
+	bool stopping;
+};
+
+#endif // !THREAD_POOL_DEF
@@ -0,0 +1,484 @@
+#include <internal/upsample.h>
+#include <cmath>
+#include <vector>
+
+/*
+	bilinear upsampling is done one output row at a time. the two lattice rows around the output row are
+	blended into r first (one value per lattice column), then r is stretched along the row:
+
+	out[y] += r[k] + (r[k + 1] - r[k]) * t,   k = y / factor - j0,   t = (y % factor) / factor
+
+	every path does exactly these operations, so they all give the same bits.
+*/
+
+typedef void(*bilinear_row_func)(const double* l0, const double* l1, double fx, int s, int factor, int y0, int y1, double* r, double* out);
+
+// blend lattice rows l0 and l1 for columns j0 .. j0 + n - 1, column s wraps around to 0
+static inline void lerp_rows_scalar(const double* l0, const double* l1, double fx, int s, int j0, int k, int n, double* r)
+{
+	for (; k < n; k++)
+	{
+		int j = j0 + k < s ? j0 + k : j0 + k - s;
+		r[k] = l0[j] + (l1[j] - l0[j]) * fx;
+	}
+}
+
+static inline void stretch_scalar(const double* r, int factor, int j0, int y0, int y, int y1, double* out)
+{
+	for (; y < y1; y++)
+	{
+		int k = y / factor - j0;
+		double t = (double)(y % factor) / factor;
+		out[y - y0] += r[k] + (r[k + 1] - r[k]) * t;
+	}
+}
+
+static void bilinear_row_scalar(const double* l0, const double* l1, double fx, int s, int factor, int y0, int y1, double* r, double* out)
+{
+	int j0 = y0 / factor;
+	lerp_rows_scalar(l0, l1, fx, s, j0, 0, (y1 - 1) / factor - j0 + 2, r);
+	stretch_scalar(r, factor, j0, y0, y0, y1, out);
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET_SSE2 static void bilinear_row_sse2(const double* l0, const double* l1, double fx, int s, int factor, int y0, int y1, double* r, double* out)
+{
+	int j0 = y0 / factor;
+	int n = (y1 - 1) / factor - j0 + 2;
+
+	// blend the lattice rows, the columns past the far edge wrap around and are done one by one
+	int k = 0;
+	__m128d vfx = _mm_set1_pd(fx);
+	for (; k + 2 <= n && j0 + k + 2 <= s; k += 2)
+	{
+		__m128d a = _mm_loadu_pd(l0 + j0 + k);
+		__m128d b = _mm_loadu_pd(l1 + j0 + k);
+		_mm_storeu_pd(r + k, _mm_add_pd(a, _mm_mul_pd(_mm_sub_pd(b, a), vfx)));
+	}
+	lerp_rows_scalar(l0, l1, fx, s, j0, k, n, r);
+
+	// stretch whole lattice cells at a time, two outputs per instruction
+	int y = y0;
+	while (y < y1 && y % factor != 0)
+		y++;
+	stretch_scalar(r, factor, j0, y0, y0, y, out);
+
+	if (factor % 2 == 0)
+	{
+		for (; y + factor <= y1; y += factor)
+		{
+			int c = y / factor - j0;
+			__m128d a = _mm_set1_pd(r[c]);
+			__m128d d = _mm_set1_pd(r[c + 1] - r[c]);
+			for (int p = 0; p < factor; p += 2)
+			{
+				__m128d t = _mm_div_pd(_mm_setr_pd(p, p + 1), _mm_set1_pd(factor));
+				double* o = out + (y + p - y0);
+				_mm_storeu_pd(o, _mm_add_pd(_mm_loadu_pd(o), _mm_add_pd(a, _mm_mul_pd(d, t))));
+			}
+		}
+	}
+	stretch_scalar(r, factor, j0, y0, y, y1, out);
+}
+
+SIMD_TARGET_AVX2 static void bilinear_row_avx2(const double* l0, const double* l1, double fx, int s, int factor, int y0, int y1, double* r, double* out)
+{
+	int j0 = y0 / factor;
+	int n = (y1 - 1) / factor - j0 + 2;
+
+	// blend the lattice rows, the columns past the far edge wrap around and are done one by one
+	int k = 0;
+	__m256d vfx = _mm256_set1_pd(fx);
+	for (; k + 4 <= n && j0 + k + 4 <= s; k += 4)
+	{
+		__m256d a = _mm256_loadu_pd(l0 + j0 + k);
+		__m256d b = _mm256_loadu_pd(l1 + j0 + k);
+		_mm256_storeu_pd(r + k, _mm256_add_pd(a, _mm256_mul_pd(_mm256_sub_pd(b, a), vfx)));
+	}
+	lerp_rows_scalar(l0, l1, fx, s, j0, k, n, r);
+
+	int y = y0;
+	while (y < y1 && y % factor != 0)
+		y++;
+	stretch_scalar(r, factor, j0, y0, y0, y, out);
+
+	if (factor == 2)
+	{
+		// two lattice cells per instruction: {r[c], r[c], r[c + 1], r[c + 1]} + {d[c], d[c], d[c + 1], d[c + 1]} * {0, 0.5, 0, 0.5}
+		const __m256d t = _mm256_setr_pd(0.0, 0.5, 0.0, 0.5);
+		for (; y + 4 <= y1; y += 4)
+		{
+			int c = y / 2 - j0;
+			__m128d a = _mm_loadu_pd(r + c);
+			__m128d d = _mm_sub_pd(_mm_loadu_pd(r + c + 1), a);
+			__m256d va = _mm256_permute4x64_pd(_mm256_castpd128_pd256(a), _MM_SHUFFLE(1, 1, 0, 0));
+			__m256d vd = _mm256_permute4x64_pd(_mm256_castpd128_pd256(d), _MM_SHUFFLE(1, 1, 0, 0));
+			double* o = out + (y - y0);
+			_mm256_storeu_pd(o, _mm256_add_pd(_mm256_loadu_pd(o), _mm256_add_pd(va, _mm256_mul_pd(vd, t))));
+		}
+	}
+	else if (factor % 4 == 0)
+	{
+		// one lattice cell at a time, four outputs per instruction
+		for (; y + factor <= y1; y += factor)
+		{
+			int c = y / factor - j0;
+			__m256d a = _mm256_set1_pd(r[c]);
+			__m256d d = _mm256_set1_pd(r[c + 1] - r[c]);
+			for (int p = 0; p < factor; p += 4)
+			{
+				__m256d t = _mm256_div_pd(_mm256_setr_pd(p, p + 1, p + 2, p + 3), _mm256_set1_pd(factor));
+				double* o = out + (y + p - y0);
+				_mm256_storeu_pd(o, _mm256_add_pd(_mm256_loadu_pd(o), _mm256_add_pd(a, _mm256_mul_pd(d, t))));
+			}
+		}
+	}
+	stretch_scalar(r, factor, j0, y0, y, y1, out);
+}
+
+#endif
+
+static bilinear_row_func select_bilinear_row()
+{
+#ifdef SIMD_X86
+	switch (simd_detect())
+	{
+	case SIMD_AVX2: return bilinear_row_avx2;
+	case SIMD_SSE2: return bilinear_row_sse2;
+	default: break;
+	}
+#endif
+	return bilinear_row_scalar;
+}
+
+void bilinear_upsample(const heightfield<double>& lattice, int factor, int x0, int x1, int y0, int y1, double* out, int pitch)
+{
+	if (x1 <= x0 || y1 <= y0) return;
+
+	bilinear_row_func row = select_bilinear_row();
+	int s = lattice.size_x();
+
+	// blended lattice columns covering [y0, y1), plus the one after for the last cell
+	std::vector<double> r((y1 - 1) / factor - y0 / factor + 2);
+
+	for (int x = x0; x < x1; x++)
+	{
+		// the last rows of a map that isn't a multiple of the lattice wrap around like the columns
+		int i = x / factor;
+		i = i < s ? i : i - s;
+		double fx = (double)(x % factor) / factor;
+		row(lattice[i], lattice[i < s - 1 ? i + 1 : 0], fx, s, factor, y0, y1, &r[0], out + (size_t)(x - x0) * pitch);
+	}
+}
+
+/*
+	cubic B-spline upsampling. the lattice is prefiltered once into coefficients c, after which every
+	output is a fixed weighted sum of the 4 x 4 coefficients around it:
+
+	out(x, y) = sum over a, b of c[i + a][j + b] * w_a(x % factor) * w_b(y % factor),   a, b = -1 .. 2
+
+	the weights only depend on the position inside a lattice cell, so they are tabulated per octave. the sum is
+	done separably: along y for the coefficient rows a block needs, then along x into the block.
+*/
+
+// mirror an index into [0, n) without repeating the edge: -1 -> 1, n -> n - 2
+static inline int mirror_index(int i, int n)
+{
+	if (n == 1) return 0;
+	int period = 2 * (n - 1);
+	i %= period;
+	if (i < 0) i += period;
+	return i < n ? i : period - i;
+}
+
+// recursive filter that turns samples into B-spline coefficients along one line (Unser, Thevenaz)
+static void prefilter_line(double* c, int n, size_t stride)
+{
+	if (n < 2) return;
+
+	const double z = sqrt(3.0) - 2.0;
+	const double lambda = (1.0 - z) * (1.0 - 1.0 / z);
+
+	for (int k = 0; k < n; k++)
+		c[k * stride] *= lambda;
+
+	// causal initial value, mirrored boundary. z^k drops below double precision after ~28 terms
+	const int horizon = 28;
+	double sum;
+	if (n > horizon)
+	{
+		double zn = z;
+		sum = c[0];
+		for (int k = 1; k < horizon; k++)
+		{
+			sum += zn * c[k * stride];
+			zn *= z;
+		}
+	}
+	else
+	{
+		double zn = z;
+		double iz = 1.0 / z;
+		double z2n = pow(z, n - 1);
+		sum = c[0] + z2n * c[(n - 1) * stride];
+		z2n *= z2n * iz;
+		for (int k = 1; k < n - 1; k++)
+		{
+			sum += (zn + z2n) * c[k * stride];
+			zn *= z;
+			z2n *= iz;
+		}
+		sum /= (1.0 - zn * zn);
+	}
+	c[0] = sum;
+
+	for (int k = 1; k < n; k++)
+		c[k * stride] += z * c[(k - 1) * stride];
+
+	// anticausal pass
+	c[(n - 1) * stride] = (z / (z * z - 1.0)) * (z * c[(n - 2) * stride] + c[(n - 1) * stride]);
+	for (int k = n - 2; k >= 0; k--)
+		c[k * stride] = z * (c[(k + 1) * stride] - c[k * stride]);
+}
+
+void bspline_prefilter(heightfield<double>& lattice)
+{
+	for (int x = 0; x < lattice.size_x(); x++)
+		prefilter_line(lattice[x], lattice.size_y(), 1);
+	for (int y = 0; y < lattice.size_y(); y++)
+		prefilter_line(lattice.data() + y, lattice.size_x(), lattice.size_y());
+}
+
+void bspline_prefilter_window(const heightfield<double>& samples, heightfield<double>& coefficients)
+{
+	const int r = BSPLINE_FIR_RADIUS;
+	int sx = samples.size_x() - 2 * r;
+	int sy = samples.size_y() - 2 * r;
+
+	// impulse response of the recursive filter, sqrt(3) * z^|k|
+	const double z = sqrt(3.0) - 2.0;
+	double taps[BSPLINE_FIR_RADIUS + 1];
+	taps[0] = sqrt(3.0);
+	for (int k = 1; k <= r; k++)
+		taps[k] = taps[k - 1] * z;
+
+	// along y for every sample row, then along x. the taps are added from the outside in, the small ones first
+	heightfield<double> rows(sx + 2 * r, sy);
+	for (int x = 0; x < sx + 2 * r; x++)
+	{
+		const double* in = samples[x] + r;
+		double* out = rows[x];
+		for (int y = 0; y < sy; y++)
+		{
+			double sum = 0;
+			for (int k = r; k > 0; k--)
+				sum += (in[y - k] + in[y + k]) * taps[k];
+			out[y] = sum + in[y] * taps[0];
+		}
+	}
+
+	coefficients.resize(sx, sy);
+	for (int x = 0; x < sx; x++)
+	{
+		double* out = coefficients[x];
+		for (int y = 0; y < sy; y++)
+		{
+			double sum = 0;
+			for (int k = r; k > 0; k--)
+				sum += (rows[x + r - k][y] + rows[x + r + k][y]) * taps[k];
+			out[y] = sum + rows[x + r][y] * taps[0];
+		}
+	}
+}
+
+// weights of the 4 coefficients around every position inside a cell, w[b * factor + p] for tap b and position p
+static void bspline_weights(int factor, std::vector<double>& w)
+{
+	w.resize(4 * factor);
+	for (int p = 0; p < factor; p++)
+	{
+		double t = (double)p / factor;
+		double t2 = t * t;
+		double t3 = t2 * t;
+		w[0 * factor + p] = (1.0 - t) * (1.0 - t) * (1.0 - t) / 6.0;
+		w[1 * factor + p] = (4.0 - 6.0 * t2 + 3.0 * t3) / 6.0;
+		w[2 * factor + p] = (1.0 + 3.0 * t + 3.0 * t2 - 3.0 * t3) / 6.0;
+		w[3 * factor + p] = t3 / 6.0;
+	}
+}
+
+/*
+	the two passes, per instruction set:
+
+	rows:    tmp[y - y0] = c[k - 1] * w0[p] + c[k] * w1[p] + c[k + 1] * w2[p] + c[k + 2] * w3[p],   k = y / factor - j0 + 1, p = y % factor
+	         (c is a padded coefficient row starting at lattice column j0 - 1)
+	columns: out[y] += t0[y] * w[0] + t1[y] * w[1] + t2[y] * w[2] + t3[y] * w[3]
+*/
+
+typedef void(*bspline_rows_func)(const double* c, const double* w, int factor, int y0, int y1, double* tmp);
+typedef void(*bspline_columns_func)(const double* t0, const double* t1, const double* t2, const double* t3, const double* w, int n, double* out);
+
+static inline void bspline_rows_scalar_range(const double* c, const double* w, int factor, int j0, int y0, int y, int y1, double* tmp)
+{
+	for (; y < y1; y++)
+	{
+		int k = y / factor - j0 + 1;
+		int p = y % factor;
+		tmp[y - y0] = c[k - 1] * w[p] + c[k] * w[factor + p] + c[k + 1] * w[2 * factor + p] + c[k + 2] * w[3 * factor + p];
+	}
+}
+
+static inline void bspline_columns_scalar_range(const double* t0, const double* t1, const double* t2, const double* t3, const double* w, int i, int n, double* out)
+{
+	for (; i < n; i++)
+		out[i] += t0[i] * w[0] + t1[i] * w[1] + t2[i] * w[2] + t3[i] * w[3];
+}
+
+static void bspline_rows_scalar(const double* c, const double* w, int factor, int y0, int y1, double* tmp)
+{
+	bspline_rows_scalar_range(c, w, factor, y0 / factor, y0, y0, y1, tmp);
+}
+
+static void bspline_columns_scalar(const double* t0, const double* t1, const double* t2, const double* t3, const double* w, int n, double* out)
+{
+	bspline_columns_scalar_range(t0, t1, t2, t3, w, 0, n, out);
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET_SSE2 static void bspline_rows_sse2(const double* c, const double* w, int factor, int y0, int y1, double* tmp)
+{
+	int j0 = y0 / factor;
+	int y = y0;
+	while (y < y1 && y % 2 != 0)
+		y++;
+	bspline_rows_scalar_range(c, w, factor, j0, y0, y0, y, tmp);
+
+	if (factor % 2 == 0)
+	{
+		// pairs of outputs never straddle a cell, so the 4 coefficients are the same for both
+		for (; y + 2 <= y1; y += 2)
+		{
+			int k = y / factor - j0 + 1;
+			int p = y % factor;
+			__m128d v = _mm_mul_pd(_mm_set1_pd(c[k - 1]), _mm_loadu_pd(w + p));
+			v = _mm_add_pd(v, _mm_mul_pd(_mm_set1_pd(c[k]), _mm_loadu_pd(w + factor + p)));
+			v = _mm_add_pd(v, _mm_mul_pd(_mm_set1_pd(c[k + 1]), _mm_loadu_pd(w + 2 * factor + p)));
+			v = _mm_add_pd(v, _mm_mul_pd(_mm_set1_pd(c[k + 2]), _mm_loadu_pd(w + 3 * factor + p)));
+			_mm_storeu_pd(tmp + (y - y0), v);
+		}
+	}
+	bspline_rows_scalar_range(c, w, factor, j0, y0, y, y1, tmp);
+}
+
+SIMD_TARGET_SSE2 static void bspline_columns_sse2(const double* t0, const double* t1, const double* t2, const double* t3, const double* w, int n, double* out)
+{
+	__m128d w0 = _mm_set1_pd(w[0]), w1 = _mm_set1_pd(w[1]), w2 = _mm_set1_pd(w[2]), w3 = _mm_set1_pd(w[3]);
+	int i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128d v = _mm_mul_pd(_mm_loadu_pd(t0 + i), w0);
+		v = _mm_add_pd(v, _mm_mul_pd(_mm_loadu_pd(t1 + i), w1));
+		v = _mm_add_pd(v, _mm_mul_pd(_mm_loadu_pd(t2 + i), w2));
+		v = _mm_add_pd(v, _mm_mul_pd(_mm_loadu_pd(t3 + i), w3));
+		_mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(out + i), v));
+	}
+	bspline_columns_scalar_range(t0, t1, t2, t3, w, i, n, out);
+}
+
+SIMD_TARGET_AVX2 static void bspline_rows_avx2(const double* c, const double* w, int factor, int y0, int y1, double* tmp)
+{
+	int j0 = y0 / factor;
+	int y = y0;
+	while (y < y1 && y % 4 != 0)
+		y++;
+	bspline_rows_scalar_range(c, w, factor, j0, y0, y0, y, tmp);
+
+	if (factor % 4 == 0)
+	{
+		for (; y + 4 <= y1; y += 4)
+		{
+			int k = y / factor - j0 + 1;
+			int p = y % factor;
+			__m256d v = _mm256_mul_pd(_mm256_set1_pd(c[k - 1]), _mm256_loadu_pd(w + p));
+			v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_set1_pd(c[k]), _mm256_loadu_pd(w + factor + p)));
+			v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_set1_pd(c[k + 1]), _mm256_loadu_pd(w + 2 * factor + p)));
+			v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_set1_pd(c[k + 2]), _mm256_loadu_pd(w + 3 * factor + p)));
+			_mm256_storeu_pd(tmp + (y - y0), v);
+		}
+	}
+	bspline_rows_scalar_range(c, w, factor, j0, y0, y, y1, tmp);
+}
+
+SIMD_TARGET_AVX2 static void bspline_columns_avx2(const double* t0, const double* t1, const double* t2, const double* t3, const double* w, int n, double* out)
+{
+	__m256d w0 = _mm256_set1_pd(w[0]), w1 = _mm256_set1_pd(w[1]), w2 = _mm256_set1_pd(w[2]), w3 = _mm256_set1_pd(w[3]);
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d v = _mm256_mul_pd(_mm256_loadu_pd(t0 + i), w0);
+		v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_loadu_pd(t1 + i), w1));
+		v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_loadu_pd(t2 + i), w2));
+		v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_loadu_pd(t3 + i), w3));
+		_mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(out + i), v));
+	}
+	bspline_columns_scalar_range(t0, t1, t2, t3, w, i, n, out);
+}
+
+#endif
+
+void bspline_upsample(const heightfield<double>& coefficients, int factor, int x0, int x1, int y0, int y1, double* out, int pitch)
+{
+	if (x1 <= x0 || y1 <= y0) return;
+
+	bspline_rows_func rows = bspline_rows_scalar;
+	bspline_columns_func columns = bspline_columns_scalar;
+#ifdef SIMD_X86
+	switch (simd_detect())
+	{
+	case SIMD_AVX2:
+		rows = bspline_rows_avx2;
+		columns = bspline_columns_avx2;
+		break;
+	case SIMD_SSE2:
+		rows = bspline_rows_sse2;
+		columns = bspline_columns_sse2;
+		break;
+	default:
+		break;
+	}
+#endif
+
+	std::vector<double> w;
+	bspline_weights(factor, w);
+
+	int sx = coefficients.size_x();
+	int sy = coefficients.size_y();
+	int width = y1 - y0;
+
+	// lattice rows i0 - 1 .. i1 + 2 and columns j0 - 1 .. j1 + 2 are needed for this block
+	int i0 = x0 / factor, i1 = (x1 - 1) / factor;
+	int j0 = y0 / factor, j1 = (y1 - 1) / factor;
+
+	// pass along y: one row of tmp per lattice row, covering the width of the block
+	std::vector<double> padded(j1 - j0 + 4);
+	std::vector<double> tmp((size_t)(i1 - i0 + 4) * width);
+	for (int i = i0 - 1; i <= i1 + 2; i++)
+	{
+		const double* c = coefficients[mirror_index(i, sx)];
+		for (int j = j0 - 1; j <= j1 + 2; j++)
+			padded[j - j0 + 1] = c[mirror_index(j, sy)];
+
+		rows(&padded[0], &w[0], factor, y0, y1, &tmp[(size_t)(i - i0 + 1) * width]);
+	}
+
+	// pass along x, straight into the block
+	for (int x = x0; x < x1; x++)
+	{
+		int i = x / factor - i0;
+		int p = x % factor;
+		double wx[4] = { w[p], w[factor + p], w[2 * factor + p], w[3 * factor + p] };
+		columns(&tmp[(size_t)i * width], &tmp[(size_t)(i + 1) * width], &tmp[(size_t)(i + 2) * width], &tmp[(size_t)(i + 3) * width], wx, width, out + (size_t)(x - x0) * pitch);
+	}
+}
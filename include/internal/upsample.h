@@ -0,0 +1,36 @@
+#ifndef UPSAMPLE_DEF
+#define UPSAMPLE_DEF
+
+#include <internal/heightfield.h>
+#include <internal/simd.h>
+
+/*
+	kernels that scale a coarse lattice of noise up to the size of the map. they work on one block of the
+	output at a time, so the noise tiles can call them directly, and add their result onto what is
+	already in the block.
+
+	out[(x - x0) * pitch + (y - y0)] receives the value at map position (x, y) for x0 <= x < x1, y0 <= y < y1.
+*/
+
+// bilinear interpolation between lattice points factor cells apart, wrapping around at the far edges
+// of the lattice. matches bilinear_interpolation() to within rounding
+void bilinear_upsample(const heightfield<double>& lattice, int factor, int x0, int x1, int y0, int y1, double* out, int pitch);
+
+// turn a lattice into the cubic B-spline coefficients that interpolate it, mirrored at the edges.
+// only needs to be done once per lattice, bspline_upsample() then passes exactly through the original points
+void bspline_prefilter(heightfield<double>& lattice);
+
+// taps on each side of the truncated prefilter below. the exact filter falls off as 0.268^k, so past 16 taps
+// the difference is below 1e-9 of the values
+#define BSPLINE_FIR_RADIUS 16
+
+// the same prefilter as a fixed size convolution, for lattices that are only a window of a larger one:
+// coefficients gets samples without its BSPLINE_FIR_RADIUS wide border. every coefficient only depends on the
+// samples around it, in a fixed order, so overlapping windows give the same bits where they overlap
+void bspline_prefilter_window(const heightfield<double>& samples, heightfield<double>& coefficients);
+
+// cubic B-spline through prefiltered coefficients factor cells apart, evaluated with fixed 4 tap weights
+// along y and then along x
+void bspline_upsample(const heightfield<double>& coefficients, int factor, int x0, int x1, int y0, int y1, double* out, int pitch);
+
+#endif // !UPSAMPLE_DEF
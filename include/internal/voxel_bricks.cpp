@@ -0,0 +1,286 @@
+#include <internal/voxel_bricks.h>
+#include <internal/terrain_random.h>
+#include <algorithm>
+#include <cmath>
+
+// VOXEL_TRUNCATION / VOXEL_STEPS is exact, so the truncation itself comes back unchanged
+static const float voxel_scale = VOXEL_STEPS / VOXEL_TRUNCATION;
+
+static inline int8_t quantize_density(float v)
+{
+	float q = std::round(std::min(std::max(v, -VOXEL_TRUNCATION), VOXEL_TRUNCATION) * voxel_scale);
+	if (v > 0 && q < 1)
+		q = 1;
+	else if (v <= 0 && q > -1)
+		q = -1;
+	return (int8_t)q;
+}
+
+static inline float density_of(int8_t q)
+{
+	return q / voxel_scale;
+}
+
+float voxel_bricks::stored(float v)
+{
+	return density_of(quantize_density(v));
+}
+
+voxel_bricks::voxel_bricks()
+{
+	reset(0, 0, 0);
+}
+
+void voxel_bricks::reset(int size_x, int size_z, int floor_y)
+{
+	map_x = size_x;
+	map_z = size_z;
+	floor.resize((size_x + VOXEL_BRICK_SIZE - 1) / VOXEL_BRICK_SIZE, (size_z + VOXEL_BRICK_SIZE - 1) / VOXEL_BRICK_SIZE, floor_y);
+
+	slot empty = { empty_key, -1, 0 };
+	table.assign(1024, empty);
+	used = 0;
+	voxels.clear();
+	free_bricks.clear();
+}
+
+glm::ivec3 voxel_bricks::brick_position(uint64_t key)
+{
+	// back from the 21 bit fields of the key, with their signs
+	const uint64_t mask = (1ull << 21) - 1;
+	glm::ivec3 p;
+	for (int a = 0; a < 3; a++)
+	{
+		p[a] = (int)(key >> (42 - 21 * a) & mask);
+		if (p[a] & (1 << 20))
+			p[a] -= 1 << 21;
+	}
+	return p;
+}
+
+const voxel_bricks::slot* voxel_bricks::find(uint64_t key) const
+{
+	size_t mask = table.size() - 1;
+	for (size_t i = (size_t)random_mix(key) & mask; ; i = (i + 1) & mask)
+	{
+		if (table[i].key == key)
+			return &table[i];
+		if (table[i].key == empty_key)
+			return nullptr;
+	}
+}
+
+voxel_bricks::slot& voxel_bricks::insert(uint64_t key)
+{
+	if ((used + 1) * 2 > table.size())
+		grow();
+
+	size_t mask = table.size() - 1;
+	size_t i = (size_t)random_mix(key) & mask;
+	while (table[i].key != key && table[i].key != empty_key)
+		i = (i + 1) & mask;
+
+	if (table[i].key == empty_key)
+	{
+		table[i].key = key;
+		table[i].brick = -1;
+		table[i].value = 0;
+		used++;
+	}
+	return table[i];
+}
+
+void voxel_bricks::grow()
+{
+	std::vector<slot> old;
+	old.swap(table);
+	slot empty = { empty_key, -1, 0 };
+	table.assign(old.size() * 2, empty);
+
+	size_t mask = table.size() - 1;
+	for (size_t o = 0; o < old.size(); o++)
+	{
+		if (old[o].key == empty_key)
+			continue;
+		size_t i = (size_t)random_mix(old[o].key) & mask;
+		while (table[i].key != empty_key)
+			i = (i + 1) & mask;
+		table[i] = old[o];
+	}
+}
+
+int32_t voxel_bricks::allocate_brick(int8_t value)
+{
+	int32_t brick;
+	if (!free_bricks.empty())
+	{
+		brick = free_bricks.back();
+		free_bricks.pop_back();
+	}
+	else
+	{
+		brick = (int32_t)(voxels.size() / VOXEL_BRICK_VOXELS);
+		voxels.resize(voxels.size() + VOXEL_BRICK_VOXELS);
+	}
+	std::fill(voxels.begin() + (size_t)brick * VOXEL_BRICK_VOXELS, voxels.begin() + (size_t)(brick + 1) * VOXEL_BRICK_VOXELS, value);
+	return brick;
+}
+
+float voxel_bricks::operator()(int x, int y, int z) const
+{
+	x = clamp_x(x);
+	z = clamp_z(z);
+	int bx = brick_of(x), by = brick_of(y), bz = brick_of(z);
+	const slot* s = find(brick_key(bx, by, bz));
+	if (s == nullptr)
+		return missing(bx, by, bz);
+	if (s->brick < 0)
+		return s->value;
+	return density_of(voxels[(size_t)s->brick * VOXEL_BRICK_VOXELS + voxel_index(x, y, z)]);
+}
+
+void voxel_bricks::sample(int x0, int y0, int z0, int size, float* out) const
+{
+	for (int i = 0; i < size; i++)
+	{
+		int x = clamp_x(x0 + i);
+		int bx = brick_of(x);
+		for (int j = 0; j < size; j++)
+		{
+			int y = y0 + j;
+			int by = brick_of(y);
+			float* row = out + ((size_t)i * size + j) * size;
+
+			// one lookup for every brick the row goes through
+			int k = 0;
+			while (k < size)
+			{
+				int bz = brick_of(clamp_z(z0 + k));
+				const slot* s = find(brick_key(bx, by, bz));
+				if (s == nullptr || s->brick < 0)
+				{
+					float value = s == nullptr ? missing(bx, by, bz) : s->value;
+					for (; k < size && brick_of(clamp_z(z0 + k)) == bz; k++)
+						row[k] = value;
+				}
+				else
+				{
+					const int8_t* brick = &voxels[(size_t)s->brick * VOXEL_BRICK_VOXELS];
+					for (; k < size && brick_of(clamp_z(z0 + k)) == bz; k++)
+						row[k] = density_of(brick[voxel_index(x, y, clamp_z(z0 + k))]);
+				}
+			}
+		}
+	}
+}
+
+void voxel_bricks::set(int x, int y, int z, float value)
+{
+	if (x < 0 || x >= map_x || z < 0 || z >= map_z)
+		return;
+
+	int8_t q = quantize_density(value);
+	int bx = brick_of(x), by = brick_of(y), bz = brick_of(z);
+	uint64_t key = brick_key(bx, by, bz);
+	const slot* s = find(key);
+	if (s == nullptr || s->brick < 0)
+	{
+		float current = s == nullptr ? missing(bx, by, bz) : s->value;
+		if (current == density_of(q))
+			return;
+		slot& t = insert(key);
+		t.brick = allocate_brick(quantize_density(current));
+		s = &t;
+	}
+	voxels[(size_t)s->brick * VOXEL_BRICK_VOXELS + voxel_index(x, y, z)] = q;
+}
+
+bool voxel_bricks::is_uniform(const float* values)
+{
+	const int s = VOXEL_BRICK_SIZE + 2;
+	int8_t first = quantize_density(values[(s + 1) * s + 1]);
+	bool rock = first > 0;
+	for (int i = 0; i < s; i++)
+	{
+		for (int j = 0; j < s; j++)
+		{
+			for (int k = 0; k < s; k++)
+			{
+				float v = values[((size_t)i * s + j) * s + k];
+				if ((v > 0) != rock)
+					return false;
+				bool inside = i > 0 && i <= VOXEL_BRICK_SIZE && j > 0 && j <= VOXEL_BRICK_SIZE && k > 0 && k <= VOXEL_BRICK_SIZE;
+				if (inside && quantize_density(v) != first)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+void voxel_bricks::set_brick(int x, int y, int z, const float* values)
+{
+	slot& s = insert(brick_key(x, y, z));
+	if (s.brick < 0)
+		s.brick = allocate_brick(0);
+
+	int8_t* brick = &voxels[(size_t)s.brick * VOXEL_BRICK_VOXELS];
+	for (int i = 0; i < VOXEL_BRICK_VOXELS; i++)
+		brick[i] = quantize_density(values[i]);
+}
+
+void voxel_bricks::set_uniform(int x, int y, int z, float value)
+{
+	value = stored(value);
+	uint64_t key = brick_key(x, y, z);
+	if (find(key) == nullptr && value == missing(x, y, z))
+		return;
+
+	slot& s = insert(key);
+	if (s.brick >= 0)
+	{
+		free_bricks.push_back(s.brick);
+		s.brick = -1;
+	}
+	s.value = value;
+}
+
+void voxel_bricks::compact()
+{
+	const int n = VOXEL_BRICK_SIZE;
+	const int s = n + 2;
+	std::vector<float> values((size_t)s * s * s);
+	for (size_t t = 0; t < table.size(); t++)
+	{
+		if (table[t].key == empty_key || table[t].brick < 0)
+			continue;
+
+		// every brick keeps its values when it is turned into one value, so the order doesn't matter
+		glm::ivec3 p = brick_position(table[t].key);
+		sample(p.x * n - 1, p.y * n - 1, p.z * n - 1, s, &values[0]);
+		if (is_uniform(&values[0]))
+		{
+			free_bricks.push_back(table[t].brick);
+			table[t].value = density_of(voxels[(size_t)table[t].brick * VOXEL_BRICK_VOXELS]);
+			table[t].brick = -1;
+		}
+	}
+}
+
+void voxel_bricks::surface_bricks(std::vector<glm::ivec3>& out) const
+{
+	out.clear();
+	for (size_t t = 0; t < table.size(); t++)
+	{
+		if (table[t].key == empty_key || table[t].brick < 0)
+			continue;
+
+		out.push_back(brick_position(table[t].key));
+	}
+}
+
+size_t voxel_bricks::memory() const
+{
+	return sizeof(voxel_bricks) + table.capacity() * sizeof(slot) + voxels.capacity() * sizeof(int8_t) +
+		free_bricks.capacity() * sizeof(int32_t) + floor.size() * sizeof(int32_t);
+}
@@ -0,0 +1,140 @@
+#ifndef VOXEL_BRICKS_DEF
+#define VOXEL_BRICKS_DEF
+
+#include <stdint.h>
+#include <vector>
+#include <internal/heightfield.h>
+#include <glm/glm.hpp>
+
+/*
+	sparse store of a 3D density field, positive in rock and negative in air, for the caves and for editing
+	the terrain. the voxels are grouped in cubic bricks, and only the bricks the surface goes through keep
+	their voxels, 8 bits each. densities are clamped to +-VOXEL_TRUNCATION, so a brick away from the surface
+	is all one value and is kept as that value alone. bricks that aren't in the store at all are rock below the floor of
+	their column and air above it, which covers the bulk of the island and the sky for the size of a 2D map.
+	memory grows with the area of the surface instead of the volume.
+
+	the bricks are found in an open addressing hash table keyed on their position, so a lookup is a hash and
+	usually one probe whatever the size of the island.
+*/
+
+#define VOXEL_BRICK_BITS 3
+
+// voxels per side of a brick
+#define VOXEL_BRICK_SIZE (1 << VOXEL_BRICK_BITS)
+#define VOXEL_BRICK_VOXELS (VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE * VOXEL_BRICK_SIZE)
+
+// densities are clamped to this far on either side of the surface, and stored in steps of VOXEL_TRUNCATION / VOXEL_STEPS
+#define VOXEL_TRUNCATION 4.0f
+#define VOXEL_STEPS 127
+
+class voxel_bricks
+{
+public:
+	voxel_bricks();
+
+	// empty store for a map of size_x by size_z voxels, every column air above floor_y (in bricks) and rock below
+	void reset(int size_x, int size_z, int floor_y);
+
+	// the density v reads back as once stored: clamped, and rounded to a step but never to 0, so the surface
+	// crosses the same edges between voxels as in v and never goes through a voxel
+	static float stored(float v);
+
+	// density at voxel x, y, z. x and z past the edges of the map continue the edge voxels
+	float operator()(int x, int y, int z) const;
+
+	// the same for a block of size^3 voxels from x0, y0, z0 into out[(i * size + j) * size + k], like
+	// cave_density::sample, looking every brick up once per row
+	void sample(int x0, int y0, int z0, int size, float* out) const;
+
+	// change one voxel, giving its brick its own voxels if it was one value
+	void set(int x, int y, int z, float value);
+
+	/*
+		whether a brick can be kept as one value, from (VOXEL_BRICK_SIZE + 2)^3 densities from one voxel before the
+		brick to one past it, in the same order as sample: its voxels are all the same once clamped, and the
+		surface doesn't cross from them to the voxels around it
+	*/
+	static bool is_uniform(const float* values);
+
+	// brick x, y, z (in bricks) with its own voxels, in the same order as sample, or all one value
+	void set_brick(int x, int y, int z, const float* values);
+	void set_uniform(int x, int y, int z, float value);
+
+	// floor of the column of bricks x, z, set before its bricks are
+	void set_floor(int x, int z, int floor_y) { floor[x][z] = floor_y; }
+	int floor_of(int x, int z) const { return floor[x][z]; }
+
+	// turn bricks edited back to one value into that value
+	void compact();
+
+	// give back the memory left over from growing, once all the bricks are in
+	void shrink_to_fit() { voxels.shrink_to_fit(); free_bricks.shrink_to_fit(); }
+
+	// positions of the bricks with their own voxels, which are the only ones the surface can go through
+	void surface_bricks(std::vector<glm::ivec3>& out) const;
+
+	int size_x() const { return map_x; }
+	int size_z() const { return map_z; }
+	int columns_x() const { return floor.size_x(); }
+	int columns_z() const { return floor.size_y(); }
+
+	// bricks with their own voxels, and bricks kept as one value
+	size_t bricks() const { return voxels.size() / VOXEL_BRICK_VOXELS - free_bricks.size(); }
+	size_t uniform_bricks() const { return used - bricks(); }
+
+	size_t memory() const;
+
+private:
+	// brick with its own voxels at voxels[brick * VOXEL_BRICK_VOXELS], or one value if brick is -1
+	struct slot
+	{
+		uint64_t key;
+		int32_t brick;
+		float value;
+	};
+
+	static const uint64_t empty_key = ~0ull;
+
+	static uint64_t brick_key(int x, int y, int z)
+	{
+		const uint64_t mask = (1ull << 21) - 1;
+		return ((uint64_t)(uint32_t)x & mask) << 42 | ((uint64_t)(uint32_t)y & mask) << 21 | ((uint64_t)(uint32_t)z & mask);
+	}
+
+	static glm::ivec3 brick_position(uint64_t key);
+
+	const slot* find(uint64_t key) const;
+	slot& insert(uint64_t key);
+	void grow();
+
+	int32_t allocate_brick(int8_t value);
+
+	// round down to bricks, for negative voxels too
+	static int brick_of(int v) { return v >= 0 ? v >> VOXEL_BRICK_BITS : ~(~v >> VOXEL_BRICK_BITS); }
+	static int voxel_index(int x, int y, int z)
+	{
+		const int mask = VOXEL_BRICK_SIZE - 1;
+		return ((x & mask) << VOXEL_BRICK_BITS | (y & mask)) << VOXEL_BRICK_BITS | (z & mask);
+	}
+
+	// the value of a brick that isn't stored
+	float missing(int x, int y, int z) const { return y < floor[x][z] ? VOXEL_TRUNCATION : -VOXEL_TRUNCATION; }
+
+	int clamp_x(int x) const { return x < 0 ? 0 : (x >= map_x ? map_x - 1 : x); }
+	int clamp_z(int z) const { return z < 0 ? 0 : (z >= map_z ? map_z - 1 : z); }
+
+	int map_x;
+	int map_z;
+	heightfield<int32_t> floor;
+
+	// power of two slots, at most half of them used
+	std::vector<slot> table;
+	size_t used;
+
+	// in steps, see stored
+	std::vector<int8_t> voxels;
+	std::vector<int32_t> free_bricks;
+};
+
+#endif // !VOXEL_BRICKS_DEF
@@ -0,0 +1,710 @@
+// headless island generator: generates a range of seeds without a window or GPU, optionally writes every
+// island to disk, and reports how fast it went. builds on its own (IslanderGen.vcxproj, or the Makefile on Linux)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+
+#include <internal/terrain_generation.h>
+#include <internal/terrain_tiles.h>
+#include <internal/mapped_file.h>
+#include <internal/erosion.h>
+#include <internal/caves.h>
+#include <internal/height_pyramid.h>
+#include <internal/compact_heightfield.h>
+#include <internal/terrain_random.h>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <Windows.h>
+	#include <psapi.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+// tiles of the out of core mode when --tile-size isn't given
+#define OUT_OF_CORE_TILE_SIZE 512
+
+struct gen_options
+{
+	uint64_t first_seed;
+	int count;
+	int size;
+	int octaves;
+	double amplitude;
+	terrain_generator generator;
+	erosion_settings erosion;
+	unsigned int threads;
+	const char* out_dir;
+	bool write_mesh;
+	int tile_size;
+	bool out_of_core;
+	bool caves;
+	int rays;
+	bool compact;
+};
+
+static void print_usage()
+{
+	printf(
+		"usage: islander-gen [options]\n"
+		"  --seed N          first seed (default 1)\n"
+		"  --count N         number of islands, seeds N .. N + count - 1 (default 1)\n"
+		"  --size N          points per side of the heightmap (default 1536)\n"
+		"  --octaves N       noise octaves, 0 for as many as the size allows (default 0)\n"
+		"  --amplitude X     amplitude of the first octave (default 0.25)\n"
+		"  --generator NAME  value, simplex or ridged (default value)\n"
+		"  --droplets N      hydraulic erosion droplets per island, 0 for none (default size * size / 2)\n"
+		"  --thermal N       thermal erosion passes, 0 for none (default 40)\n"
+		"  --thermal-time X  stop thermal erosion after X seconds even if passes are left, the islands then\n"
+		"                    depend on the machine\n"
+		"  tiled islands aren't eroded, --droplets, --thermal and --thermal-time don't apply to them\n"
+		"  --threads N       worker threads, 0 for one per core (default 0)\n"
+		"  --out DIR         write DIR/island_<seed>.pfm (heightmap) and .ply (mesh), nothing is written without it\n"
+		"  --no-mesh         only write the heightmaps\n"
+		"  --tile-size N     generate every island as independent N x N tiles and check that they stitch,\n"
+		"                    only the heightmaps are written then\n"
+		"  --out-of-core     stream every island to disk a band of tiles at a time, for islands too large for\n"
+		"                    memory. needs --out, writes the heightmap and one mesh per tile\n"
+		"  --caves           also store the island with its caves as sparse voxel bricks and mesh them, reports\n"
+		"                    memory and chunks/sec and writes DIR/island_<seed>_caves.ply. not with tiles\n"
+		"  --rays N          build the min/max pyramid of every island and cast N random rays at it, reports\n"
+		"                    rays/sec. not out of core (default 0)\n"
+		"  --compact         also store every island as 16 bit heights and a bit of material per point, reports\n"
+		"                    its size and error and writes DIR/island_<seed>.pgm. not with tiles\n");
+}
+
+static bool parse_options(int argc, char** argv, gen_options& options)
+{
+	options.first_seed = 1;
+	options.count = 1;
+	options.size = 1536;
+	options.octaves = 0;
+	options.amplitude = 0.25;
+	options.generator = GENERATOR_VALUE_NOISE;
+	options.erosion = default_erosion_settings(-1);
+	options.threads = 0;
+	options.out_dir = NULL;
+	options.write_mesh = true;
+	options.tile_size = 0;
+	options.out_of_core = false;
+	options.caves = false;
+	options.rays = 0;
+	options.compact = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--no-mesh") == 0)
+		{
+			options.write_mesh = false;
+			continue;
+		}
+		if (strcmp(arg, "--out-of-core") == 0)
+		{
+			options.out_of_core = true;
+			continue;
+		}
+		if (strcmp(arg, "--caves") == 0)
+		{
+			options.caves = true;
+			continue;
+		}
+		if (strcmp(arg, "--compact") == 0)
+		{
+			options.compact = true;
+			continue;
+		}
+		if (strcmp(arg, "--help") == 0 || value == NULL)
+			return false;
+
+		if (strcmp(arg, "--seed") == 0) options.first_seed = strtoull(value, NULL, 10);
+		else if (strcmp(arg, "--count") == 0) options.count = atoi(value);
+		else if (strcmp(arg, "--size") == 0) options.size = atoi(value);
+		else if (strcmp(arg, "--octaves") == 0) options.octaves = atoi(value);
+		else if (strcmp(arg, "--amplitude") == 0) options.amplitude = atof(value);
+		else if (strcmp(arg, "--droplets") == 0) options.erosion.droplets = atoi(value);
+		else if (strcmp(arg, "--thermal") == 0) options.erosion.thermal_iterations = atoi(value);
+		else if (strcmp(arg, "--thermal-time") == 0) options.erosion.thermal_budget = atof(value);
+		else if (strcmp(arg, "--threads") == 0) options.threads = (unsigned int)atoi(value);
+		else if (strcmp(arg, "--out") == 0) options.out_dir = value;
+		else if (strcmp(arg, "--tile-size") == 0) options.tile_size = atoi(value);
+		else if (strcmp(arg, "--rays") == 0) options.rays = atoi(value);
+		else if (strcmp(arg, "--generator") == 0)
+		{
+			if (strcmp(value, "value") == 0) options.generator = GENERATOR_VALUE_NOISE;
+			else if (strcmp(value, "simplex") == 0) options.generator = GENERATOR_SIMPLEX;
+			else if (strcmp(value, "ridged") == 0) options.generator = GENERATOR_RIDGED;
+			else return false;
+		}
+		else
+			return false;
+		i++;
+	}
+
+	if (options.erosion.droplets < 0)
+		options.erosion.droplets = (int)std::min(options.size * (double)options.size * EROSION_DROPLETS_PER_POINT, 2e9);
+
+	return options.count > 0 && options.size >= 16 && options.tile_size >= 0 && options.rays >= 0 && (!options.out_of_core || options.out_dir != NULL);
+}
+
+// largest amount of memory the process has had, in MB
+static double peak_memory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize / 1048576.0;
+	return 0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	#ifdef __APPLE__
+		return usage.ru_maxrss / 1048576.0; // bytes
+	#else
+		return usage.ru_maxrss / 1024.0; // kilobytes
+	#endif
+#endif
+}
+
+/*
+	generate an island the way separate processes or machines would: every tile is a job of its own that only
+	gets the plan and its coordinates. the tiles are then put together into heights, checking that neighbours
+	agree on every point they share, halos included. returns false if they don't
+*/
+static bool generate_tiled(const gen_options& options, uint64_t seed, heightfield<float>& heights, thread_pool& pool)
+{
+	terrain_tile_plan plan = plan_terrain_tiles(options.size, options.tile_size, options.octaves, options.amplitude, options.generator, seed, pool);
+	int count = terrain_tile_count(plan);
+
+	// one tile per job, so the tiles themselves run on a single thread each
+	std::vector<terrain_tile> tiles((size_t)count * count);
+	pool.parallel_for(count * count, [&](int t)
+	{
+		thread_pool single(1);
+		generate_terrain_tile(plan, t / count, t % count, tiles[t], single);
+	});
+
+	int tile_size = options.tile_size;
+	int points = tile_size + 1 + 2 * TILE_HALO;
+	bool stitched = true;
+	for (int tx = 0; tx < count; tx++)
+	{
+		for (int ty = 0; ty < count; ty++)
+		{
+			const heightfield<float>& tile = tiles[(size_t)tx * count + ty].heights;
+			for (int d = -TILE_HALO; d <= TILE_HALO; d++)
+			{
+				if (tx + 1 < count && memcmp(tile[tile_size + TILE_HALO + d], tiles[(size_t)(tx + 1) * count + ty].heights[TILE_HALO + d], points * sizeof(float)) != 0)
+					stitched = false;
+				if (ty + 1 < count)
+				{
+					const heightfield<float>& next = tiles[(size_t)tx * count + ty + 1].heights;
+					for (int i = 0; i < points; i++)
+						if (tile[i][tile_size + TILE_HALO + d] != next[i][TILE_HALO + d])
+							stitched = false;
+				}
+			}
+		}
+	}
+
+	heights.resize(options.size, options.size);
+	for (int x = 0; x < options.size; x++)
+	{
+		for (int ty = 0; ty < count; ty++)
+		{
+			int y0 = ty * tile_size;
+			int width = std::min(tile_size, options.size - y0);
+			memcpy(&heights[x][y0], &tiles[(size_t)(x / tile_size) * count + ty].heights[x % tile_size + TILE_HALO][TILE_HALO], width * sizeof(float));
+		}
+	}
+
+	return stitched;
+}
+
+// portable float map, one float per point, bottom row first
+static bool write_heightmap(const char* path, const heightfield<float>& heights)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) return false;
+
+	fprintf(file, "Pf\n%d %d\n-1.0\n", heights.size_y(), heights.size_x());
+	for (int x = heights.size_x() - 1; x >= 0; x--)
+		fwrite(heights[x], sizeof(float), heights.size_y(), file);
+
+	return fclose(file) == 0;
+}
+
+// 16 bit PGM of the quantized heights, first row first. the offset and scale back to heights are in a comment
+static bool write_compact_heightmap(const char* path, const quantized_heights& heights)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) return false;
+
+	const heightfield<uint16_t>& values = heights.raw();
+	fprintf(file, "P5\n# height = %.9g + value * %.9g\n%d %d\n65535\n", heights.height_offset(), heights.height_scale(), values.size_y(), values.size_x());
+
+	// PGM is big endian
+	std::vector<unsigned char> row(values.size_y() * 2);
+	for (int x = 0; x < values.size_x(); x++)
+	{
+		for (int y = 0; y < values.size_y(); y++)
+		{
+			row[y * 2] = (unsigned char)(values[x][y] >> 8);
+			row[y * 2 + 1] = (unsigned char)(values[x][y] & 0xff);
+		}
+		fwrite(&row[0], 1, row.size(), file);
+	}
+
+	return fclose(file) == 0;
+}
+
+// binary (little endian) PLY with face colors, buffer holds the vertices and then the faces
+static bool write_ply(const char* path, const std::vector<char>& buffer, int vertices, int faces)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) return false;
+
+	fprintf(file,
+		"ply\n"
+		"format binary_little_endian 1.0\n"
+		"element vertex %d\n"
+		"property float x\n"
+		"property float y\n"
+		"property float z\n"
+		"element face %d\n"
+		"property list uchar int vertex_indices\n"
+		"property uchar red\n"
+		"property uchar green\n"
+		"property uchar blue\n"
+		"end_header\n", vertices, faces);
+	fwrite(&buffer[0], 1, buffer.size(), file);
+
+	return fclose(file) == 0;
+}
+
+template <typename T>
+static void append(std::vector<char>& buffer, const T& value)
+{
+	const char* bytes = (const char*)&value;
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void append_face(std::vector<char>& buffer, int a, int b, int c, const glm::vec3& color)
+{
+	append(buffer, (unsigned char)3);
+	append(buffer, a);
+	append(buffer, b);
+	append(buffer, c);
+	append(buffer, (unsigned char)(color.r * 255));
+	append(buffer, (unsigned char)(color.g * 255));
+	append(buffer, (unsigned char)(color.b * 255));
+}
+
+/*
+	binary (little endian) PLY with face colors. the terrain is an indexed grid of the heightmap points,
+	triangulated the same way main.cpp draws it, the features follow as separate triangles
+*/
+static bool write_mesh(const char* path, const heightfield<float>& heights, const material_layer& materials, const std::vector<glm::vec3>& features, const std::vector<glm::vec3>& colors)
+{
+	int points = heights.size_x();
+	int grid_vertices = points * points;
+	int terrain_faces = (points - 1) * (points - 1) * 2;
+	int feature_faces = (int)features.size() / 3;
+
+	std::vector<char> buffer;
+	buffer.reserve(((size_t)grid_vertices + features.size()) * 12 + ((size_t)terrain_faces + feature_faces) * 16);
+
+	for (int x = 0; x < points; x++)
+		for (int z = 0; z < points; z++)
+		{
+			append(buffer, (float)(x - points / 2));
+			append(buffer, heights[x][z]);
+			append(buffer, (float)(z - points / 2));
+		}
+	for (std::vector<glm::vec3>::const_iterator v = features.begin(); v != features.end(); v++)
+	{
+		append(buffer, v->x);
+		append(buffer, v->y);
+		append(buffer, v->z);
+	}
+
+	// the grid vertices get the color of their material and the features theirs from colors, faces get the
+	// average of their corners
+	auto color = [&](int v) { return v < grid_vertices ? material_color(materials.material(v / points, v % points)) : colors[v - grid_vertices]; };
+	auto face = [&](int a, int b, int c) { append_face(buffer, a, b, c, (color(a) + color(b) + color(c)) / 3.0f); };
+	for (int x = 0; x < points - 1; x++)
+		for (int z = 0; z < points - 1; z++)
+		{
+			int v = x * points + z;
+			face(v + points, v, v + points + 1);
+			face(v, v + 1, v + points + 1);
+		}
+	for (int i = 0; i < feature_faces; i++)
+	{
+		int v = grid_vertices + i * 3;
+		face(v, v + 1, v + 2);
+	}
+
+	return write_ply(path, buffer, grid_vertices + (int)features.size(), terrain_faces + feature_faces);
+}
+
+// binary PLY of the cave chunks, one after the other, keeping the vertices they share within a chunk
+static bool write_cave_mesh(const char* path, const std::vector<cave_chunk>& chunks)
+{
+	const glm::vec3 rock(0.5f, 0.45f, 0.4f);
+	int vertices = 0;
+	int faces = 0;
+	for (std::vector<cave_chunk>::const_iterator c = chunks.begin(); c != chunks.end(); c++)
+	{
+		vertices += (int)c->vertices.size();
+		faces += (int)c->indices.size() / 3;
+	}
+
+	std::vector<char> buffer;
+	buffer.reserve((size_t)vertices * 12 + (size_t)faces * 16);
+	for (std::vector<cave_chunk>::const_iterator c = chunks.begin(); c != chunks.end(); c++)
+		for (std::vector<glm::vec3>::const_iterator v = c->vertices.begin(); v != c->vertices.end(); v++)
+		{
+			append(buffer, v->x);
+			append(buffer, v->y);
+			append(buffer, v->z);
+		}
+
+	int first = 0;
+	for (std::vector<cave_chunk>::const_iterator c = chunks.begin(); c != chunks.end(); c++)
+	{
+		for (size_t i = 0; i < c->indices.size(); i += 3)
+			append_face(buffer, first + (int)c->indices[i], first + (int)c->indices[i + 1], first + (int)c->indices[i + 2], rock);
+		first += (int)c->vertices.size();
+	}
+
+	return write_ply(path, buffer, vertices, faces);
+}
+
+/*
+	mesh of one tile, in the same layout as write_mesh without the features. the points are in the same
+	place in the world as in the mesh of the whole island, so the tiles line up
+*/
+static bool write_tile_mesh(const char* path, const terrain_tile_plan& plan, const terrain_tile& tile)
+{
+	// the tiles on the far edges stop at the last point of the island
+	int x0 = tile.x * plan.tile_size;
+	int y0 = tile.y * plan.tile_size;
+	int points_x = std::min(plan.tile_size, plan.size - 1 - x0) + 1;
+	int points_y = std::min(plan.tile_size, plan.size - 1 - y0) + 1;
+	int faces = (points_x - 1) * (points_y - 1) * 2;
+
+	std::vector<char> buffer;
+	buffer.reserve((size_t)points_x * points_y * 12 + (size_t)faces * 16);
+
+	const heightfield<float>& heights = tile.heights;
+	for (int x = 0; x < points_x; x++)
+		for (int z = 0; z < points_y; z++)
+		{
+			append(buffer, (float)(x0 + x - plan.size / 2));
+			append(buffer, heights[x + TILE_HALO][z + TILE_HALO]);
+			append(buffer, (float)(y0 + z - plan.size / 2));
+		}
+
+	// sand up to BEACH_HEIGHT above the water and grass above it. tiles don't measure the distance to the coast,
+	// so unlike generate_terrain low ground away from the sea is sand too
+	glm::vec3 grass = material_color(MATERIAL_GRASS);
+	glm::vec3 sand = material_color(MATERIAL_SAND);
+	for (int x = 0; x < points_x - 1; x++)
+		for (int z = 0; z < points_y - 1; z++)
+		{
+			float h1 = heights[x + TILE_HALO][z + TILE_HALO];
+			float h2 = heights[x + 1 + TILE_HALO][z + TILE_HALO];
+			float h3 = heights[x + TILE_HALO][z + 1 + TILE_HALO];
+			float h4 = heights[x + 1 + TILE_HALO][z + 1 + TILE_HALO];
+
+			int v = x * points_y + z;
+			append_face(buffer, v + points_y, v, v + points_y + 1, ((h1 + h2 + h4) / 3) - plan.water_level < BEACH_HEIGHT ? sand : grass);
+			append_face(buffer, v, v + 1, v + points_y + 1, ((h1 + h3 + h4) / 3) - plan.water_level < BEACH_HEIGHT ? sand : grass);
+		}
+
+	return write_ply(path, buffer, points_x * points_y, faces);
+}
+
+/*
+	out of core generation: the island is generated a band of tiles at a time, straight into a memory mapped
+	heightmap, and the mesh of every tile goes to its own file as soon as the tile is done. nothing the size of
+	the whole island is ever held, only a band of tiles and the mapped window over its rows, so the memory used
+	depends on the width of the island and the tile size but not on its area.
+	hash receives the same heightmap hash heightfield_hash gives for the tiled island in memory
+*/
+static bool generate_out_of_core(const gen_options& options, uint64_t seed, const std::string& path, uint64_t& hash, thread_pool& pool)
+{
+	int size = options.size;
+	int tile_size = options.tile_size > 0 ? options.tile_size : OUT_OF_CORE_TILE_SIZE;
+	terrain_tile_plan plan = plan_terrain_tiles(size, tile_size, options.octaves, options.amplitude, options.generator, seed, pool);
+	int count = terrain_tile_count(plan);
+
+	// same format as write_heightmap, rows of the island from the last to the first
+	char header[64];
+	int header_length = snprintf(header, sizeof(header), "Pf\n%d %d\n-1.0\n", size, size);
+	size_t row_bytes = (size_t)size * sizeof(float);
+
+	mapped_file heightmap;
+	if (!heightmap.create((path + ".pfm").c_str(), header_length + (uint64_t)row_bytes * size))
+		return false;
+	char* start = heightmap.map(0, header_length);
+	if (start == NULL)
+		return false;
+	memcpy(start, header, header_length);
+
+	hash = HEIGHTFIELD_HASH_START;
+	std::vector<terrain_tile> band(count);
+	std::atomic<bool> meshes_written(true);
+	for (int tx = 0; tx < count; tx++)
+	{
+		// one tile per job, each writes its mesh when it's done
+		pool.parallel_for(count, [&](int ty)
+		{
+			thread_pool single(1);
+			generate_terrain_tile(plan, tx, ty, band[ty], single);
+
+			std::string mesh_path = path + "_" + std::to_string(tx) + "_" + std::to_string(ty) + ".ply";
+			if (options.write_mesh && !write_tile_mesh(mesh_path.c_str(), plan, band[ty]))
+				meshes_written = false;
+		});
+
+		// rows x0 .. x1 - 1 of the island are one block of the file, last row first
+		int x0 = tx * tile_size;
+		int x1 = std::min(x0 + tile_size, size);
+		char* rows = heightmap.map(header_length + (uint64_t)(size - x1) * row_bytes, (x1 - x0) * row_bytes);
+		if (rows == NULL)
+			return false;
+
+		for (int x = x0; x < x1; x++)
+		{
+			char* row = rows + (size_t)(x1 - 1 - x) * row_bytes;
+			for (int ty = 0; ty < count; ty++)
+			{
+				int y0 = ty * tile_size;
+				int width = std::min(tile_size, size - y0);
+				memcpy(row + y0 * sizeof(float), &band[ty].heights[x - x0 + TILE_HALO][TILE_HALO], width * sizeof(float));
+			}
+			hash = heightfield_hash_bytes(hash, row, row_bytes);
+		}
+	}
+
+	return heightmap.close() && meshes_written;
+}
+
+/*
+	cast rays from random points in the air over the island in random directions, level or going down, the way
+	line of sight checks and light baking would. returns how many hit the ground
+*/
+static int cast_rays(const heightfield<float>& heights, uint64_t seed, int count, thread_pool& pool, double& pyramid_seconds, double& ray_seconds)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	height_pyramid pyramid;
+	float half = (float)(heights.size_x() / 2);
+	pyramid.build(heights, 1, glm::vec2(-half), pool);
+	pyramid_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<glm::vec3> origins(count), directions(count);
+	std::vector<ray_hit> hits(count);
+	double top = pyramid.level(pyramid.levels() - 1)[0][0].max;
+	for (int i = 0; i < count; i++)
+	{
+		double angle = random_double(seed, RANDOM_STREAM_RAYS, i, 3) * 6.283185307179586;
+		origins[i] = glm::vec3((float)(random_double(seed, RANDOM_STREAM_RAYS, i, 0) * heights.size_x() - half), (float)(random_double(seed, RANDOM_STREAM_RAYS, i, 1) * top),
+			(float)(random_double(seed, RANDOM_STREAM_RAYS, i, 2) * heights.size_y() - half));
+		directions[i] = glm::vec3((float)cos(angle), (float)(-0.5 * random_double(seed, RANDOM_STREAM_RAYS, i, 4)), (float)sin(angle));
+	}
+
+	start = std::chrono::steady_clock::now();
+	pyramid.intersect_rays(&origins[0], &directions[0], count, (float)(heights.size_x() + heights.size_y()), &hits[0], pool);
+	ray_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int hit_count = 0;
+	for (int i = 0; i < count; i++)
+		hit_count += hits[i].t != INFINITY;
+	return hit_count;
+}
+
+int main(int argc, char** argv)
+{
+	gen_options options;
+	if (!parse_options(argc, argv, options))
+	{
+		print_usage();
+		return 1;
+	}
+
+	thread_pool pool(options.threads);
+	printf("generating %d islands of %d x %d on %u threads\n", options.count, options.size, options.size, pool.size());
+
+	double stage_totals[STAGE_COUNT] = { 0 };
+	double droplet_total = 0;
+	double thermal_total = 0;
+	double feature_total = 0;
+	double cave_store_seconds = 0;
+	double cave_seconds = 0;
+	int cave_chunks = 0;
+	double pyramid_total = 0;
+	double ray_seconds_total = 0;
+	double rays_total = 0;
+	double compact_total = 0;
+	double generation_total = 0;
+	double write_total = 0;
+
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	for (int i = 0; i < options.count; i++)
+	{
+		uint64_t seed = options.first_seed + i;
+
+		heightfield<float> heights;
+		material_layer materials;
+		std::vector<glm::vec3> features, colors, normals;
+		double seconds;
+		uint64_t hash = 0;
+		std::string path = options.out_dir != NULL ? std::string(options.out_dir) + "/island_" + std::to_string((unsigned long long)seed) : std::string();
+
+		if (options.out_of_core)
+		{
+			// generation and writing are one pass here, so it all counts as generation
+			std::chrono::steady_clock::time_point stream_start = std::chrono::steady_clock::now();
+			if (!generate_out_of_core(options, seed, path, hash, pool))
+			{
+				fprintf(stderr, "could not write %s\n", path.c_str());
+				return 1;
+			}
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - stream_start).count();
+		}
+		else if (options.tile_size > 0)
+		{
+			std::chrono::steady_clock::time_point tile_start = std::chrono::steady_clock::now();
+			if (!generate_tiled(options, seed, heights, pool))
+			{
+				fprintf(stderr, "seed %llu: tiles don't match on their shared edges\n", (unsigned long long)seed);
+				return 1;
+			}
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tile_start).count();
+		}
+		else
+		{
+			terrain_progress progress;
+			cancel_token cancel;
+			generate_terrain(options.size, 1, options.octaves, options.amplitude, options.generator, seed, options.erosion, heights, materials, features, colors, normals, progress, cancel, pool);
+
+			for (int s = 0; s < STAGE_COUNT; s++)
+				stage_totals[s] += progress.stage_time((terrain_stage)s);
+			droplet_total += progress.stage_count(STAGE_EROSION);
+			thermal_total += progress.stage_count(STAGE_THERMAL);
+			feature_total += progress.stage_count(STAGE_FEATURES);
+			seconds = progress.total_time();
+		}
+
+		std::vector<cave_chunk> caves;
+		if (options.caves && options.tile_size == 0 && !options.out_of_core)
+		{
+			// sampled into bricks once, then meshed from them like the game would after every edit
+			cave_density density(heights, default_cave_settings(seed));
+			voxel_bricks bricks;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			store_caves(density, bricks, pool);
+			double store_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("seed %llu: caves stored in %f sec, %zu bricks with voxels and %zu of one value, %f MB\n", (unsigned long long)seed,
+				store_seconds, bricks.bricks(), bricks.uniform_bricks(), bricks.memory() / (1024.0 * 1024.0));
+
+			cave_mesh_stats stats;
+			mesh_caves(bricks, caves, stats, pool);
+			printf("seed %llu: caves %d of %d chunks meshed in %f sec, %.0f chunks/sec, %zu vertices, %zu triangles\n", (unsigned long long)seed,
+				stats.meshed, stats.chunks, stats.seconds, stats.meshed / stats.seconds, stats.vertices, stats.triangles);
+			cave_store_seconds += store_seconds;
+			cave_seconds += stats.seconds;
+			cave_chunks += stats.meshed;
+		}
+		if (options.rays > 0 && !options.out_of_core)
+		{
+			double pyramid_seconds, ray_seconds;
+			int hits = cast_rays(heights, seed, options.rays, pool, pyramid_seconds, ray_seconds);
+			printf("seed %llu: pyramid built in %f sec, %d of %d rays hit in %f sec, %.0f rays/sec\n", (unsigned long long)seed,
+				pyramid_seconds, hits, options.rays, ray_seconds, options.rays / ray_seconds);
+			pyramid_total += pyramid_seconds;
+			ray_seconds_total += ray_seconds;
+			rays_total += options.rays;
+		}
+		quantized_heights compact_heights;
+		if (options.compact && options.tile_size == 0 && !options.out_of_core)
+		{
+			// the heights in compact storage, and the materials generate_terrain gave, against floats and vec3 colors
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			compact_heights.encode(heights, pool);
+			double compact_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			heightfield<float> decoded;
+			compact_heights.decode(decoded, pool);
+			float error = 0;
+			for (size_t p = 0; p < heights.size(); p++)
+				error = std::max(error, std::abs(decoded.data()[p] - heights.data()[p]));
+
+			double full = (double)heights.size() * (sizeof(float) + sizeof(glm::vec3));
+			double compact = (double)(compact_heights.memory() + materials.memory());
+			printf("seed %llu: compact in %f sec, %f MB instead of %f MB, height error up to %f\n", (unsigned long long)seed,
+				compact_seconds, compact / (1024.0 * 1024.0), full / (1024.0 * 1024.0), error);
+			compact_total += compact_seconds;
+		}
+		generation_total += seconds;
+		if (!options.out_of_core)
+			hash = heightfield_hash(heights);
+
+		// the hash identifies the island, to compare runs across machines and builds
+		printf("seed %llu: %f sec, heightmap hash %016llx\n", (unsigned long long)seed, seconds, (unsigned long long)hash);
+
+		if (options.out_dir != NULL && !options.out_of_core)
+		{
+			std::chrono::steady_clock::time_point write_start = std::chrono::steady_clock::now();
+
+			if (!write_heightmap((path + ".pfm").c_str(), heights) || (options.write_mesh && options.tile_size == 0 && !write_mesh((path + ".ply").c_str(), heights, materials, features, colors)) ||
+				(!caves.empty() && !write_cave_mesh((path + "_caves.ply").c_str(), caves)) ||
+				(!compact_heights.raw().empty() && !write_compact_heightmap((path + ".pgm").c_str(), compact_heights)))
+			{
+				fprintf(stderr, "could not write %s\n", path.c_str());
+				return 1;
+			}
+			write_total += std::chrono::duration<double>(std::chrono::steady_clock::now() - write_start).count();
+		}
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+	printf("\n%d islands in %f sec, %f islands/sec\n", options.count, elapsed, options.count / elapsed);
+	printf("average per island:\n");
+	if (options.tile_size == 0 && !options.out_of_core)
+		for (int s = 0; s < STAGE_COUNT; s++)
+			printf("  %-10s %f sec\n", terrain_stage_name((terrain_stage)s), stage_totals[s] / options.count);
+	if (droplet_total > 0 && stage_totals[STAGE_EROSION] > 0)
+		printf("erosion: %.0f droplets/sec\n", droplet_total / stage_totals[STAGE_EROSION]);
+	if (thermal_total > 0 && stage_totals[STAGE_THERMAL] > 0)
+		printf("thermal: %.0f passes/sec, %.1f passes per island\n", thermal_total / stage_totals[STAGE_THERMAL], thermal_total / options.count);
+	if (feature_total > 0)
+		printf("features: %.0f plants per island\n", feature_total / options.count);
+	printf("  %-10s %f sec\n", "generation", generation_total / options.count);
+	if (cave_chunks > 0)
+	{
+		printf("  %-10s %f sec\n", "bricks", cave_store_seconds / options.count);
+		printf("  %-10s %f sec, %.0f chunks/sec\n", "caves", cave_seconds / options.count, cave_chunks / cave_seconds);
+	}
+	if (rays_total > 0)
+	{
+		printf("  %-10s %f sec\n", "pyramid", pyramid_total / options.count);
+		printf("  %-10s %f sec, %.0f rays/sec\n", "rays", ray_seconds_total / options.count, rays_total / ray_seconds_total);
+	}
+	if (compact_total > 0)
+		printf("  %-10s %f sec\n", "compact", compact_total / options.count);
+	if (options.out_dir != NULL && !options.out_of_core)
+		printf("  %-10s %f sec\n", "writing", write_total / options.count);
+	printf("peak memory: %f MB\n", peak_memory());
+
+	return 0;
+}
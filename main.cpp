@@ -15,11 +15,34 @@
 #include <mutex>
 
 #define map_size 1536
+#define map_generator GENERATOR_VALUE_NOISE
+
+// hydraulic erosion droplets run over the island, 0 to turn erosion off
+#define map_droplets (map_size * map_size / 2)
+
+// stream an unbounded world of islands in chunks around the player instead of generating one map_size island
+// up front. chunks are kept on the GPU within world_view_radius of the player, and up to world_cache_mb of
+// generated chunks are kept in memory after that. off by default, the chunks don't have the rivers, lakes and
+// trees of the single island yet
+//#define INFINITE_WORLD
+#define world_view_radius 640
+#define world_cache_mb 256
+
+// the island is first generated with about this many points per side, which takes a fraction of a second,
+// then again at full resolution in the background
+#define COARSE_MAP_POINTS 256
+
+// rows of terrain cells uploaded to the GPU per frame when a finer level is swapped in
+#define TERRAIN_UPLOAD_ROWS 64
 
 #include <internal/shader_loader.h>
 #include <internal/terrain_generation.h>
-#include <internal/loading_screen.h>
+#include <internal/terrain_stream.h>
+#include <internal/heightfield_ops.h>
+#include <internal/heightfield_query.h>
+#include <internal/compact_heightfield.h>
 #include <internal/model.h>
+#include <internal/loading_screen.h>
 
 #define WINDOW_WIDTH 2048
 #define WINDOW_HEIGHT 1024
@@ -29,9 +52,55 @@
 
 GLFWwindow* window;
 
+// one level of detail of the island, with the points of the heightmap step apart
+struct terrain_level
+{
+	int step;
+	heightfield<float> heights;
+
+	/*
+		the terrain has one vertex per point of the heightmap, one row after the other. they are made a row at a
+		time while uploading, from the heights and a bit of material per point, so only the features are kept
+		as triangles until then
+	*/
+	material_layer materials;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec3> normals;
+	size_t terrain_vertices;
+	size_t row_vertices;
+	size_t row_indices;
+};
+
+// GPU copy of a terrain_level, filled a part at a time
+struct terrain_buffers
+{
+	GLuint vertex_buffer;
+	GLuint color_buffer;
+	GLuint normal_buffer;
+	GLuint index_buffer;
+	size_t size;
+	size_t uploaded;
+
+	// the layout of the level, which frees its own copy once it's uploaded
+	size_t terrain_vertices;
+	size_t row_vertices;
+	size_t row_indices;
+
+	// rows of cells, and the rows whose vertices and triangles are all uploaded
+	size_t rows;
+	size_t rows_uploaded;
+};
+
 bool init();
 void quit();
 
+bool build_terrain_level(terrain_level& level, int step, uint64_t seed, terrain_progress& progress, const cancel_token& cancel);
+void create_terrain_buffers(terrain_buffers& buffers, const terrain_level& level);
+bool upload_terrain_buffers(terrain_buffers& buffers, terrain_level& level, size_t count);
+void draw_terrain_buffers(const terrain_buffers& buffers, size_t first_row, size_t rows, bool features);
+void delete_terrain_buffers(terrain_buffers& buffers);
+
 int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) // this needs to be replaced with something cross-platform, but Visual Studio won't complile anything without this
 {
 	#ifdef _DEBUG
@@ -52,50 +121,63 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 	glGenVertexArrays(1, &vertex_array_id);
 	glBindVertexArray(vertex_array_id);
 	
-	std::vector<glm::vec3> vertices;
-	std::vector<std::vector<glm::vec3>> map;
-	std::vector<glm::vec3> colors;
-	std::vector<glm::vec3> normals;
+	// a new island every time, print the seed so it can be made again
+	uint64_t map_seed = (uint64_t)time(0);
+	printf("seed: %llu\n", (unsigned long long)map_seed);
 
-	int terrain_completion = 0;
-	std::thread terrain_thread(generate_terrain, map_size, 0, 0.25, std::ref(map), std::ref(colors), std::ref(normals), std::ref(terrain_completion));
-	loading_screen(window, terrain_completion, program_id, glm::vec3(0.75, 0.75, 0.75), glm::vec3(0, 1, 0), glm::vec3(0.25, 0.25, 0.25));
-	terrain_thread.join();
+	#ifdef CHECK_DETERMINISM
+		check_terrain_determinism(map_size, 0, 0.25, map_generator, map_seed, default_erosion_settings(map_droplets));
+	#endif
 
-	for (int x = 0; x < map_size-1; x++) 
+#ifdef INFINITE_WORLD
+	terrain_stream world(default_chunk_settings(map_seed), world_view_radius, (size_t)world_cache_mb << 20, thread_pool::global());
+#else
+	// coarsest step that still divides the map into whole points
+	int first_step = 1;
+	while (map_size / first_step > COARSE_MAP_POINTS && map_size % (first_step * 2) == 0)
+		first_step *= 2;
+
+	// the coarse level is generated right away so there is something to walk on in the first frame,
+	// the full resolution one in the background
+	std::vector<terrain_level> levels(first_step > 1 ? 2 : 1);
+	terrain_progress coarse_progress;
+	cancel_token terrain_cancel;
+	std::thread coarse_thread(build_terrain_level, std::ref(levels[0]), first_step, map_seed, std::ref(coarse_progress), std::cref(terrain_cancel));
+
+	// it only takes a moment, but show how far along it is rather than a frozen window
+	bool window_open = loading_screen(window, coarse_progress, program_id, glm::vec3(0.75, 0.75, 0.75), glm::vec3(0, 1, 0), glm::vec3(0.25, 0.25, 0.25));
+	if (!window_open)
+		terrain_cancel.cancel();
+	coarse_thread.join();
+	if (!window_open)
 	{
-		for (int z = 0; z < map_size-1; z++)
-		{
-			vertices.push_back(map[x + 1][z]);
-			vertices.push_back(map[x][z]);
-			vertices.push_back(map[x + 1][z + 1]);
-
-			vertices.push_back(map[x][z]);
-			vertices.push_back(map[x][z + 1]);
-			vertices.push_back(map[x + 1][z + 1]);
-		}
+		quit();
+		return 0;
 	}
 
-	for (int i = map_size; i < map.size(); i++)
-		for (std::vector<glm::vec3>::iterator j = map[i].begin(); j != map[i].end(); j++)
-			vertices.push_back(*j);
-
-	// buffers for position and color
-	GLuint vertex_buffer;
-	GLuint color_buffer;
-	GLuint normal_buffer;
+	terrain_progress generation_progress;
+	std::atomic<int> levels_ready(1);
+	std::thread terrain_thread([&]()
+	{
+		for (int i = 1; i < (int)levels.size(); i++)
+		{
+			if (!build_terrain_level(levels[i], 1, map_seed, generation_progress, terrain_cancel))
+				return;
+			levels_ready.store(i + 1, std::memory_order_release);
+		}
+	});
 
-	glGenBuffers(1, &vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
-	
-	glGenBuffers(1, &color_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, color_buffer);
-	glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), &colors[0], GL_STATIC_DRAW);
+	// level being drawn and collided with, and the next one while it is uploaded
+	int current_level = 0;
+	terrain_buffers current_buffers;
+	create_terrain_buffers(current_buffers, levels[0]);
+	upload_terrain_buffers(current_buffers, levels[0], current_buffers.size);
 
-	glGenBuffers(1, &normal_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normal_buffer);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
+	int next_level = 1;
+	terrain_buffers next_buffers;
+	bool uploading = false;
+	int shown_percentage = -1;
+#endif
 
 	// movement variables
 	glm::vec3 position = glm::vec3(0, map_size, 0);
@@ -152,18 +234,41 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 	const float max_fall_speed = 5.0f;
 	float y_speed = 0;
 
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_DYNAMIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, color_buffer);
-	glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), &colors[0], GL_DYNAMIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, normal_buffer);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_DYNAMIC_DRAW);
-
 	// main loop 
 	while (!glfwWindowShouldClose(window))
 	{	
+#ifndef INFINITE_WORLD
+		// show how far along the next level is, then swap it in a few rows per frame once it's ready
+		if (next_level < (int)levels.size())
+		{
+			if (!uploading && levels_ready.load(std::memory_order_acquire) > next_level)
+			{
+				create_terrain_buffers(next_buffers, levels[next_level]);
+				uploading = true;
+			}
+
+			if (uploading)
+			{
+				terrain_level& level = levels[next_level];
+				if (upload_terrain_buffers(next_buffers, level, TERRAIN_UPLOAD_ROWS * level.row_vertices))
+				{
+					delete_terrain_buffers(current_buffers);
+					current_buffers = next_buffers;
+					current_level = next_level++;
+					uploading = false;
+					glfwSetWindowTitle(window, "Islander");
+				}
+			}
+			else if (generation_progress.percentage() != shown_percentage)
+			{
+				shown_percentage = generation_progress.percentage();
+				char title[64];
+				snprintf(title, sizeof(title), "Islander - generating %d%%", shown_percentage);
+				glfwSetWindowTitle(window, title);
+			}
+		}
+#endif
+
 		// calculate deltatime
 		current_time = glfwGetTime();
 		float delta_time = float(current_time - last_time);
@@ -204,22 +309,19 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 		if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) position += right * delta_time * speed;   // move right
 
 		// gravity and physics
+#ifdef INFINITE_WORLD
+		world.update(position);
+
+		// hover where the ground isn't loaded yet
 		float ground_pos;
-		if (position.x > -map_size / 2 && position.x + 1 < map_size / 2 && position.z > -map_size / 2 && position.z + 1 < map_size / 2)
-			ground_pos = (float)bilinear_interpolation(
-				map[(int)position.x + map_size / 2][(int)position.z + map_size / 2].y,
-				map[(int)position.x + map_size / 2][(int)position.z + 1 + map_size / 2].y,
-				map[(int)position.x + 1 + map_size / 2][(int)position.z + map_size / 2].y,
-				map[(int)position.x + 1 + map_size / 2][(int)position.z + 1 + map_size / 2].y,
-				(int)position.x + map_size / 2,
-				(int)position.x + 1 + map_size / 2,
-				(int)position.z + map_size / 2,
-				(int)position.z + 1 + map_size / 2,
-				position.x + map_size / 2,
-				position.z + map_size / 2
-			);
-		else
-			ground_pos = 0;
+		if (!world.ground_height(position.x, position.z, ground_pos))
+			ground_pos = position.y - 5;
+#else
+		// ground of the level that is drawn, sea level off the island
+		const terrain_level& level = levels[current_level];
+		heightfield_query ground(level.heights, (float)level.step, glm::vec2((float)(-map_size / 2)), QUERY_OUTSIDE, 0);
+		float ground_pos = ground.height(position.x, position.z);
+#endif
 
 		position.y += y_speed; 
 		if (abs(position.y - ground_pos - 5) < gravity * delta_time)
@@ -263,47 +365,34 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 		glUniform1f(fog_start_id, fog_start);
 		glUniform1f(fog_end_id, fog_end);
 
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-		glVertexAttribPointer(
-			0, // attribute No 0
-			3, // size
-			GL_FLOAT, // type
-			GL_FALSE, // is it normalized?
-			0, // gap between groups of data
-			(void*)0 // offset from start
-		);
-
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, color_buffer);
-		glVertexAttribPointer(
-			1, // attribute No 0
-			3, // size
-			GL_FLOAT, // type
-			GL_FALSE, // is it normalized?
-			0, // gap between groups of data
-			(void*)0 // offset from start
-		);
-
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, normal_buffer);
-		glVertexAttribPointer(
-			2, // attribute No 0
-			3, // size
-			GL_FLOAT, // type
-			GL_FALSE, // is it normalized?
-			0, // gap between groups of data
-			(void*)0 // offset from start
-		);
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
+#ifdef INFINITE_WORLD
+		world.draw();
+#else
+		if (uploading)
+		{
+			// the rows of the next level that are uploaded, and the current level for the rest of the island
+			const terrain_level& next = levels[next_level];
+			const terrain_level& current = levels[current_level];
+			size_t rows = next_buffers.rows_uploaded;
+			size_t first = std::min(rows * next.step / current.step, current_buffers.rows);
+
+			draw_terrain_buffers(next_buffers, 0, rows, false);
+			draw_terrain_buffers(current_buffers, first, current_buffers.rows - first, true);
+		}
+		else
+			draw_terrain_buffers(current_buffers, 0, current_buffers.rows, true);
+#endif
 
 		glfwSwapBuffers(window);
 	}
 
+#ifdef INFINITE_WORLD
+	world.stop();
+#else
+	terrain_cancel.cancel();
+	terrain_thread.join();
+#endif
+
 	quit();
 	return 0;
 }	
@@ -368,4 +457,209 @@ void quit()
 {
 	glfwDestroyWindow(window);
 	glfwTerminate();
-}
\ No newline at end of file
+}
+
+bool build_terrain_level(terrain_level& level, int step, uint64_t seed, terrain_progress& progress, const cancel_token& cancel)
+{
+	// the terrain comes as its heights and materials, its normals are made from the heights while uploading
+	level.step = step;
+	if (!generate_terrain(map_size, step, 0, 0.25, map_generator, seed, default_erosion_settings(map_droplets), level.heights, level.materials, level.vertices, level.colors, level.normals, progress, cancel, thread_pool::global()))
+		return false;
+
+	printf("island generated with step %d\n", step);
+	print_terrain_times(progress);
+
+	int points = level.heights.size_x();
+	level.row_vertices = points;
+	level.terrain_vertices = (size_t)points * points;
+	level.row_indices = (size_t)(points - 1) * 6;
+	return true;
+}
+
+void create_terrain_buffers(terrain_buffers& buffers, const terrain_level& level)
+{
+	buffers.size = level.terrain_vertices + level.vertices.size();
+	size_t bytes = buffers.size * sizeof(glm::vec3);
+	buffers.uploaded = 0;
+	buffers.terrain_vertices = level.terrain_vertices;
+	buffers.row_vertices = level.row_vertices;
+	buffers.row_indices = level.row_indices;
+	buffers.rows = level.terrain_vertices / level.row_vertices - 1;
+	buffers.rows_uploaded = 0;
+
+	glGenBuffers(1, &buffers.vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &buffers.color_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.color_buffer);
+	glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &buffers.normal_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.normal_buffer);
+	glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &buffers.index_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.index_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffers.rows * buffers.row_indices * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+}
+
+// upload up to count more vertices, and the triangles of the rows of cells they complete. returns true once
+// all of them are on the GPU, what the level kept for them is freed then
+bool upload_terrain_buffers(terrain_buffers& buffers, terrain_level& level, size_t count)
+{
+	size_t end = buffers.uploaded + std::min(count, buffers.size - buffers.uploaded);
+
+	auto upload = [&buffers](size_t first, size_t n, const glm::vec3* vertices, const glm::vec3* colors, const glm::vec3* normals)
+	{
+		size_t offset = first * sizeof(glm::vec3);
+		size_t bytes = n * sizeof(glm::vec3);
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.vertex_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, vertices);
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.color_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, colors);
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.normal_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, normals);
+	};
+
+	// the terrain vertices, made a row of points at a time
+	const heightfield<float>& map = level.heights;
+	int step = level.step;
+	std::vector<glm::vec3> vertices, colors, normals;
+	while (buffers.uploaded < std::min(end, buffers.terrain_vertices))
+	{
+		int x = (int)(buffers.uploaded / buffers.row_vertices);
+		size_t first = buffers.uploaded - (size_t)x * buffers.row_vertices;
+		size_t n = std::min(buffers.row_vertices - first, end - buffers.uploaded);
+
+		vertices.resize(buffers.row_vertices);
+		colors.resize(buffers.row_vertices);
+		normals.resize(buffers.row_vertices);
+		for (int z = 0; z < map.size_y(); z++)
+			vertices[z] = glm::vec3(x * step - map_size / 2, map[x][z], z * step - map_size / 2);
+		level.materials.color_row(x, &colors[0]);
+		sobel_normal_row(map, (float)step, x, &normals[0]);
+
+		upload(buffers.uploaded, n, &vertices[first], &colors[first], &normals[first]);
+		buffers.uploaded += n;
+	}
+
+	// then the features
+	if (buffers.uploaded < end)
+	{
+		size_t feature = buffers.uploaded - buffers.terrain_vertices;
+		upload(buffers.uploaded, end - buffers.uploaded, &level.vertices[feature], &level.colors[feature], &level.normals[feature]);
+		buffers.uploaded = end;
+	}
+
+	// a row of cells needs the points on both of its sides
+	size_t lines = std::min(buffers.uploaded, buffers.terrain_vertices) / buffers.row_vertices;
+	size_t rows = lines > 0 ? std::min(lines - 1, buffers.rows) : 0;
+	if (rows > buffers.rows_uploaded)
+	{
+		/*
+		two triangles per cell
+		   ______
+		v1 |\   | v3
+		   | \  |
+		   |  \ |
+		v2 |___\| v4
+		*/
+		GLuint points = (GLuint)buffers.row_vertices;
+		std::vector<GLuint> indices;
+		indices.reserve((rows - buffers.rows_uploaded) * buffers.row_indices);
+		for (GLuint x = (GLuint)buffers.rows_uploaded; x < rows; x++)
+		{
+			for (GLuint z = 0; z < points - 1; z++)
+			{
+				GLuint v1 = x * points + z;
+				GLuint v2 = v1 + points;
+				GLuint v3 = v1 + 1;
+				GLuint v4 = v2 + 1;
+
+				indices.push_back(v2);
+				indices.push_back(v1);
+				indices.push_back(v4);
+
+				indices.push_back(v1);
+				indices.push_back(v3);
+				indices.push_back(v4);
+			}
+		}
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.index_buffer);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, buffers.rows_uploaded * buffers.row_indices * sizeof(GLuint), indices.size() * sizeof(GLuint), &indices[0]);
+		buffers.rows_uploaded = rows;
+	}
+
+	if (buffers.uploaded < buffers.size)
+		return false;
+
+	level.materials = material_layer();
+	std::vector<glm::vec3>().swap(level.vertices);
+	std::vector<glm::vec3>().swap(level.colors);
+	std::vector<glm::vec3>().swap(level.normals);
+	return true;
+}
+
+// draw rows of cells of the terrain, and the features after it if asked to
+void draw_terrain_buffers(const terrain_buffers& buffers, size_t first_row, size_t rows, bool features)
+{
+	size_t feature_vertices = features ? buffers.size - buffers.terrain_vertices : 0;
+	if (rows == 0 && feature_vertices == 0) return;
+
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.vertex_buffer);
+	glVertexAttribPointer(
+		0, // attribute No 0
+		3, // size
+		GL_FLOAT, // type
+		GL_FALSE, // is it normalized?
+		0, // gap between groups of data
+		(void*)0 // offset from start
+	);
+
+	glEnableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.color_buffer);
+	glVertexAttribPointer(
+		1, // attribute No 0
+		3, // size
+		GL_FLOAT, // type
+		GL_FALSE, // is it normalized?
+		0, // gap between groups of data
+		(void*)0 // offset from start
+	);
+
+	glEnableVertexAttribArray(2);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.normal_buffer);
+	glVertexAttribPointer(
+		2, // attribute No 0
+		3, // size
+		GL_FLOAT, // type
+		GL_FALSE, // is it normalized?
+		0, // gap between groups of data
+		(void*)0 // offset from start
+	);
+
+	if (rows > 0)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.index_buffer);
+		glDrawElements(GL_TRIANGLES, (GLsizei)(rows * buffers.row_indices), GL_UNSIGNED_INT, (void*)(first_row * buffers.row_indices * sizeof(GLuint)));
+	}
+	if (feature_vertices > 0)
+		glDrawArrays(GL_TRIANGLES, (GLint)buffers.terrain_vertices, (GLsizei)feature_vertices);
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+}
+
+void delete_terrain_buffers(terrain_buffers& buffers)
+{
+	glDeleteBuffers(1, &buffers.vertex_buffer);
+	glDeleteBuffers(1, &buffers.color_buffer);
+	glDeleteBuffers(1, &buffers.normal_buffer);
+	glDeleteBuffers(1, &buffers.index_buffer);
+}